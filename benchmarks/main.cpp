@@ -48,6 +48,278 @@ static void CompParsing(benchmark::State& state) {
         ami::Parser(ami::Lexer(expr).lex(), expr, "null").parse();
     }
 }
+static void LargeSetLexing(benchmark::State& state) {
+    std::string expr{"{"};
+    for (int i = 0; i < state.range(0); ++i) {
+        expr += std::to_string(i) + ", ";
+    }
+    expr += "0}";
+    for (auto _ : state) {
+        ami::Lexer(expr).lex();
+    }
+}
+static void LargeSetParsing(benchmark::State& state) {
+    std::string expr{"{"};
+    for (int i = 0; i < state.range(0); ++i) {
+        expr += std::to_string(i) + ", ";
+    }
+    expr += "0}";
+    auto tokens = ami::Lexer(expr).lex();
+    for (auto _ : state) {
+        ami::Parser(tokens, expr, "null").parse();
+    }
+}
+static void ExpressionParsing(benchmark::State& state, ami::ParseMode mode) {
+    std::string expr{"2 * x ^ 2 + 3 * x - 1 >= 4 / (y + 1) % 3"};
+    auto tokens = ami::Lexer(expr).lex();
+    for (auto _ : state) {
+        ami::Parser(tokens, expr, "null", mode).parse();
+    }
+}
+static void LongSumParsing(benchmark::State& state, ami::ParseMode mode) {
+    std::string expr{"0"};
+    for (int i = 1; i < 1000; ++i) {
+        expr += " + " + std::to_string(i);
+    }
+    auto tokens = ami::Lexer(expr).lex();
+    for (auto _ : state) {
+        ami::Parser(tokens, expr, "null", mode).parse();
+    }
+}
+// a few thousand nodes of scalar arithmetic over a variable
+static std::string LargeExpression(int terms) {
+    std::string expr{"x"};
+    const char* ops[] = {" + ", " - ", " * ", " / "};
+    for (int i = 1; i < terms; ++i) {
+        expr += ops[i % 4];
+        expr += i % 3 ? "(x * " + std::to_string(i) + " - 1)"
+                      : "sqrt(x + " + std::to_string(i) + ")";
+    }
+    return expr;
+}
+static void TreeEvaluation(benchmark::State& state) {
+    ami::eval("x = 1.5");
+    std::string expr = LargeExpression(state.range(0));
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    ami::Interpreter inter(parser.get_ei());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void NestedComparisons(benchmark::State& state) {
+    ami::eval("x = 1");
+    std::string expr = "x";
+    for (int i = 0; i < state.range(0); ++i)
+        expr = "(" + expr + " <= 2)";
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    ami::Interpreter inter(parser.get_ei());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void FlatEvaluation(benchmark::State& state) {
+    ami::eval("x = 1.5");
+    std::string expr = LargeExpression(state.range(0));
+    auto tree = ami::flat::flatten(
+        ami::Parser(ami::Lexer(expr).lex(), expr, "null").parse());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ami::flat::evaluate(*tree));
+    }
+}
+static void TreeFunctionCalls(benchmark::State& state) {
+    ami::eval("fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)");
+    ami::memo::opt_out("fib");
+    std::string expr = "fib(" + std::to_string(state.range(0)) + ")";
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    ami::Interpreter inter(parser.get_ei());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void MemoizedFunctionCalls(benchmark::State& state) {
+    ami::eval("fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)");
+    ami::memo::opt_in("fib");
+    std::string expr = "fib(" + std::to_string(state.range(0)) + ")";
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::memo::clear();
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void VmFunctionCalls(benchmark::State& state) {
+    ami::eval("fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)");
+    std::string expr = "fib(" + std::to_string(state.range(0)) + ")";
+    auto chunk = ami::vm::compile(
+        ami::Parser(ami::Lexer(expr).lex(), expr, "null").parse().get());
+    ami::vm::Machine machine;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(machine.run(*chunk));
+    }
+}
+static void JitFunctionCalls(benchmark::State& state) {
+    ami::eval("fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)");
+    ami::memo::opt_out("fib");
+    std::string expr = "fib(" + std::to_string(state.range(0)) + ")";
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    ami::jit::enabled = true;
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+    ami::jit::enabled = false;
+}
+static void NumericFunctionCall(benchmark::State& state, bool jit) {
+    ami::eval("f(x) -> x ^ 2 * sin(x) + 3 * x - sqrt(x) / (x + 1)");
+    ami::memo::opt_out("f");
+    std::string expr = "f(1.5)";
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    ami::jit::enabled = jit;
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+    ami::jit::enabled = false;
+}
+static void DeepRecursion(benchmark::State& state) {
+    ami::eval("sum(n, a, b) -> if (n < 1) a else sum(n - 1, a + b * n, b)");
+    ami::memo::opt_out("sum");
+    std::string expr = "sum(" + std::to_string(state.range(0)) + ", 0, 2)";
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void ConstantEvaluation(benchmark::State& state, bool fold) {
+    std::string expr{
+        "if (pi > 3) sqrt(2) * e ^ 2 - max(1, tau) / 3 else 0 - log(10) * pi"};
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    if (fold) root = ami::optimize::fold_constants(root);
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void RepeatedSubexpressions(benchmark::State& state, bool share) {
+    std::string expr{
+        "sqrt(pi^2 + e^2) + sqrt(pi^2 + e^2) * sqrt(pi^2 + e^2) - "
+        "sqrt(pi^2 + e^2) / sqrt(pi^2 + e^2)"};
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    if (share) root = ami::optimize::share_common(root);
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void VectorEvaluation(benchmark::State& state) {
+    std::string expr{"[1, 2, 3] * 2 + [4, 5, 6] + [7, 8, 9] * 3"};
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void MatrixMultiplication(benchmark::State& state) {
+    std::string expr{"m = ["};
+    for (int i = 0; i < state.range(0); ++i) {
+        expr += i == 0 ? "[" : ", [";
+        for (int j = 0; j < state.range(0); ++j)
+            expr += (j == 0 ? "" : ", ") + std::to_string((i + j) % 7);
+        expr += "]";
+    }
+    expr += "]";
+    ami::eval(expr);
+    std::string product{"m * m"};
+    ami::Parser parser(ami::Lexer(product).lex(), product, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void LargeSetAlgebra(benchmark::State& state) {
+    std::string a{"a = {"}, b{"b = {"};
+    for (int i = 0; i < state.range(0); ++i) {
+        a += std::to_string(i * 2) + ", ";
+        b += std::to_string(i * 3) + ", ";
+    }
+    ami::eval(a + "0}");
+    ami::eval(b + "0}");
+    std::string expr{"(a intersection b) union (a - b)"};
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void IntervalMembership(benchmark::State& state) {
+    std::string expr{"r = [0; 1]"};
+    for (int i = 1; i < state.range(0); ++i)
+        expr += fmt::format(" union [{}; {}[", i * 3, i * 3 + 2);
+    ami::eval(expr);
+    std::string query{"1000.5 in r"};
+    ami::Parser parser(ami::Lexer(query).lex(), query, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void ExactFactorial(benchmark::State& state) {
+    std::string expr = fmt::format("{}! / ({}! * 7)", state.range(0),
+                                   state.range(0) / 2);
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    for (auto _ : state) {
+        ami::Interpreter inter(parser.get_ei());
+        benchmark::DoNotOptimize(inter.visit(root));
+    }
+}
+static void BatchEvaluation(benchmark::State& state, bool batch) {
+    std::string expr = "x * x + sin(y) > 1 and x < y";
+    std::size_t rows = state.range(0);
+    std::vector<double> x(rows), y(rows), out(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        x[i] = std::cos(i * 0.1) * 3;
+        y[i] = std::sin(i * 0.3) * 2;
+    }
+    if (batch) {
+        auto program = ami::batch::compile(expr, {"x", "y"});
+        const double* columns[] = {x.data(), y.data()};
+        for (auto _ : state) {
+            program->run(columns, rows, out.data());
+            benchmark::DoNotOptimize(out.data());
+        }
+        return;
+    }
+    // the same rows through the Interpreter, one at a time
+    ami::Parser parser(ami::Lexer(expr).lex(), expr, "null");
+    ami::ptr_t root = parser.parse();
+    ami::symbol_t xid = ami::symbols::intern("x");
+    ami::symbol_t yid = ami::symbols::intern("y");
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < rows; ++i) {
+            ami::scope::assign(ami::scope::userdefined, xid,
+                               ami::val_t(ami::Number(x[i])));
+            ami::scope::assign(ami::scope::userdefined, yid,
+                               ami::val_t(ami::Number(y[i])));
+            ami::Interpreter inter(parser.get_ei());
+            benchmark::DoNotOptimize(inter.visit(root));
+        }
+    }
+}
 
 BENCHMARK(NumberParsing)->Range(0, 1 << 22);
 BENCHMARK(NumberLexing)->Range(0, 1 << 22);
@@ -57,4 +329,33 @@ BENCHMARK(VectorParsing)->Range(0, 1 << 22);
 BENCHMARK(IntervalsParsing)->Range(0, 1 << 22);
 BENCHMARK(VectorOperations)->Range(0, 1 << 22);
 BENCHMARK(CompParsing)->Range(0, 1 << 22);
+BENCHMARK(LargeSetLexing)->Range(1 << 10, 1 << 20);
+BENCHMARK(LargeSetParsing)->Range(1 << 10, 1 << 17);
+BENCHMARK_CAPTURE(ExpressionParsing, pratt, ami::ParseMode::Pratt);
+BENCHMARK_CAPTURE(ExpressionParsing, recursive_descent,
+                  ami::ParseMode::RecursiveDescent);
+BENCHMARK_CAPTURE(LongSumParsing, pratt, ami::ParseMode::Pratt);
+BENCHMARK_CAPTURE(LongSumParsing, recursive_descent,
+                  ami::ParseMode::RecursiveDescent);
+BENCHMARK(TreeEvaluation)->Range(1 << 6, 1 << 12);
+BENCHMARK(NestedComparisons)->DenseRange(4, 16, 4);
+BENCHMARK(FlatEvaluation)->Range(1 << 6, 1 << 12);
+BENCHMARK(TreeFunctionCalls)->DenseRange(10, 20, 5);
+BENCHMARK(MemoizedFunctionCalls)->DenseRange(10, 20, 5);
+BENCHMARK(VmFunctionCalls)->DenseRange(10, 20, 5);
+BENCHMARK(JitFunctionCalls)->DenseRange(10, 20, 5);
+BENCHMARK(DeepRecursion)->Range(64, 2048);
+BENCHMARK_CAPTURE(NumericFunctionCall, tree, false);
+BENCHMARK_CAPTURE(NumericFunctionCall, jit, true);
+BENCHMARK_CAPTURE(ConstantEvaluation, tree, false);
+BENCHMARK_CAPTURE(ConstantEvaluation, folded, true);
+BENCHMARK_CAPTURE(RepeatedSubexpressions, tree, false);
+BENCHMARK_CAPTURE(RepeatedSubexpressions, shared, true);
+BENCHMARK(VectorEvaluation);
+BENCHMARK(MatrixMultiplication)->RangeMultiplier(4)->Range(8, 512);
+BENCHMARK(LargeSetAlgebra)->Range(1 << 10, 1 << 17);
+BENCHMARK(IntervalMembership)->Range(8, 1 << 10);
+BENCHMARK(ExactFactorial)->RangeMultiplier(4)->Range(32, 8192);
+BENCHMARK_CAPTURE(BatchEvaluation, rows, false)->Range(1 << 8, 1 << 14);
+BENCHMARK_CAPTURE(BatchEvaluation, batch, true)->Range(1 << 8, 1 << 14);
 BENCHMARK_MAIN();
@@ -1,17 +1,81 @@
 #pragma once
+#include <istream>
+#include <exception>
 #include <string>
+#include <string_view>
+#include <utility>
 
 #include "ast.hpp"
+#include "batch.hpp"
+#include "errors.hpp"
+#include "flat.hpp"
 #include "interpreter.hpp"
 #include "lexer.hpp"
+#include "optimize.hpp"
 #include "parser.hpp"
+#include "vm.hpp"
 
 namespace ami {
-val_t eval(const std::string& expression, const std::string& file = "source") {
-    ami::Lexer lexer(expression);
-    ami::Parser parser(lexer.lex(), expression, file);
-    auto parsed = parser.parse();
-    ami::Interpreter inter(parser.get_ei());
-    return inter.visit(parsed);
+// parses `expression` without throwing, the diagnostic of a failed parse
+// borrows `expression` and `file`
+inline Result<ptr_t> try_parse(std::string_view expression,
+                               std::string_view file = "source") {
+    try {
+        ami::Lexer lexer(expression);
+        ami::Parser parser(lexer.lex(), expression, file);
+        return parser.parse();
+    } catch (const ami::exceptions::BaseException& e) {
+        return e.diagnostic();
+    } catch (const std::exception& e) {
+        return ami::exceptions::Diagnostic{
+            ami::exceptions::ErrorCode::Error, e.what(), file, expression};
+    }
+}
+// evaluates `expression` without throwing, the error message is only built
+// when Diagnostic::format is called. the diagnostic borrows `expression` and
+// `file`. the errors are still raised as exceptions inside and caught here
+inline Result<val_t> try_eval(std::string_view expression,
+                              std::string_view file = "source") {
+    try {
+        ami::Lexer lexer(expression);
+        ami::Parser parser(lexer.lex(), expression, file);
+        auto parsed = ami::optimize::share_common(ami::optimize::resolve_slots(
+            ami::optimize::fold_constants(parser.parse())));
+        ami::Interpreter inter(parser.get_ei());
+        return inter.visit(parsed);
+    } catch (const ami::exceptions::BaseException& e) {
+        return e.diagnostic();
+    } catch (const std::exception& e) {
+        // raised by builtins called with the wrong arguments, or by the
+        // standard library
+        return ami::exceptions::Diagnostic{
+            ami::exceptions::ErrorCode::Error, e.what(), file, expression};
+    }
+}
+inline val_t eval(const std::string& expression,
+                  const std::string& file = "source") {
+    auto result = try_eval(expression, file);
+    if (!result)
+        throw ami::exceptions::BaseException::owning(result.error());
+    return std::move(*result);
+}
+// evaluates a script line by line while it's being read, `callback` is
+// called with the value of each statement as soon as it's evaluated
+template <class Callback>
+void eval_stream(std::istream& in, Callback&& callback,
+                 const std::string& file = "source") {
+    ami::TokenStream stream(in);
+    ami::Parser parser(stream, file);
+    try {
+        while (ptr_t parsed = parser.parse_next()) {
+            ami::Interpreter inter(parser.get_ei());
+            callback(inter.visit(
+                ami::optimize::share_common(ami::optimize::resolve_slots(
+                    ami::optimize::fold_constants(parsed)))));
+        }
+    } catch (const ami::exceptions::BaseException& e) {
+        // the diagnostic points into the stream's current line
+        throw ami::exceptions::BaseException::owning(e.diagnostic());
+    }
 }
 }  // namespace ami
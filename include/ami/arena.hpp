@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// bump allocator for ast nodes, every node of a parse lives in one region and
+// the whole region is released at once. pointers handed out by the parser
+// don't own their node, only the root returned by Parser::parse owns the
+// region (see borrow)
+
+namespace ami {
+class Arena {
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+        std::size_t used;
+    };
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+    };
+    static constexpr std::size_t first_block = 4096;
+    std::vector<Block> m_Blocks;
+    std::vector<Destructor> m_Destructors;
+    void* m_Allocate(std::size_t size, std::size_t align) {
+        if (!m_Blocks.empty()) {
+            Block& b = m_Blocks.back();
+            std::size_t start = (b.used + align - 1) & ~(align - 1);
+            if (start + size <= b.size) {
+                b.used = start + size;
+                return b.data.get() + start;
+            }
+        }
+        // blocks double in size so a parse needs a logarithmic number of them
+        std::size_t next =
+            m_Blocks.empty() ? first_block : m_Blocks.back().size * 2;
+        while (next < size + align) next *= 2;
+        // not make_unique, it would zero the block
+        m_Blocks.push_back(
+            Block{std::unique_ptr<std::byte[]>(new std::byte[next]), next, 0});
+        return m_Allocate(size, align);
+    }
+
+   public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        // grow before constructing so push_back below can't throw
+        if (m_Destructors.size() == m_Destructors.capacity())
+            m_Destructors.reserve(m_Destructors.empty()
+                                      ? 64
+                                      : m_Destructors.capacity() * 2);
+        T* object = new (m_Allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            m_Destructors.push_back(
+                {[](void* p) { static_cast<T*>(p)->~T(); }, object});
+        return object;
+    }
+    // bytes handed out so far
+    std::size_t used() const {
+        std::size_t out = 0;
+        for (auto& b : m_Blocks) out += b.used;
+        return out;
+    }
+    ~Arena() {
+        // children are created before their parents, destroy parents first
+        for (auto it = m_Destructors.rbegin(); it != m_Destructors.rend(); ++it)
+            it->destroy(it->object);
+    }
+};
+// a shared_ptr that points at `object` without owning it, copying it doesn't
+// touch any reference count
+template <class Base, class T>
+std::shared_ptr<Base> borrow(T* object) {
+    return std::shared_ptr<Base>(std::shared_ptr<Base>(), object);
+}
+}  // namespace ami
@@ -1,6 +1,7 @@
 #pragma once
 #include <fmt/core.h>
 
+#include <cstddef>
 #include <iomanip>
 #include <map>
 #include <memory>
@@ -11,9 +12,19 @@
 #include <variant>
 #include <vector>
 
+#include "bigint.hpp"
+#include "intervals.hpp"
 #include "lexer.hpp"
+#include "numbers.hpp"
+#include "symbols.hpp"
 
 namespace ami {
+namespace vm {
+struct Chunk;
+}  // namespace vm
+namespace jit {
+class Code;
+}  // namespace jit
 enum class Op {
     Minus,
     MinusAssign,
@@ -34,7 +45,7 @@ enum class Op {
     Greater,
     Less,
     GreaterOrEqual,
-    LessOrEqual
+    LessOrEqual  // keep it last, see ops_str
 };
 enum class AstType {
     Number,
@@ -64,20 +75,26 @@ enum class AstType {
     UnionExpr,
     IntersectionExpr,
     Comparison,
-    LogicalExpr
+    LogicalExpr,
+    Integer,
+    Fraction
 };
-static std::map<Op, std::string_view> ops_str{
-    {Op::Minus, "-"},        {Op::Plus, "+"},
-    {Op::Div, "/"},          {Op::Mult, "*"},
-    {Op::Pow, "^"},          {Op::Mod, "%"},
-    {Op::MinusAssign, "-="}, {Op::PlusAssign, "+="},
-    {Op::DivAssign, "/="},   {Op::MultAssign, "*="},
-    {Op::PowAssign, "^="},   {Op::ModAssign, "%="},
-    {Op::LogicalAnd, "and"}, {Op::LogicalOr, "or"},
-    {Op::Greater, ">"},      {Op::GreaterOrEqual, ">="},
-    {Op::Less, "<"},         {Op::LessOrEqual, "<="},
-    {Op::Equals, "=="},      {Op::NotEquals, "!="}};
+inline constexpr tables::EnumNames<Op,
+                                   static_cast<std::size_t>(Op::LessOrEqual) + 1>
+    ops_str{{{Op::Minus, "-"},        {Op::Plus, "+"},
+             {Op::Div, "/"},          {Op::Mult, "*"},
+             {Op::Pow, "^"},          {Op::Mod, "%"},
+             {Op::MinusAssign, "-="}, {Op::PlusAssign, "+="},
+             {Op::DivAssign, "/="},   {Op::MultAssign, "*="},
+             {Op::PowAssign, "^="},   {Op::ModAssign, "%="},
+             {Op::LogicalAnd, "and"}, {Op::LogicalOr, "or"},
+             {Op::Greater, ">"},      {Op::GreaterOrEqual, ">="},
+             {Op::Less, "<"},         {Op::LessOrEqual, "<="},
+             {Op::Equals, "=="},      {Op::NotEquals, "!="}}};
 struct Expr {
+    // set by optimize::share_common on the subtrees it merged, the
+    // Interpreter computes them once per run
+    bool shared = false;
     virtual std::string str() = 0;
     virtual AstType type() const = 0;
     virtual std::string to_str() = 0;
@@ -95,12 +112,39 @@ struct Number : public Expr {
     bool operator==(const Number& n) const { return val == n.val; }
     long double operator*(const Number& n) const { return (val * n.val); }
     std::string to_str() override {
+        // 15 digits would round the integers an Integer would have held
+        // exactly, see exact.hpp
+        long double limit =
+            std::ldexp(1.0L, std::numeric_limits<long double>::digits);
+        if (std::fabs(val) >= 1e15 && std::fabs(val) < limit &&
+            val == std::trunc(val))
+            return bigint::Int::from(val).to_string();
         std::stringstream ss;
         ss << std::setprecision(15);
         ss << val;
         return ss.str();
     }
 };
+// an integer a Number can't hold exactly, see exact.hpp
+struct Integer : public Expr {
+    bigint::Int value;
+    explicit Integer(bigint::Int v) : value(std::move(v)) {}
+    std::string str() override {
+        return fmt::format("<Integer value=<{}>>", value.to_string());
+    }
+    AstType type() const override { return AstType::Integer; }
+    std::string to_str() override { return value.to_string(); }
+};
+// the exact quotient of two integers that isn't an integer
+struct Fraction : public Expr {
+    bigint::Rational value;
+    explicit Fraction(bigint::Rational v) : value(std::move(v)) {}
+    std::string str() override {
+        return fmt::format("<Fraction value=<{}>>", value.to_string());
+    }
+    AstType type() const override { return AstType::Fraction; }
+    std::string to_str() override { return value.to_string(); }
+};
 struct Boolean : public Expr {
     bool val;
     std::string raw_value;
@@ -221,20 +265,25 @@ struct OpAndAssignExpr : public Expr {
     }
 };
 struct Identifier : public Expr {
-    std::string name;
-    explicit Identifier(const std::string& name) : name(name) {}
+    static constexpr std::size_t no_slot = -1;
+    symbol_t id;
+    std::string_view name;  // owned by the symbol table
+    // index of the argument it names in the function body it's in, set by
+    // optimize::resolve_slots
+    std::size_t slot = no_slot;
+    explicit Identifier(symbol_t id) : id(id), name(symbols::name(id)) {}
     std::string str() override {
         return fmt::format("<Identifier name=<{}>>", name);
     }
     AstType type() const override { return AstType::Identifier; }
-    std::string to_str() override { return name; }
+    std::string to_str() override { return std::string(name); }
 };
 struct UserDefinedIdentifier : public Expr {
-    std::string name;
+    symbol_t id;
+    std::string_view name;
     std::shared_ptr<Expr> value;
-    UserDefinedIdentifier(const std::string& name,
-                          const std::shared_ptr<Expr>& val)
-        : name(name), value(val) {}
+    UserDefinedIdentifier(symbol_t id, const std::shared_ptr<Expr>& val)
+        : id(id), name(symbols::name(id)), value(val) {}
     std::string str() override {
         return fmt::format("<UserDefinedIdentifier name=<{}>, value=<{}>>",
                            name, value->str());
@@ -245,11 +294,11 @@ struct UserDefinedIdentifier : public Expr {
     }
 };
 struct FunctionCall : public Expr {
-    std::string name;
+    symbol_t id;
+    std::string_view name;
     std::vector<std::shared_ptr<Expr>> arguments;
-    FunctionCall(std::string_view name,
-                 const std::vector<std::shared_ptr<Expr>>& args)
-        : name(name), arguments(args) {}
+    FunctionCall(symbol_t id, const std::vector<std::shared_ptr<Expr>>& args)
+        : id(id), name(symbols::name(id)), arguments(args) {}
     AstType type() const override { return AstType::FunctionCall; }
     std::string str() override {
         std::stringstream ss;
@@ -267,17 +316,33 @@ struct FunctionCall : public Expr {
     std::string to_str() override { return "function call"; }
 };
 struct Function : public Expr {
-    std::string name;
+    symbol_t id;
+    std::string_view name;
     std::size_t call_count;
     std::shared_ptr<Expr> body, ReturnStmt;
     std::vector<std::shared_ptr<Expr>> arguments;
-    Function(std::string_view name, const std::shared_ptr<Expr>& body,
+    // region the body was parsed into, a stored function has to keep it alive
+    std::weak_ptr<void> arena;
+    // bytecode of the body, compiled the first time the vm calls it. null
+    // with `compiled` set when the body can't run on the vm
+    std::shared_ptr<const vm::Chunk> code;
+    bool compiled = false;
+    // machine code of the body when the jit is enabled, see jit.hpp
+    std::shared_ptr<const jit::Code> native;
+    bool native_compiled = false;
+    // whether the calls are memoized, see memo.hpp
+    bool memoized = false, memo_checked = false;
+    Function(symbol_t id, const std::shared_ptr<Expr>& body,
              const std::vector<std::shared_ptr<Expr>>& args)
-        : name(name), call_count(0), body(body), arguments(args) {}
+        : id(id),
+          name(symbols::name(id)),
+          call_count(0),
+          body(body),
+          arguments(args) {}
     AstType type() const override { return AstType::Function; }
     std::string str() override {
         std::string str;
-        str += ("<Function name=<" + name + ">, args=<");
+        str += fmt::format("<Function name=<{}>, args=<", name);
         if (arguments.size() > 0) {
             for (auto& ar : arguments) str += ar->str() + ", ";
         } else {
@@ -344,11 +409,29 @@ struct InExpr : public Expr {
         return fmt::format("{} in {}", number->to_str(), inter->to_str());
     }
 };
+namespace details {
+// "[0; 1] union ]2; 3[", "{}" when there's none
+static std::string intervalsToString(const IntervalSet& set) {
+    if (set.empty()) return "{}";
+    std::string out;
+    for (const auto& in : set.intervals()) {
+        if (!out.empty()) out += " union ";
+        out += fmt::format("{}{}; {}{}", in.min_strict ? ']' : '[',
+                           Number(in.min).to_str(), Number(in.max).to_str(),
+                           in.max_strict ? '[' : ']');
+    }
+    return out;
+}
+}  // namespace details
 struct UnionExpr : public Expr {
     std::shared_ptr<Expr> left_interval, right_interval;
+    // the disjoint intervals of an evaluated union, both operands are then
+    // null
+    IntervalSet intervals;
     UnionExpr(const std::shared_ptr<Expr>& h,
               const std::shared_ptr<Expr>& inter)
         : left_interval(h), right_interval(inter) {}
+    explicit UnionExpr(IntervalSet set) : intervals(std::move(set)) {}
     UnionExpr(const UnionExpr& oth) = default;
     AstType type() const override { return AstType::UnionExpr; }
     std::string str() override {
@@ -356,15 +439,21 @@ struct UnionExpr : public Expr {
                            left_interval->str(), right_interval->str());
     }
     std::string to_str() override {
+        if (left_interval == nullptr)
+            return details::intervalsToString(intervals);
         return fmt::format("{} union {}", left_interval->to_str(),
                            right_interval->to_str());
     }
 };
 struct InterSectionExpr : public Expr {
     std::shared_ptr<Expr> lhs, rhs;
+    // the disjoint intervals of an evaluated intersection, both operands
+    // are then null
+    IntervalSet intervals;
     InterSectionExpr(const std::shared_ptr<Expr>& h,
                      const std::shared_ptr<Expr>& inter)
         : lhs(h), rhs(inter) {}
+    explicit InterSectionExpr(IntervalSet set) : intervals(std::move(set)) {}
     InterSectionExpr(const InterSectionExpr& oth) = default;
     AstType type() const override { return AstType::IntersectionExpr; }
     std::string str() override {
@@ -372,6 +461,7 @@ struct InterSectionExpr : public Expr {
                            lhs->str(), rhs->str());
     }
     std::string to_str() override {
+        if (lhs == nullptr) return details::intervalsToString(intervals);
         return fmt::format("{} intersection {}", lhs->to_str(), rhs->to_str());
     }
 };
@@ -391,6 +481,17 @@ static std::string vecToString(const std::vector<std::shared_ptr<Expr>>& vec,
     out += end;
     return out;
 }
+static std::string numbersToString(const Numbers& nums,
+                                   std::string_view start = "{",
+                                   std::string_view end = "}") {
+    std::string out{start};
+    for (std::size_t x = 0; x < nums.size(); ++x) {
+        if (x != 0) out += ", ";
+        out += Number(nums[x]).to_str();
+    }
+    out += end;
+    return out;
+}
 }  // namespace details
 struct SetObject : public Expr {
     // checking and stuff is handled by the interpreter cuz too lazy
@@ -398,8 +499,11 @@ struct SetObject : public Expr {
     // override it why tf would I overload it for
     // intervals/comparison/logical expressions 😉
     std::vector<std::shared_ptr<Expr>> value;
+    // the sorted elements of an evaluated set, `value` is then empty
+    Numbers numbers;
     explicit SetObject(const std::vector<std::shared_ptr<Expr>>& _v)
         : value(_v) {}
+    explicit SetObject(Numbers nums) : numbers(std::move(nums)) {}
     AstType type() const override { return AstType::SetObject; }
     std::string str() override {
         std::string _str{"<SetObject value={"};
@@ -413,10 +517,19 @@ struct SetObject : public Expr {
         _str += "}>";
         return _str;
     }
-    std::string to_str() override { return details::vecToString(value); }
-    bool operator<(const SetObject& oth) const { return value < oth.value; }
-    bool operator>(const SetObject& oth) const { return value > oth.value; }
-    bool operator==(const SetObject& oth) const { return value == oth.value; }
+    std::string to_str() override {
+        if (value.empty()) return details::numbersToString(numbers);
+        return details::vecToString(value);
+    }
+    bool operator<(const SetObject& oth) const {
+        return numbers < oth.numbers;
+    }
+    bool operator>(const SetObject& oth) const {
+        return numbers > oth.numbers;
+    }
+    bool operator==(const SetObject& oth) const {
+        return numbers == oth.numbers;
+    }
 };
 struct SliceExpr : public Expr {
     std::shared_ptr<Expr> target, index;
@@ -461,9 +574,13 @@ struct SymbolExpr : public Expr {
 struct SetOpExpr : public Expr {};
 struct Point : public Expr {
     std::vector<std::shared_ptr<Expr>> value;
+    // the coordinates of an evaluated point, `value` is then empty
+    Numbers numbers;
     Point(const std::vector<std::shared_ptr<Expr>>& v) : value(v) {}
+    explicit Point(Numbers nums) : numbers(std::move(nums)) {}
     AstType type() const override { return AstType::Point; }
     std::string to_str() override {
+        if (value.empty()) return details::numbersToString(numbers, "(", ")");
         return details::vecToString(value, "(", ")");
     }
     std::string str() override {
@@ -481,7 +598,10 @@ struct Point : public Expr {
 };
 struct Vector : public Expr {
     std::vector<std::shared_ptr<Expr>> value;
+    // the components of an evaluated vector, `value` is then empty
+    Numbers numbers;
     explicit Vector(const std::vector<std::shared_ptr<Expr>>& v) : value(v) {}
+    explicit Vector(Numbers nums) : numbers(std::move(nums)) {}
     AstType type() const override { return AstType::Vector; }
     std::string str() override {
         std::string _str{"<Vector value={"};
@@ -496,16 +616,25 @@ struct Vector : public Expr {
         return _str;
     }
     std::string to_str() override {
+        if (value.empty()) return details::numbersToString(numbers, "[", "]");
         return details::vecToString(value, "[", "]");
     }
-    bool operator<(const Vector& oth) const { return value < oth.value; }
-    bool operator>(const Vector& oth) const { return value > oth.value; }
-    bool operator==(const Vector& oth) const { return value == oth.value; }
+    bool operator<(const Vector& oth) const { return numbers < oth.numbers; }
+    bool operator>(const Vector& oth) const { return numbers > oth.numbers; }
+    bool operator==(const Vector& oth) const {
+        return numbers == oth.numbers;
+    }
 };
 struct Matrix : public Expr {
     std::vector<std::shared_ptr<Expr>>
         value;  // cool interpreter will do the job
+    // the elements of an evaluated matrix row after row, `value` is then
+    // empty
+    std::size_t rows = 0, cols = 0;
+    Numbers numbers;
     explicit Matrix(const std::vector<std::shared_ptr<Expr>>& v) : value(v) {}
+    Matrix(std::size_t rows, std::size_t cols, Numbers nums)
+        : rows(rows), cols(cols), numbers(std::move(nums)) {}
     AstType type() const override { return AstType::Matrix; }
     std::string str() override {
         std::string _str{"<Matrix value={"};
@@ -520,7 +649,108 @@ struct Matrix : public Expr {
         return _str;
     }
     std::string to_str() override {
-        return details::vecToString(value, "[", "]");
+        if (!value.empty()) return details::vecToString(value, "[", "]");
+        std::string out{"["};
+        for (std::size_t i = 0; i < rows; ++i) {
+            if (i != 0) out += ", ";
+            out += "[";
+            for (std::size_t j = 0; j < cols; ++j) {
+                if (j != 0) out += ", ";
+                out += Number(numbers[i * cols + j]).to_str();
+            }
+            out += "]";
+        }
+        out += "]";
+        return out;
+    }
+    bool operator==(const Matrix& oth) const {
+        return rows == oth.rows && cols == oth.cols && numbers == oth.numbers;
     }
 };
+// calls `f` with each operand of `e`
+template <class F>
+void for_each_child(Expr& e, F&& f) {
+    auto each = [&f](std::vector<std::shared_ptr<Expr>>& v) {
+        for (auto& elm : v) f(elm);
+    };
+    switch (e.type()) {
+        case AstType::NegativeExpr:
+            f(static_cast<NegativeExpr&>(e).value);
+            return;
+        case AstType::NotExpr:
+            f(static_cast<NotExpr&>(e).value);
+            return;
+        case AstType::Symbol:
+            f(static_cast<SymbolExpr&>(e).value);
+            return;
+        case AstType::BinaryOp:
+            f(static_cast<BinaryOpExpr&>(e).lhs);
+            f(static_cast<BinaryOpExpr&>(e).rhs);
+            return;
+        case AstType::Comparison:
+            f(static_cast<Comparison&>(e).lhs);
+            f(static_cast<Comparison&>(e).rhs);
+            return;
+        case AstType::LogicalExpr:
+            f(static_cast<LogicalExpr&>(e).lhs);
+            f(static_cast<LogicalExpr&>(e).rhs);
+            return;
+        case AstType::OpAndAssign:
+            f(static_cast<OpAndAssignExpr&>(e).lhs);
+            f(static_cast<OpAndAssignExpr&>(e).rhs);
+            return;
+        case AstType::IntersectionExpr:
+            f(static_cast<InterSectionExpr&>(e).lhs);
+            f(static_cast<InterSectionExpr&>(e).rhs);
+            return;
+        case AstType::UnionExpr:
+            f(static_cast<UnionExpr&>(e).left_interval);
+            f(static_cast<UnionExpr&>(e).right_interval);
+            return;
+        case AstType::InExpr:
+            f(static_cast<InExpr&>(e).number);
+            f(static_cast<InExpr&>(e).inter);
+            return;
+        case AstType::SliceExpr:
+            f(static_cast<SliceExpr&>(e).target);
+            f(static_cast<SliceExpr&>(e).index);
+            return;
+        case AstType::Interval: {
+            auto& interval = static_cast<IntervalExpr&>(e);
+            if (interval.min.value != nullptr) f(interval.min.value);
+            if (interval.max.value != nullptr) f(interval.max.value);
+            return;
+        }
+        case AstType::IfExpr: {
+            auto& iexpr = static_cast<IfExpr&>(e);
+            f(iexpr.cond);
+            f(iexpr.body);
+            if (iexpr.elsestmt != nullptr) f(iexpr.elsestmt);
+            return;
+        }
+        case AstType::UserDefinedIdentifier:
+            f(static_cast<UserDefinedIdentifier&>(e).value);
+            return;
+        case AstType::Function:
+            f(static_cast<Function&>(e).body);
+            return;
+        case AstType::FunctionCall:
+            each(static_cast<FunctionCall&>(e).arguments);
+            return;
+        case AstType::SetObject:
+            each(static_cast<SetObject&>(e).value);
+            return;
+        case AstType::Vector:
+            each(static_cast<Vector&>(e).value);
+            return;
+        case AstType::Point:
+            each(static_cast<Point&>(e).value);
+            return;
+        case AstType::Matrix:
+            each(static_cast<Matrix&>(e).value);
+            return;
+        default:
+            return;
+    }
+}
 }  // namespace ami
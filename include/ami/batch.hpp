@@ -0,0 +1,677 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "errors.hpp"
+#include "exact.hpp"
+#include "lexer.hpp"
+#include "optimize.hpp"
+#include "parser.hpp"
+#include "scope.hpp"
+#include "types.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define AMI_BATCH_AVX2 1
+#define AMI_BATCH_TARGET __attribute__((target("avx2")))
+#endif
+
+// evaluation of one expression over many rows of inputs. the expression is
+// compiled once to a list of kernels, each of them computes one node of the
+// tree for a whole chunk of rows, so the cost of walking the tree is paid
+// once per chunk instead of once per row. identifiers named as columns are
+// read from arrays of doubles, everything is computed in doubles (like the
+// builtins are) and the kernels of the arithmetic, the comparisons and the
+// cheap builtins use AVX2 when the cpu has it. numbers, booleans, the
+// operators, the builtins and `if`s with an `else` are supported, user
+// functions and everything that isn't a number are not
+
+namespace ami {
+namespace batch {
+// rows computed by each kernel call, a register of that many doubles is
+// 2KiB so the registers of most expressions stay in the L1 cache
+inline constexpr std::size_t chunk = 256;
+struct Instr;
+using kernel_t = void (*)(const Instr&, const double* const* in, double* out,
+                          std::size_t n);
+struct Operand {
+    enum class Kind : std::uint8_t { Register, Column } kind;
+    std::uint32_t index;
+};
+struct Instr {
+    kernel_t kernel;
+    std::array<Operand, 3> in;
+    std::uint32_t argc;
+    std::uint32_t out;  // register
+    // for the builtins evaluated one row at a time
+    double (*fn)(double) = nullptr;
+    const builtins::details::FunctionHandler* handler = nullptr;
+};
+// cleared to compile with the scalar kernels even when the cpu has AVX2
+inline bool simd = true;
+namespace details {
+#ifdef AMI_BATCH_AVX2
+inline bool avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported && simd;
+}
+// 1.0 where `mask` is set, 0.0 elsewhere
+AMI_BATCH_TARGET inline __m256d to_bool(__m256d mask) {
+    return _mm256_and_pd(mask, _mm256_set1_pd(1.0));
+}
+AMI_BATCH_TARGET inline __m256d truthy(__m256d v) {
+    return _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_NEQ_UQ);
+}
+#endif
+// each operation has its scalar form and, when it's cheap in AVX2, its
+// vector form. booleans are 1.0 and 0.0, anything but 0 is true like for
+// the Interpreter, NaN included
+struct Add {
+    static double scalar(double a, double b) { return a + b; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return _mm256_add_pd(a, b);
+    }
+#endif
+};
+struct Sub {
+    static double scalar(double a, double b) { return a - b; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return _mm256_sub_pd(a, b);
+    }
+#endif
+};
+struct Mul {
+    static double scalar(double a, double b) { return a * b; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return _mm256_mul_pd(a, b);
+    }
+#endif
+};
+struct Div {
+    static double scalar(double a, double b) { return a / b; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return _mm256_div_pd(a, b);
+    }
+#endif
+};
+struct Pow {
+    static double scalar(double a, double b) { return std::pow(a, b); }
+};
+struct Mod {
+    static double scalar(double a, double b) { return std::fmod(a, b); }
+};
+#ifdef AMI_BATCH_AVX2
+#define AMI_BATCH_COMPARE(name, op, predicate)                         \
+    struct name {                                                      \
+        static double scalar(double a, double b) { return a op b; }    \
+        AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) { \
+            return to_bool(_mm256_cmp_pd(a, b, predicate));            \
+        }                                                              \
+    };
+#else
+#define AMI_BATCH_COMPARE(name, op, predicate)                      \
+    struct name {                                                   \
+        static double scalar(double a, double b) { return a op b; } \
+    };
+#endif
+AMI_BATCH_COMPARE(Greater, >, _CMP_GT_OQ)
+AMI_BATCH_COMPARE(GreaterOrEqual, >=, _CMP_GE_OQ)
+AMI_BATCH_COMPARE(Less, <, _CMP_LT_OQ)
+AMI_BATCH_COMPARE(LessOrEqual, <=, _CMP_LE_OQ)
+AMI_BATCH_COMPARE(Equals, ==, _CMP_EQ_OQ)
+AMI_BATCH_COMPARE(NotEquals, !=, _CMP_NEQ_UQ)
+#undef AMI_BATCH_COMPARE
+struct And {
+    static double scalar(double a, double b) { return a != 0 && b != 0; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return to_bool(_mm256_and_pd(truthy(a), truthy(b)));
+    }
+#endif
+};
+struct Or {
+    static double scalar(double a, double b) { return a != 0 || b != 0; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return to_bool(_mm256_or_pd(truthy(a), truthy(b)));
+    }
+#endif
+};
+// std::fmin and std::fmax give the other operand when one is NaN, the
+// AVX2 instructions give the second one
+struct Min {
+    static double scalar(double a, double b) { return std::fmin(a, b); }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return _mm256_blendv_pd(_mm256_min_pd(a, b), a,
+                                _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+    }
+#endif
+};
+struct Max {
+    static double scalar(double a, double b) { return std::fmax(a, b); }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d a, __m256d b) {
+        return _mm256_blendv_pd(_mm256_max_pd(a, b), a,
+                                _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+    }
+#endif
+};
+struct Negative {
+    static double scalar(double v) { return -v; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d v) {
+        return _mm256_xor_pd(v, _mm256_set1_pd(-0.0));
+    }
+#endif
+};
+struct Abs {
+    static double scalar(double v) { return std::fabs(v); }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d v) {
+        return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+    }
+#endif
+};
+struct Not {
+    static double scalar(double v) { return v == 0; }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d v) {
+        return to_bool(
+            _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_EQ_OQ));
+    }
+#endif
+};
+struct Sqrt {
+    static double scalar(double v) { return std::sqrt(v); }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d v) {
+        return _mm256_sqrt_pd(v);
+    }
+#endif
+};
+struct Floor {
+    static double scalar(double v) { return std::floor(v); }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d v) {
+        return _mm256_floor_pd(v);
+    }
+#endif
+};
+struct Ceil {
+    static double scalar(double v) { return std::ceil(v); }
+#ifdef AMI_BATCH_AVX2
+    AMI_BATCH_TARGET static __m256d vector(__m256d v) {
+        return _mm256_ceil_pd(v);
+    }
+#endif
+};
+// the same products as Interpreter::m_VisitFactorial
+struct Factorial {
+    static double scalar(double v) {
+        if (!std::isfinite(v) || v > 1e7) return INFINITY;
+        long double out = 1;
+        for (long double k = 1; k <= v && std::isfinite(out); ++k) out *= k;
+        return static_cast<double>(out);
+    }
+};
+template <class F>
+void unary(const Instr&, const double* const* in, double* out,
+           std::size_t n) {
+    const double* a = in[0];
+    for (std::size_t i = 0; i < n; ++i) out[i] = F::scalar(a[i]);
+}
+template <class F>
+void binary(const Instr&, const double* const* in, double* out,
+            std::size_t n) {
+    const double *a = in[0], *b = in[1];
+    for (std::size_t i = 0; i < n; ++i) out[i] = F::scalar(a[i], b[i]);
+}
+// `if` with both of its parts computed, the condition picks one per row
+inline void select(const Instr&, const double* const* in, double* out,
+                   std::size_t n) {
+    const double *cond = in[0], *body = in[1], *other = in[2];
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = cond[i] != 0 ? body[i] : other[i];
+}
+// out may be one of the operands, each element is read before it's written
+#ifdef AMI_BATCH_AVX2
+template <class F>
+AMI_BATCH_TARGET void unary_avx2(const Instr&, const double* const* in,
+                                 double* out, std::size_t n) {
+    const double* a = in[0];
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, F::vector(_mm256_loadu_pd(a + i)));
+    for (; i < n; ++i) out[i] = F::scalar(a[i]);
+}
+template <class F>
+AMI_BATCH_TARGET void binary_avx2(const Instr&, const double* const* in,
+                                  double* out, std::size_t n) {
+    const double *a = in[0], *b = in[1];
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, F::vector(_mm256_loadu_pd(a + i),
+                                            _mm256_loadu_pd(b + i)));
+    for (; i < n; ++i) out[i] = F::scalar(a[i], b[i]);
+}
+AMI_BATCH_TARGET inline void select_avx2(const Instr&, const double* const* in,
+                                         double* out, std::size_t n) {
+    const double *cond = in[0], *body = in[1], *other = in[2];
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(
+            out + i, _mm256_blendv_pd(_mm256_loadu_pd(other + i),
+                                      _mm256_loadu_pd(body + i),
+                                      truthy(_mm256_loadu_pd(cond + i))));
+    for (; i < n; ++i) out[i] = cond[i] != 0 ? body[i] : other[i];
+}
+#endif
+template <class F>
+kernel_t unary_kernel() {
+#ifdef AMI_BATCH_AVX2
+    if (avx2()) return unary_avx2<F>;
+#endif
+    return unary<F>;
+}
+template <class F>
+kernel_t binary_kernel() {
+#ifdef AMI_BATCH_AVX2
+    if (avx2()) return binary_avx2<F>;
+#endif
+    return binary<F>;
+}
+inline kernel_t select_kernel() {
+#ifdef AMI_BATCH_AVX2
+    if (avx2()) return select_avx2;
+#endif
+    return select;
+}
+// builtins without a vector form, one call per row
+inline void apply(const Instr& ins, const double* const* in, double* out,
+                  std::size_t n) {
+    const double* a = in[0];
+    for (std::size_t i = 0; i < n; ++i) out[i] = ins.fn(a[i]);
+}
+// the builtin's own handler, for the ones that aren't only arithmetic
+inline void call(const Instr& ins, const double* const* in, double* out,
+                 std::size_t n) {
+    arg_t args(ins.argc, Number(0));
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::uint32_t k = 0; k < ins.argc; ++k)
+            std::get<Number>(args[k]).val = in[k][i];
+        out[i] = static_cast<double>(
+            *exact::to_long_double(ins.handler->callback(args)));
+    }
+}
+// the types the Interpreter gives the values of a node, Mixed for an `if`
+// whose parts have different ones
+enum class Type : std::uint8_t { Number, Boolean, Mixed };
+struct Error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+class Compiler;
+}  // namespace details
+class Program {
+    std::vector<Instr> m_Code;
+    // registers filled with a constant once for all the chunks
+    std::vector<std::pair<std::uint32_t, double>> m_Constants;
+    std::uint32_t m_Registers = 0;
+    std::size_t m_Columns = 0;
+    Operand m_Result{};
+    bool m_Boolean = false;
+    friend class details::Compiler;
+
+   public:
+    // number of input columns, in the order they were named in compile
+    std::size_t columns() const { return m_Columns; }
+    // whether the values are booleans, 1 for true and 0 for false
+    bool boolean() const { return m_Boolean; }
+    // out[i] is the value of the expression for the i-th element of each
+    // column, `columns` holds a pointer to `rows` doubles for each of them
+    void run(const double* const* columns, std::size_t rows,
+             double* out) const {
+        std::vector<double> regs(std::size_t(m_Registers) * chunk);
+        for (const auto& [reg, value] : m_Constants)
+            std::fill_n(regs.data() + std::size_t(reg) * chunk, chunk, value);
+        std::array<const double*, 3> in{};
+        for (std::size_t row = 0; row < rows; row += chunk) {
+            std::size_t n = std::min(chunk, rows - row);
+            auto at = [&](const Operand& o) -> const double* {
+                if (o.kind == Operand::Kind::Column)
+                    return columns[o.index] + row;
+                return regs.data() + std::size_t(o.index) * chunk;
+            };
+            for (const Instr& ins : m_Code) {
+                for (std::uint32_t k = 0; k < ins.argc; ++k)
+                    in[k] = at(ins.in[k]);
+                ins.kernel(ins, in.data(),
+                           regs.data() + std::size_t(ins.out) * chunk, n);
+            }
+            const double* result = at(m_Result);
+            std::copy(result, result + n, out + row);
+        }
+    }
+    void run(const std::vector<const double*>& columns, std::size_t rows,
+             double* out) const {
+        run(columns.data(), rows, out);
+    }
+};
+namespace details {
+class Compiler {
+    Program m_Program;
+    std::unordered_map<symbol_t, std::uint32_t> m_Columns;
+    // constants are numbered apart from the registers, they follow them
+    // once the deepest register is known
+    std::vector<double> m_Constants;
+    std::uint32_t m_Depth = 0;
+    static constexpr std::uint32_t constant_bit = 1u << 31;
+
+    Operand m_Constant(double value) {
+        m_Constants.push_back(value);
+        return {Operand::Kind::Register,
+                constant_bit | static_cast<std::uint32_t>(
+                                   m_Constants.size() - 1)};
+    }
+    Operand m_Emit(kernel_t kernel, std::uint32_t depth,
+                   std::initializer_list<Operand> in) {
+        Instr ins{};
+        ins.kernel = kernel;
+        std::copy(in.begin(), in.end(), ins.in.begin());
+        ins.argc = static_cast<std::uint32_t>(in.size());
+        ins.out = depth;
+        m_Program.m_Code.push_back(ins);
+        m_Depth = std::max(m_Depth, depth + 1);
+        return {Operand::Kind::Register, depth};
+    }
+    [[noreturn]] static void m_Err(const std::string& msg) { throw Error(msg); }
+    static std::string_view m_Name(Op op) { return ops_str.at(op); }
+    Operand m_Ident(const Identifier* ident, Type& type) {
+        type = Type::Number;
+        auto it = m_Columns.find(ident->id);
+        if (it != m_Columns.end())
+            return {Operand::Kind::Column, it->second};
+        if (const long double* c = builtins::constant(ident->id))
+            return m_Constant(static_cast<double>(*c));
+        // globals are read once, when the expression is compiled
+        if (const val_t* v = scope::lookup(scope::userdefined, ident->id)) {
+            if (auto* b = std::get_if<Boolean>(v)) {
+                type = Type::Boolean;
+                return m_Constant(b->val);
+            }
+            if (auto n = exact::to_long_double(*v))
+                return m_Constant(static_cast<double>(*n));
+            m_Err(fmt::format("'{}' isn't a number", ident->name));
+        }
+        m_Err(fmt::format("use of undeclared identifier '{}'", ident->name));
+    }
+    // the operands of an operator are computed in the registers at and
+    // right after `depth`, it writes its value over the first one
+    Operand m_Binary(Op op, const Expr* lhs, const Expr* rhs,
+                     std::uint32_t depth, Type& type) {
+        Type lt, rt;
+        Operand l = m_Visit(lhs, depth, lt), r = m_Visit(rhs, depth + 1, rt);
+        bool numbers = lt == Type::Number && rt == Type::Number;
+        type = Type::Boolean;
+        switch (op) {
+            case Op::Plus:
+            case Op::Minus:
+            case Op::Mult:
+            case Op::Div:
+            case Op::Pow:
+            case Op::Mod:
+                if (!numbers)
+                    m_Err(fmt::format(
+                        "binary operation '{}' is not valid in this context",
+                        m_Name(op)));
+                type = Type::Number;
+                break;
+            default:
+                break;
+        }
+        switch (op) {
+            case Op::Plus:
+                return m_Emit(binary_kernel<Add>(), depth, {l, r});
+            case Op::Minus:
+                return m_Emit(binary_kernel<Sub>(), depth, {l, r});
+            case Op::Mult:
+                return m_Emit(binary_kernel<Mul>(), depth, {l, r});
+            case Op::Div:
+                return m_Emit(binary_kernel<Div>(), depth, {l, r});
+            case Op::Pow:
+                return m_Emit(binary<Pow>, depth, {l, r});
+            case Op::Mod:
+                return m_Emit(binary<Mod>, depth, {l, r});
+            case Op::Greater:
+                return m_Emit(binary_kernel<Greater>(), depth, {l, r});
+            case Op::GreaterOrEqual:
+                return m_Emit(binary_kernel<GreaterOrEqual>(), depth, {l, r});
+            case Op::Less:
+                return m_Emit(binary_kernel<Less>(), depth, {l, r});
+            case Op::LessOrEqual:
+                return m_Emit(binary_kernel<LessOrEqual>(), depth, {l, r});
+            case Op::Equals:
+                return m_Emit(binary_kernel<Equals>(), depth, {l, r});
+            case Op::NotEquals:
+                return m_Emit(binary_kernel<NotEquals>(), depth, {l, r});
+            case Op::LogicalAnd:
+                return m_Emit(binary_kernel<And>(), depth, {l, r});
+            case Op::LogicalOr:
+                return m_Emit(binary_kernel<Or>(), depth, {l, r});
+            default:
+                m_Err(fmt::format("invalid operator '{}'", m_Name(op)));
+        }
+    }
+    Operand m_Number(const Expr* value, std::uint32_t depth, const char* what) {
+        Type t;
+        Operand out = m_Visit(value, depth, t);
+        if (t != Type::Number) m_Err(what);
+        return out;
+    }
+    Operand m_Call(const FunctionCall* fc, std::uint32_t depth, Type& type) {
+        using namespace builtins::details;
+        const auto* handler = builtins::function(fc->id);
+        if (handler == nullptr)
+            m_Err(fmt::format("user function '{}' can't be called in a batch",
+                              fc->name));
+        if (handler->args_count != fc->arguments.size())
+            m_Err(fmt::format("'{}' takes {} arguments", fc->name,
+                              handler->args_count));
+        std::array<Operand, 2> args{};
+        for (std::size_t i = 0; i < fc->arguments.size(); ++i)
+            args[i] = m_Number(fc->arguments[i].get(),
+                               depth + static_cast<std::uint32_t>(i),
+                               "expected number in function args");
+        type = Type::Number;
+        auto cb = handler->callback;
+        if (cb == b_sqrt)
+            return m_Emit(unary_kernel<Sqrt>(), depth, {args[0]});
+        if (cb == b_abs) return m_Emit(unary_kernel<Abs>(), depth, {args[0]});
+        if (cb == b_floor)
+            return m_Emit(unary_kernel<Floor>(), depth, {args[0]});
+        if (cb == b_ceil)
+            return m_Emit(unary_kernel<Ceil>(), depth, {args[0]});
+        if (cb == b_min)
+            return m_Emit(binary_kernel<Min>(), depth, {args[0], args[1]});
+        if (cb == b_max)
+            return m_Emit(binary_kernel<Max>(), depth, {args[0], args[1]});
+        // the same functions as the handlers, they only take doubles
+        double (*fn)(double) = nullptr;
+        if (cb == b_sin) fn = [](double v) { return std::sin(v); };
+        if (cb == b_cos) fn = [](double v) { return std::cos(v); };
+        if (cb == b_tan) fn = [](double v) { return std::tan(v); };
+        if (cb == b_sinh) fn = [](double v) { return std::sinh(v); };
+        if (cb == b_cosh) fn = [](double v) { return std::cosh(v); };
+        if (cb == b_log) fn = [](double v) { return std::log(v); };
+        if (cb == b_log10) fn = [](double v) { return std::log10(v); };
+        if (cb == b_log2) fn = [](double v) { return std::log2(v); };
+        if (cb == b_round) fn = [](double v) { return std::round(v); };
+        Operand out;
+        if (fn != nullptr) {
+            out = m_Emit(apply, depth, {args[0]});
+            m_Program.m_Code.back().fn = fn;
+        } else if (cb == b_gcd || cb == b_lcm) {
+            out = m_Emit(call, depth, {args[0], args[1]});
+            m_Program.m_Code.back().handler = handler;
+        } else {
+            m_Err(fmt::format("'{}' can't be called in a batch", fc->name));
+        }
+        return out;
+    }
+    Operand m_Visit(const Expr* e, std::uint32_t depth, Type& type) {
+        switch (e->type()) {
+            case AstType::Number:
+                type = Type::Number;
+                return m_Constant(
+                    static_cast<double>(static_cast<const Number*>(e)->val));
+            case AstType::Integer:
+            case AstType::Fraction: {
+                // rounded like the rest, everything is a double
+                type = Type::Number;
+                val_t v = e->type() == AstType::Integer
+                              ? val_t(*static_cast<const Integer*>(e))
+                              : val_t(*static_cast<const Fraction*>(e));
+                return m_Constant(
+                    static_cast<double>(*exact::to_long_double(v)));
+            }
+            case AstType::Boolean:
+                type = Type::Boolean;
+                return m_Constant(static_cast<const Boolean*>(e)->val);
+            case AstType::Identifier:
+                return m_Ident(static_cast<const Identifier*>(e), type);
+            case AstType::NegativeExpr: {
+                type = Type::Number;
+                Operand v =
+                    m_Number(static_cast<const NegativeExpr*>(e)->value.get(),
+                             depth,
+                             "binary operation '-' is not valid in this "
+                             "context");
+                return m_Emit(unary_kernel<Negative>(), depth, {v});
+            }
+            case AstType::NotExpr: {
+                Type t;
+                Operand v = m_Visit(static_cast<const NotExpr*>(e)->value.get(),
+                                    depth, t);
+                type = Type::Boolean;
+                return m_Emit(unary_kernel<Not>(), depth, {v});
+            }
+            case AstType::BinaryOp: {
+                auto* b = static_cast<const BinaryOpExpr*>(e);
+                return m_Binary(b->op, b->lhs.get(), b->rhs.get(), depth,
+                                type);
+            }
+            case AstType::Comparison: {
+                auto* c = static_cast<const Comparison*>(e);
+                return m_Binary(c->op, c->lhs.get(), c->rhs.get(), depth,
+                                type);
+            }
+            case AstType::LogicalExpr: {
+                auto* l = static_cast<const LogicalExpr*>(e);
+                return m_Binary(l->op, l->lhs.get(), l->rhs.get(), depth,
+                                type);
+            }
+            case AstType::Symbol: {
+                auto* s = static_cast<const SymbolExpr*>(e);
+                type = Type::Number;
+                if (s->symbol == Symbol::Norm)
+                    m_Err("can only compute the norm of a vector");
+                if (s->symbol == Symbol::Abs)
+                    return m_Emit(
+                        unary_kernel<Abs>(), depth,
+                        {m_Number(s->value.get(), depth, "invalid type")});
+                return m_Emit(
+                    unary<Factorial>, depth,
+                    {m_Number(s->value.get(), depth, "invalid use of '!'")});
+            }
+            case AstType::FunctionCall:
+                return m_Call(static_cast<const FunctionCall*>(e), depth, type);
+            case AstType::IfExpr: {
+                // both parts are computed for every row, they have no side
+                // effects
+                auto* iexpr = static_cast<const IfExpr*>(e);
+                if (iexpr->elsestmt == nullptr)
+                    m_Err("an 'if' needs an 'else' in a batch");
+                Type ct, bt, et;
+                Operand c = m_Visit(iexpr->cond.get(), depth, ct);
+                Operand b = m_Visit(iexpr->body.get(), depth + 1, bt);
+                Operand o = m_Visit(iexpr->elsestmt.get(), depth + 2, et);
+                type = bt == et ? bt : Type::Mixed;
+                return m_Emit(select_kernel(), depth, {c, b, o});
+            }
+            default:
+                m_Err("this expression can't be evaluated in a batch");
+        }
+    }
+    Operand m_Fix(Operand o) const {
+        if (o.kind == Operand::Kind::Register && (o.index & constant_bit))
+            o.index = m_Depth + (o.index & ~constant_bit);
+        return o;
+    }
+
+   public:
+    explicit Compiler(const std::vector<std::string_view>& columns) {
+        for (std::size_t i = 0; i < columns.size(); ++i) {
+            symbol_t id = symbols::intern(columns[i]);
+            // the folder would replace them with the constant
+            if (builtins::constant(id) != nullptr)
+                m_Err(fmt::format("column '{}' is a builtin constant",
+                                  columns[i]));
+            m_Columns.emplace(id, static_cast<std::uint32_t>(i));
+        }
+        m_Program.m_Columns = columns.size();
+    }
+    Program compile(const Expr* root) {
+        Type type;
+        Operand result = m_Visit(root, 0, type);
+        // constants are placed after the deepest register
+        for (Instr& ins : m_Program.m_Code)
+            for (std::uint32_t k = 0; k < ins.argc; ++k)
+                ins.in[k] = m_Fix(ins.in[k]);
+        m_Program.m_Result = m_Fix(result);
+        for (std::size_t i = 0; i < m_Constants.size(); ++i)
+            m_Program.m_Constants.emplace_back(
+                m_Depth + static_cast<std::uint32_t>(i), m_Constants[i]);
+        m_Program.m_Registers =
+            m_Depth + static_cast<std::uint32_t>(m_Constants.size());
+        m_Program.m_Boolean = type == Type::Boolean;
+        return std::move(m_Program);
+    }
+};
+}  // namespace details
+// compiles `expression` for Program::run, the identifiers in `columns` are
+// read from the arrays given to it in the same order. the diagnostic
+// borrows `expression` and `file`
+inline Result<Program> compile(std::string_view expression,
+                               const std::vector<std::string_view>& columns,
+                               std::string_view file = "source") {
+    try {
+        ami::Lexer lexer(expression);
+        ami::Parser parser(lexer.lex(), expression, file);
+        details::Compiler compiler(columns);
+        auto parsed = optimize::fold_constants(parser.parse());
+        return compiler.compile(parsed.get());
+    } catch (const exceptions::BaseException& e) {
+        return e.diagnostic();
+    } catch (const details::Error& e) {
+        return exceptions::Diagnostic(exceptions::ErrorCode::Error, e.what(),
+                                      file, expression);
+    }
+}
+}  // namespace batch
+}  // namespace ami
@@ -0,0 +1,480 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// arbitrary precision integers and exact quotients of them. a magnitude is
+// a vector of 32 bit limbs, least significant first, with no leading zero
+// limb so zero has none. products of big operands use Karatsuba, division
+// is Knuth's algorithm D
+
+namespace ami {
+namespace bigint {
+using limb_t = std::uint32_t;
+using wide_t = std::uint64_t;
+using mag_t = std::vector<limb_t>;
+// results that would have more bits than this aren't computed exactly, they
+// overflow like long doubles do
+inline constexpr std::size_t max_bits = std::size_t(1) << 20;
+// below this many limbs the schoolbook product is faster
+inline constexpr std::size_t karatsuba_threshold = 32;
+namespace details {
+inline void trim(mag_t& a) {
+    while (!a.empty() && a.back() == 0) a.pop_back();
+}
+inline int compare(const mag_t& a, const mag_t& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (std::size_t i = a.size(); i-- > 0;)
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+inline std::size_t bits(const mag_t& a) {
+    if (a.empty()) return 0;
+    std::size_t top = 0;
+    for (limb_t l = a.back(); l != 0; l >>= 1) ++top;
+    return (a.size() - 1) * 32 + top;
+}
+// a + (b << 32 * shift)
+inline void add_to(mag_t& a, const mag_t& b, std::size_t shift = 0) {
+    if (b.empty()) return;
+    if (a.size() < b.size() + shift) a.resize(b.size() + shift);
+    wide_t carry = 0;
+    std::size_t i = 0;
+    for (; i < b.size(); ++i) {
+        carry += static_cast<wide_t>(a[i + shift]) + b[i];
+        a[i + shift] = static_cast<limb_t>(carry);
+        carry >>= 32;
+    }
+    for (i += shift; carry != 0; ++i) {
+        if (i == a.size()) a.push_back(0);
+        carry += a[i];
+        a[i] = static_cast<limb_t>(carry);
+        carry >>= 32;
+    }
+}
+// a - b, a isn't smaller than b
+inline void sub_from(mag_t& a, const mag_t& b) {
+    std::int64_t borrow = 0;
+    for (std::size_t i = 0; i < a.size() && (i < b.size() || borrow); ++i) {
+        std::int64_t d = static_cast<std::int64_t>(a[i]) - borrow -
+                         (i < b.size() ? static_cast<std::int64_t>(b[i]) : 0);
+        borrow = d < 0;
+        a[i] = static_cast<limb_t>(d);
+    }
+    trim(a);
+}
+inline mag_t add(const mag_t& a, const mag_t& b) {
+    mag_t out = a;
+    add_to(out, b);
+    return out;
+}
+inline mag_t sub(const mag_t& a, const mag_t& b) {
+    mag_t out = a;
+    sub_from(out, b);
+    return out;
+}
+// a * k + c
+inline void mul_small(mag_t& a, limb_t k, limb_t c = 0) {
+    wide_t carry = c;
+    for (limb_t& l : a) {
+        carry += static_cast<wide_t>(l) * k;
+        l = static_cast<limb_t>(carry);
+        carry >>= 32;
+    }
+    if (carry != 0) a.push_back(static_cast<limb_t>(carry));
+    trim(a);
+}
+// a / k, returns the remainder
+inline limb_t div_small(mag_t& a, limb_t k) {
+    wide_t rem = 0;
+    for (std::size_t i = a.size(); i-- > 0;) {
+        rem = rem << 32 | a[i];
+        a[i] = static_cast<limb_t>(rem / k);
+        rem %= k;
+    }
+    trim(a);
+    return static_cast<limb_t>(rem);
+}
+inline mag_t schoolbook(const mag_t& a, const mag_t& b) {
+    mag_t out(a.size() + b.size());
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (a[i] == 0) continue;
+        wide_t carry = 0;
+        for (std::size_t j = 0; j < b.size(); ++j) {
+            carry += static_cast<wide_t>(a[i]) * b[j] + out[i + j];
+            out[i + j] = static_cast<limb_t>(carry);
+            carry >>= 32;
+        }
+        out[i + b.size()] = static_cast<limb_t>(carry);
+    }
+    trim(out);
+    return out;
+}
+// the limbs of `a` in [from, to)
+inline mag_t slice(const mag_t& a, std::size_t from, std::size_t to) {
+    from = std::min(from, a.size());
+    to = std::min(to, a.size());
+    mag_t out(a.begin() + from, a.begin() + to);
+    trim(out);
+    return out;
+}
+// a * b = z2 B^2 + (z1 - z2 - z0) B + z0 with B = 2^(32 h) and three half
+// size products
+inline mag_t mul(const mag_t& a, const mag_t& b) {
+    if (a.empty() || b.empty()) return {};
+    if (std::min(a.size(), b.size()) < karatsuba_threshold)
+        return schoolbook(a, b);
+    std::size_t h = std::max(a.size(), b.size()) / 2;
+    mag_t a0 = slice(a, 0, h), a1 = slice(a, h, a.size());
+    mag_t b0 = slice(b, 0, h), b1 = slice(b, h, b.size());
+    mag_t z0 = mul(a0, b0), z2 = mul(a1, b1);
+    mag_t z1 = mul(add(a0, a1), add(b0, b1));
+    sub_from(z1, z0);
+    sub_from(z1, z2);
+    mag_t out = z0;
+    add_to(out, z1, h);
+    add_to(out, z2, 2 * h);
+    return out;
+}
+inline mag_t shift_left(const mag_t& a, unsigned s) {
+    mag_t out(a.size() + 1);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        out[i] |= a[i] << s;
+        if (s != 0) out[i + 1] = a[i] >> (32 - s);
+    }
+    return out;
+}
+// q = a / b and r = a % b, b isn't zero
+inline void divmod(const mag_t& a, const mag_t& b, mag_t& q, mag_t& r) {
+    if (compare(a, b) < 0) {
+        q.clear();
+        r = a;
+        return;
+    }
+    if (b.size() == 1) {
+        q = a;
+        limb_t rem = div_small(q, b[0]);
+        r = rem != 0 ? mag_t{rem} : mag_t{};
+        return;
+    }
+    // the divisor is shifted so its top limb has its high bit set, that
+    // keeps the estimate of each quotient limb off by at most 2
+    unsigned s = 0;
+    while ((b.back() << s & 0x80000000u) == 0) ++s;
+    mag_t u = shift_left(a, s), v = shift_left(b, s);
+    v.pop_back();
+    const std::size_t n = v.size(), m = a.size() - n;
+    const wide_t base = wide_t(1) << 32;
+    q.assign(m + 1, 0);
+    for (std::size_t j = m + 1; j-- > 0;) {
+        wide_t num = static_cast<wide_t>(u[j + n]) << 32 | u[j + n - 1];
+        wide_t qhat = num / v[n - 1], rhat = num % v[n - 1];
+        while (qhat >= base ||
+               qhat * v[n - 2] > (rhat << 32 | u[j + n - 2])) {
+            --qhat;
+            rhat += v[n - 1];
+            if (rhat >= base) break;
+        }
+        std::int64_t borrow = 0;
+        wide_t carry = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            wide_t p = qhat * v[i] + carry;
+            carry = p >> 32;
+            std::int64_t t = static_cast<std::int64_t>(u[i + j]) - borrow -
+                             static_cast<std::int64_t>(p & 0xffffffffu);
+            u[i + j] = static_cast<limb_t>(t);
+            borrow = t < 0;
+        }
+        std::int64_t t = static_cast<std::int64_t>(u[j + n]) - borrow -
+                         static_cast<std::int64_t>(carry);
+        u[j + n] = static_cast<limb_t>(t);
+        if (t < 0) {
+            // the estimate was one too big, add the divisor back
+            --qhat;
+            carry = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                carry += static_cast<wide_t>(u[i + j]) + v[i];
+                u[i + j] = static_cast<limb_t>(carry);
+                carry >>= 32;
+            }
+            u[j + n] += static_cast<limb_t>(carry);
+        }
+        q[j] = static_cast<limb_t>(qhat);
+    }
+    trim(q);
+    r.assign(n, 0);
+    for (std::size_t i = 0; i < n; ++i)
+        r[i] = s == 0 ? u[i] : (u[i] >> s | u[i + 1] << (32 - s));
+    trim(r);
+}
+// the product of the integers in [lo, hi], split in halves so the big
+// products are between operands of the same size
+inline mag_t product(std::uint64_t lo, std::uint64_t hi) {
+    if (hi - lo < 16) {
+        mag_t out{1};
+        for (std::uint64_t k = lo; k <= hi; ++k)
+            mul_small(out, static_cast<limb_t>(k));
+        return out;
+    }
+    std::uint64_t mid = lo + (hi - lo) / 2;
+    return mul(product(lo, mid), product(mid + 1, hi));
+}
+}  // namespace details
+class Int {
+    bool m_Negative = false;
+    mag_t m_Mag;
+    Int(bool negative, mag_t mag)
+        : m_Negative(negative && !mag.empty()), m_Mag(std::move(mag)) {}
+
+   public:
+    Int() = default;
+    Int(std::uint64_t v) {
+        for (; v != 0; v >>= 32) m_Mag.push_back(static_cast<limb_t>(v));
+    }
+    // `v` has to be an integer
+    static Int from(long double v) {
+        int exp = 0;
+        long double frac = std::frexp(std::fabs(v), &exp);
+        Int out;
+        // 32 bits at a time, a long double has at most 113 of them
+        int taken = 0;
+        for (; frac != 0 && taken < exp; taken += 32) {
+            frac = std::ldexp(frac, 32);
+            long double top = std::floor(frac);
+            frac -= top;
+            out = (out << 32) + Int(static_cast<wide_t>(top));
+        }
+        // out is |v| * 2^(taken - exp)
+        if (taken > exp) out = out >> (taken - exp);
+        else out = out << (exp - taken);
+        out.m_Negative = v < 0 && !out.zero();
+        return out;
+    }
+    // decimal digits with optional ' separators
+    static Int parse(std::string_view text) {
+        mag_t mag;
+        limb_t chunk = 0, scale = 1;
+        for (char c : text) {
+            if (c < '0' || c > '9') continue;
+            chunk = chunk * 10 + (c - '0');
+            scale *= 10;
+            if (scale == 1'000'000'000) {
+                details::mul_small(mag, scale, chunk);
+                chunk = 0;
+                scale = 1;
+            }
+        }
+        if (scale != 1) details::mul_small(mag, scale, chunk);
+        return Int(false, std::move(mag));
+    }
+    bool zero() const { return m_Mag.empty(); }
+    bool negative() const { return m_Negative; }
+    std::size_t bits() const { return details::bits(m_Mag); }
+    bool odd() const { return !m_Mag.empty() && (m_Mag[0] & 1); }
+    // the mantissa in [0.5, 1) and the exponent of the value, it can be out
+    // of the range of a long double
+    long double frexp(long long& exp) const {
+        if (zero()) {
+            exp = 0;
+            return 0;
+        }
+        // the top 4 limbs hold more bits than any long double mantissa
+        std::size_t top = std::min<std::size_t>(m_Mag.size(), 4);
+        long double acc = 0;
+        for (std::size_t i = m_Mag.size(); i-- > m_Mag.size() - top;)
+            acc = acc * 4294967296.0L + m_Mag[i];
+        int e = 0;
+        long double m = std::frexp(acc, &e);
+        exp = e + 32 * static_cast<long long>(m_Mag.size() - top);
+        return m_Negative ? -m : m;
+    }
+    long double to_long_double() const {
+        long long exp = 0;
+        long double m = frexp(exp);
+        return exp > 20'000 ? (m < 0 ? -HUGE_VALL : HUGE_VALL)
+                            : std::ldexp(m, static_cast<int>(exp));
+    }
+    std::string to_string() const {
+        if (zero()) return "0";
+        std::string out;
+        mag_t mag = m_Mag;
+        while (!mag.empty()) {
+            limb_t chunk = details::div_small(mag, 1'000'000'000);
+            for (int i = 0; i < 9 && (!mag.empty() || chunk != 0); ++i) {
+                out.push_back(static_cast<char>('0' + chunk % 10));
+                chunk /= 10;
+            }
+        }
+        if (m_Negative) out.push_back('-');
+        std::reverse(out.begin(), out.end());
+        return out;
+    }
+    Int operator-() const { return Int(!m_Negative, m_Mag); }
+    Int abs() const { return Int(false, m_Mag); }
+    friend Int operator+(const Int& a, const Int& b) {
+        if (a.m_Negative == b.m_Negative)
+            return Int(a.m_Negative, details::add(a.m_Mag, b.m_Mag));
+        if (details::compare(a.m_Mag, b.m_Mag) >= 0)
+            return Int(a.m_Negative, details::sub(a.m_Mag, b.m_Mag));
+        return Int(b.m_Negative, details::sub(b.m_Mag, a.m_Mag));
+    }
+    friend Int operator-(const Int& a, const Int& b) { return a + -b; }
+    friend Int operator*(const Int& a, const Int& b) {
+        return Int(a.m_Negative != b.m_Negative,
+                   details::mul(a.m_Mag, b.m_Mag));
+    }
+    // truncated like the division of C++ integers, `b` isn't zero
+    static void divmod(const Int& a, const Int& b, Int& q, Int& r) {
+        mag_t qm, rm;
+        details::divmod(a.m_Mag, b.m_Mag, qm, rm);
+        q = Int(a.m_Negative != b.m_Negative, std::move(qm));
+        r = Int(a.m_Negative, std::move(rm));
+    }
+    friend Int operator/(const Int& a, const Int& b) {
+        Int q, r;
+        divmod(a, b, q, r);
+        return q;
+    }
+    friend Int operator%(const Int& a, const Int& b) {
+        Int q, r;
+        divmod(a, b, q, r);
+        return r;
+    }
+    friend Int operator<<(const Int& a, std::size_t n) {
+        mag_t mag(n / 32, 0);
+        mag_t shifted = details::shift_left(a.m_Mag, n % 32);
+        mag.insert(mag.end(), shifted.begin(), shifted.end());
+        details::trim(mag);
+        return Int(a.m_Negative, std::move(mag));
+    }
+    friend Int operator>>(const Int& a, std::size_t n) {
+        mag_t mag = details::slice(a.m_Mag, n / 32, a.m_Mag.size());
+        unsigned s = n % 32;
+        if (s != 0) {
+            for (std::size_t i = 0; i < mag.size(); ++i)
+                mag[i] = mag[i] >> s |
+                         (i + 1 < mag.size() ? mag[i + 1] << (32 - s) : 0);
+            details::trim(mag);
+        }
+        return Int(a.m_Negative, std::move(mag));
+    }
+    friend int compare(const Int& a, const Int& b) {
+        if (a.m_Negative != b.m_Negative) return a.m_Negative ? -1 : 1;
+        int c = details::compare(a.m_Mag, b.m_Mag);
+        return a.m_Negative ? -c : c;
+    }
+    friend bool operator==(const Int& a, const Int& b) {
+        return a.m_Negative == b.m_Negative && a.m_Mag == b.m_Mag;
+    }
+    friend bool operator!=(const Int& a, const Int& b) { return !(a == b); }
+    friend bool operator<(const Int& a, const Int& b) {
+        return compare(a, b) < 0;
+    }
+    // `base` to the power `exp` by squaring, nothing when the result would
+    // have more than max_bits bits
+    static std::optional<Int> pow(const Int& base, std::uint64_t exp) {
+        if (base.bits() > 1 &&
+            (exp > max_bits || (base.bits() - 1) * exp > max_bits))
+            return std::nullopt;
+        Int out(1), sq = base;
+        for (; exp != 0; exp >>= 1) {
+            if (exp & 1) out = out * sq;
+            if (exp > 1) sq = sq * sq;
+        }
+        return out;
+    }
+    static Int gcd(Int a, Int b) {
+        a.m_Negative = b.m_Negative = false;
+        while (!b.zero()) {
+            Int r = a % b;
+            a = std::move(b);
+            b = std::move(r);
+        }
+        return a;
+    }
+    // nothing when the result would have more than max_bits bits
+    static std::optional<Int> factorial(std::uint64_t n) {
+        if (std::lgamma(static_cast<double>(n) + 1) / std::log(2.0) >
+            static_cast<double>(max_bits))
+            return std::nullopt;
+        return n < 2 ? Int(1) : Int(false, details::product(2, n));
+    }
+};
+// a quotient of integers, always reduced with a positive denominator
+class Rational {
+    Int m_Num, m_Den{1};
+    void m_Reduce() {
+        if (m_Den.negative()) {
+            m_Num = -m_Num;
+            m_Den = -m_Den;
+        }
+        Int g = Int::gcd(m_Num, m_Den);
+        if (g != Int(1) && !g.zero()) {
+            m_Num = m_Num / g;
+            m_Den = m_Den / g;
+        }
+    }
+
+   public:
+    Rational() = default;
+    Rational(Int num) : m_Num(std::move(num)) {}
+    // `den` isn't zero
+    Rational(Int num, Int den) : m_Num(std::move(num)), m_Den(std::move(den)) {
+        m_Reduce();
+    }
+    const Int& num() const { return m_Num; }
+    const Int& den() const { return m_Den; }
+    bool integral() const { return m_Den == Int(1); }
+    long double to_long_double() const {
+        long long en = 0, ed = 0;
+        long double n = m_Num.frexp(en), d = m_Den.frexp(ed);
+        long long exp = en - ed;
+        if (exp > 20'000) return n < 0 ? -HUGE_VALL : HUGE_VALL;
+        if (exp < -20'000) return n < 0 ? -0.0L : 0.0L;
+        return std::ldexp(n / d, static_cast<int>(exp));
+    }
+    std::string to_string() const {
+        return integral() ? m_Num.to_string()
+                          : m_Num.to_string() + "/" + m_Den.to_string();
+    }
+    Rational operator-() const { return Rational(-m_Num, m_Den); }
+    friend Rational operator+(const Rational& a, const Rational& b) {
+        return Rational(a.m_Num * b.m_Den + b.m_Num * a.m_Den,
+                        a.m_Den * b.m_Den);
+    }
+    friend Rational operator-(const Rational& a, const Rational& b) {
+        return a + -b;
+    }
+    friend Rational operator*(const Rational& a, const Rational& b) {
+        return Rational(a.m_Num * b.m_Num, a.m_Den * b.m_Den);
+    }
+    // `b` isn't zero
+    friend Rational operator/(const Rational& a, const Rational& b) {
+        return Rational(a.m_Num * b.m_Den, a.m_Den * b.m_Num);
+    }
+    friend int compare(const Rational& a, const Rational& b) {
+        return compare(a.m_Num * b.m_Den, b.m_Num * a.m_Den);
+    }
+    friend bool operator==(const Rational& a, const Rational& b) {
+        return a.m_Num == b.m_Num && a.m_Den == b.m_Den;
+    }
+    // nothing when the result would have more than max_bits bits
+    static std::optional<Rational> pow(const Rational& base,
+                                       std::uint64_t exp) {
+        auto num = Int::pow(base.m_Num, exp);
+        auto den = Int::pow(base.m_Den, exp);
+        if (!num || !den) return std::nullopt;
+        Rational out;
+        out.m_Num = std::move(*num);
+        out.m_Den = std::move(*den);
+        return out;
+    }
+};
+}  // namespace bigint
+}  // namespace ami
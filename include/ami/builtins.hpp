@@ -10,6 +10,9 @@
 
 #include "ast.hpp"
 #include "errors.hpp"
+#include "exact.hpp"
+#include "matrix.hpp"
+#include "tables.hpp"
 #include "types.hpp"
 // this is shit just a complete mess trash, dumb code rewrite it
 
@@ -18,14 +21,18 @@ namespace builtins {
 namespace details {
 struct FunctionHandler {
     using func_t = val_t (*)(const arg_t&);
-    std::size_t args_count;
-    func_t callback;
-    FunctionHandler(std::size_t args_count, func_t func)
-        : args_count(args_count), callback(func) {}
+    std::size_t args_count = 0;
+    func_t callback = nullptr;
+    bool pure = true;  // same arguments always give the same value
+    constexpr FunctionHandler() = default;
+    constexpr FunctionHandler(std::size_t args_count, func_t func,
+                              bool pure = true)
+        : args_count(args_count), callback(func), pure(pure) {}
 };
+// integers and fractions are rounded, see exact.hpp
 double to_number(const val_t& a) {
-    if (auto _get = std::get_if<Number>(&a))
-        return _get->val;
+    if (auto _get = exact::to_long_double(a))
+        return *_get;
     else
         throw std::runtime_error("expected number in function args");
 }
@@ -69,41 +76,73 @@ val_t b_max(const arg_t& args) {
     return Number(std::fmax(to_number(args.at(0)), to_number(args.at(1))));
 }
 val_t b_abs(const arg_t& args) {
+    if (auto* big = std::get_if<Integer>(&args.at(0)))
+        return Integer(big->value.abs());
     return Number(std::abs(to_number(args.at(0))));
 }
+// integers are already rounded, fractions are rounded exactly
 val_t b_round(const arg_t& args) {
+    if (std::holds_alternative<Integer>(args.at(0))) return args.at(0);
+    if (auto* frac = std::get_if<Fraction>(&args.at(0)))
+        return exact::integer(exact::round(frac->value));
     return Number(std::round(to_number(args.at(0))));
 }
 val_t b_ceil(const arg_t& args) {
+    if (std::holds_alternative<Integer>(args.at(0))) return args.at(0);
+    if (auto* frac = std::get_if<Fraction>(&args.at(0)))
+        return exact::integer(exact::ceil(frac->value));
     return Number(std::ceil(to_number(args.at(0))));
 }
 val_t b_floor(const arg_t& args) {
+    if (std::holds_alternative<Integer>(args.at(0))) return args.at(0);
+    if (auto* frac = std::get_if<Fraction>(&args.at(0)))
+        return exact::integer(exact::floor(frac->value));
     return Number(std::floor(to_number(args.at(0))));
 }
 val_t b_gcd(const arg_t& args) {
+    auto a = exact::to_integer(args.at(0)), b = exact::to_integer(args.at(1));
+    if (a && b) return exact::integer(bigint::Int::gcd(*a, *b));
     double x = to_number(args.at(0));
     double y = to_number(args.at(1));
+    // fmod never reaches 0 from there, inf ends up here too
+    if (std::isnan(x) || std::isnan(y)) return Number(NAN);
     arg_t r_args{Number(y), Number(std::fmod(x, y))};
     return !y ? Number(x) : (b_gcd(r_args));
 }
 val_t b_lcm(const arg_t& args) {
+    auto a = exact::to_integer(args.at(0)), b = exact::to_integer(args.at(1));
+    if (a && b && !a->zero() && !b->zero())
+        return exact::integer((*a * *b).abs() / bigint::Int::gcd(*a, *b));
     double x = to_number(args.at(0)), y = to_number(args.at(1));
     return Number((x * y) / to_number(b_gcd(args)));
 }
-std::random_device rnd;
-std::mt19937 gen{rnd()};
+// seeded on first use rather than at load time
+std::mt19937& generator() {
+    static std::mt19937 gen{std::random_device{}()};
+    return gen;
+}
+val_t b_transpose(const arg_t& args) {
+    const Matrix* m = std::get_if<Matrix>(&args.at(0));
+    checkOrErr(m != nullptr, "expected matrix in function args");
+    Numbers out(m->numbers.size());
+    matrix::transpose(m->numbers.data(), m->rows, m->cols, out.data());
+    return Matrix(m->cols, m->rows, std::move(out));
+}
 val_t b_rand(const arg_t& args) {
     std::uniform_real_distribution<> dist(to_number(args.at(0)),
                                           to_number(args.at(1)));
-    return Number(dist(gen));
+    return Number(dist(generator()));
 }
 }  // namespace details
-std::map<std::string, long double> constants{{"pi", M_PI},
-                                             {"tau", M_PI * 2},
-                                             {"inf", INFINITY},
-                                             {"nan", NAN},
-                                             {"e", M_E}};
-std::map<std::string, details::FunctionHandler> functions{
+// both tables are sorted at compile time and searched with a binary search
+inline constexpr tables::SortedTable<long double, 5> constants{{
+    {"pi", M_PI},
+    {"tau", M_PI * 2},
+    {"inf", INFINITY},
+    {"nan", NAN},
+    {"e", M_E},
+}};
+inline constexpr tables::SortedTable<details::FunctionHandler, 20> functions{{
     {"sqrt", details::FunctionHandler(1, details::b_sqrt)},
     {"sin", details::FunctionHandler(1, details::b_sin)},
     {"cos", details::FunctionHandler(1, details::b_cos)},
@@ -122,7 +161,30 @@ std::map<std::string, details::FunctionHandler> functions{
     {"lcm", details::FunctionHandler(2, details::b_lcm)},
     {"log10", details::FunctionHandler(1, details::b_log10)},
     {"log2", details::FunctionHandler(1, details::b_log2)},
-    {"random", details::FunctionHandler(2, details::b_rand)},
-};
+    {"random", details::FunctionHandler(2, details::b_rand, false)},
+    {"transpose", details::FunctionHandler(1, details::b_transpose)},
+}};
+namespace details {
+// symbol id -> index in `table`, each symbol is searched for only once
+template <class Table>
+std::size_t resolve(const Table& table, std::vector<std::size_t>& cache,
+                    symbol_t id) {
+    constexpr std::size_t unresolved = static_cast<std::size_t>(-1);
+    if (id >= cache.size()) cache.resize(symbols::count(), unresolved);
+    if (cache[id] == unresolved) cache[id] = table.index_of(symbols::name(id));
+    return cache[id];
+}
+}  // namespace details
+// nullptr when `id` doesn't name a builtin
+inline const long double* constant(symbol_t id) {
+    static std::vector<std::size_t> cache;
+    std::size_t i = details::resolve(constants, cache, id);
+    return i == constants.size() ? nullptr : &constants[i].value;
+}
+inline const details::FunctionHandler* function(symbol_t id) {
+    static std::vector<std::size_t> cache;
+    std::size_t i = details::resolve(functions, cache, id);
+    return i == functions.size() ? nullptr : &functions[i].value;
+}
 }  // namespace builtins
 }  // namespace ami
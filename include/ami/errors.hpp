@@ -1,38 +1,104 @@
 #pragma once
 #include <fmt/core.h>
 
-#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <variant>
+
+#include "tables.hpp"
 namespace ami {
 namespace exceptions {
-struct ExceptionInterface {
-  std::string name, err, file, src;
-  std::size_t linepos;
+enum class ErrorCode : std::uint8_t {
+  None,
+  Error,
+  SyntaxError,
+  ParseError,
+  TypeError  // keep it last, see error_names
+};
+inline constexpr tables::EnumNames<
+    ErrorCode, static_cast<std::size_t>(ErrorCode::TypeError) + 1>
+    error_names{{{ErrorCode::None, "None"},
+                 {ErrorCode::Error, "Error"},
+                 {ErrorCode::SyntaxError, "SyntaxError"},
+                 {ErrorCode::ParseError, "ParseError"},
+                 {ErrorCode::TypeError, "TypeError"}}};
+// columns [begin, end) of the source the error points at
+struct Span {
+  std::size_t begin = 0, end = 0;
+};
+// an error as it's raised, nothing gets formatted until format() is called.
+// the file name and the source are borrowed from the caller
+struct Diagnostic {
+  ErrorCode code = ErrorCode::None;
+  std::string err;
+  std::string_view file, src;
+  Span span;
+  Diagnostic() = default;
+  Diagnostic(ErrorCode code, std::string err, std::string_view file,
+             std::string_view src, Span span = {})
+      : code(code), err(std::move(err)), file(file), src(src), span(span) {}
+  std::string format() const {
+    std::string out = fmt::format(
+        "at \"<{file}>\" col '{pos}', {name}:  {error}\n{src}\n",
+        fmt::arg("file", file), fmt::arg("pos", span.begin),
+        fmt::arg("name", error_names.at(code)), fmt::arg("error", err),
+        fmt::arg("src", src));
+    out.append(span.begin, ' ');
+    out += '^';
+    return out;
+  }
 };
+// older name, kept for code that still refers to it
+using ExceptionInterface = Diagnostic;
 class BaseException {
-  std::string name, err, file, src;
-  std::size_t linepos;
-  std::string m_Fmt;
+  Diagnostic m_Diag;
+  // copies of the file name and the source for exceptions that outlive
+  // them, m_Diag points into these when they're set
+  std::shared_ptr<const std::pair<std::string, std::string>> m_Owned;
+  mutable std::string m_Fmt;
 
  public:
-  explicit BaseException(const ExceptionInterface& ei)
-      : name(ei.name),
-        err(ei.err),
-        file(ei.file),
-        src(ei.src),
-        linepos(ei.linepos) {
-    std::string _fmt_str = "at \"<{file}>\" col '{pos}', {name}:  {error}";
-    _fmt_str = fmt::format(
-        "{}\n{}\n",
-        fmt::format(_fmt_str, fmt::arg("file", file), fmt::arg("pos", linepos),
-                    fmt::arg("name", name), fmt::arg("error", err)),
-        src);
-    _fmt_str += std::string(linepos, ' ') + '^';
-    m_Fmt = _fmt_str;
+  explicit BaseException(const Diagnostic& diag) : m_Diag(diag) {}
+  // an exception that stays valid once the source it was raised for is
+  // gone, this is what's thrown to the users of ami::eval
+  static BaseException owning(const Diagnostic& diag) {
+    BaseException out(diag);
+    out.m_Owned = std::make_shared<std::pair<std::string, std::string>>(
+        std::string(diag.file), std::string(diag.src));
+    out.m_Diag.file = out.m_Owned->first;
+    out.m_Diag.src = out.m_Owned->second;
+    return out;
+  }
+  const Diagnostic& diagnostic() const { return m_Diag; }
+  ErrorCode code() const { return m_Diag.code; }
+  // formatted on the first call
+  std::string what() const throw() {
+    if (m_Fmt.empty()) m_Fmt = m_Diag.format();
+    return m_Fmt;
   }
-  std::string what() const throw() { return m_Fmt; }
 };
 }  // namespace exceptions
+// either a value or the diagnostic of the error that prevented computing it
+template <class T>
+class Result {
+  std::variant<T, exceptions::Diagnostic> m_Value;
+
+ public:
+  Result(T value) : m_Value(std::move(value)) {}
+  Result(exceptions::Diagnostic diag) : m_Value(std::move(diag)) {}
+  bool ok() const { return m_Value.index() == 0; }
+  explicit operator bool() const { return ok(); }
+  T& value() { return std::get<0>(m_Value); }
+  const T& value() const { return std::get<0>(m_Value); }
+  T& operator*() { return value(); }
+  const T& operator*() const { return value(); }
+  T* operator->() { return &value(); }
+  const T* operator->() const { return &value(); }
+  const exceptions::Diagnostic& error() const { return std::get<1>(m_Value); }
+};
 }  // namespace ami
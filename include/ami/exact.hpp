@@ -0,0 +1,125 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include "ast.hpp"
+#include "bigint.hpp"
+#include "types.hpp"
+
+// a value is a Number as long as a long double holds it exactly. integer
+// arithmetic whose result doesn't fit one gives an Integer, exact quotients
+// of those and negative powers of integers give a Fraction, and both are a
+// Number again once a long double holds them so everything that only knows
+// long doubles sees nothing new
+
+namespace ami {
+namespace exact {
+inline constexpr int digits = std::numeric_limits<long double>::digits;
+// every integer below this is a long double
+inline constexpr long double limit = [] {
+    long double out = 1;
+    for (int i = 0; i < digits; ++i) out *= 2;
+    return out;
+}();
+// whether `v` is an integer a long double holds exactly, NaN isn't
+inline bool integral(long double v) {
+    return std::fabs(v) < limit && v == std::trunc(v);
+}
+// whether `out`, computed from `lhs` and `rhs` by an operator, is an integer
+// a long double may have rounded. the paths that only have long doubles
+// leave those to the Interpreter
+inline bool inexact(long double lhs, long double rhs, long double out) {
+    return !(std::fabs(out) < limit) && integral(lhs) && integral(rhs);
+}
+// the same for `out` = `lhs` ^ `rhs`, a negative power of an integer other
+// than a power of two is a fraction no long double holds
+inline bool inexact_power(long double lhs, long double rhs, long double out) {
+    if (inexact(lhs, rhs, out)) return true;
+    int exp = 0;
+    return rhs < 0 && integral(lhs) && integral(rhs) && lhs != 0 &&
+           std::frexp(std::fabs(lhs), &exp) != 0.5L;
+}
+inline val_t integer(bigint::Int v) {
+    if (v.bits() <= static_cast<std::size_t>(digits))
+        return Number(v.to_long_double());
+    return Integer(std::move(v));
+}
+// whether `v` is a power of two
+inline bool dyadic(const bigint::Int& v) {
+    return !v.zero() && (bigint::Int(1) << (v.bits() - 1)) == v.abs();
+}
+inline val_t rational(bigint::Rational v) {
+    if (v.integral()) return integer(v.num());
+    // a long double holds a fraction whose denominator is a power of two
+    // as long as its numerator fits the mantissa
+    if (v.num().bits() <= static_cast<std::size_t>(digits) &&
+        dyadic(v.den()) && v.den().bits() < 16'000)
+        return Number(v.to_long_double());
+    return Fraction(std::move(v));
+}
+inline bool numeric(const val_t& v) {
+    return std::holds_alternative<Number>(v) ||
+           std::holds_alternative<Integer>(v) ||
+           std::holds_alternative<Fraction>(v);
+}
+// nothing when `v` isn't an exact integer
+inline std::optional<bigint::Int> to_integer(const val_t& v) {
+    if (const auto* n = std::get_if<Number>(&v))
+        if (integral(n->val)) return bigint::Int::from(n->val);
+    if (const auto* i = std::get_if<Integer>(&v)) return i->value;
+    return std::nullopt;
+}
+inline std::optional<bigint::Rational> to_rational(const val_t& v) {
+    if (const auto* f = std::get_if<Fraction>(&v)) return f->value;
+    if (auto i = to_integer(v)) return bigint::Rational(std::move(*i));
+    return std::nullopt;
+}
+// the value a Number, an Integer or a Fraction holds, a finite long double
+// is a fraction whose denominator is a power of two. nothing for the other
+// types, infinities and NaN
+inline std::optional<bigint::Rational> value(const val_t& v) {
+    const auto* n = std::get_if<Number>(&v);
+    if (n == nullptr) return to_rational(v);
+    if (!std::isfinite(n->val)) return std::nullopt;
+    if (integral(n->val) || !(std::fabs(n->val) < limit))
+        return bigint::Rational(bigint::Int::from(n->val));
+    int exp = 0;
+    long double mantissa = std::frexp(n->val, &exp);
+    bigint::Int num = bigint::Int::from(std::ldexp(mantissa, digits));
+    return bigint::Rational(std::move(num),
+                            bigint::Int(1) << static_cast<std::size_t>(
+                                digits - exp));
+}
+// `v` rounded down, up and to the nearest integer, halfway cases away from
+// zero like std::round
+inline bigint::Int floor(const bigint::Rational& v) {
+    bigint::Int q, r;
+    bigint::Int::divmod(v.num(), v.den(), q, r);
+    return r.negative() ? q - bigint::Int(1) : q;
+}
+inline bigint::Int ceil(const bigint::Rational& v) {
+    bigint::Int q, r;
+    bigint::Int::divmod(v.num(), v.den(), q, r);
+    return !r.zero() && !r.negative() ? q + bigint::Int(1) : q;
+}
+inline bigint::Int round(const bigint::Rational& v) {
+    bigint::Int two(2);
+    bigint::Int out = (v.num().abs() * two + v.den()) / (v.den() * two);
+    return v.num().negative() ? -out : out;
+}
+// the value of a Number, an Integer or a Fraction rounded to a long double,
+// nothing for the other types
+inline std::optional<long double> to_long_double(const val_t& v) {
+    if (const auto* n = std::get_if<Number>(&v)) return n->val;
+    if (const auto* i = std::get_if<Integer>(&v))
+        return i->value.to_long_double();
+    if (const auto* f = std::get_if<Fraction>(&v))
+        return f->value.to_long_double();
+    return std::nullopt;
+}
+}  // namespace exact
+}  // namespace ami
@@ -0,0 +1,400 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "exact.hpp"
+#include "interpreter.hpp"
+#include "types.hpp"
+
+// flat layout of an ast, the nodes of a tree are stored in post order in
+// parallel arrays so evaluating it is a single linear walk over contiguous
+// memory with a value stack, no pointer chasing and no virtual calls.
+// only the scalar part of the language is covered: numbers, booleans, null,
+// identifiers, arithmetic, comparisons, logical operators, `not`, `if`, `|x|`,
+// `!` and calls to pure builtins. anything else makes flatten return nothing
+// and the tree is left to the Interpreter
+
+namespace ami {
+namespace flat {
+enum class Kind : std::uint8_t {
+    Number,     // payload: index in Tree::numbers
+    Boolean,    // payload: 0 or 1
+    Null,
+    Ident,      // payload: symbol id
+    Negative,
+    Not,
+    Binary,     // op: + - * / ^ %
+    Compare,    // op: > >= < <= == !=
+    Logical,    // op: and / or
+    Abs,
+    Factorial,
+    Call,       // payload: index in Tree::calls
+    Branch,     // pops the condition, payload: first node of the else part
+    Skip,       // end of the if part, payload: the If node
+    If
+};
+struct Call {
+    const builtins::details::FunctionHandler* handler;
+    std::uint32_t args_count;
+};
+struct Tree {
+    std::vector<Kind> kind;
+    std::vector<Op> op;
+    std::vector<std::uint32_t> payload;
+    // first node of the subtree rooted at each node, the last operand of a
+    // node is always the node right before it
+    std::vector<std::uint32_t> begin;
+    std::vector<long double> numbers;
+    std::vector<Call> calls;
+    std::size_t max_depth = 0;  // deepest the value stack gets
+    std::size_t size() const { return kind.size(); }
+};
+namespace details {
+class Builder {
+    Tree m_Tree;
+    std::size_t m_Depth = 0;
+    void m_Push(std::size_t n = 1) {
+        m_Depth += n;
+        if (m_Depth > m_Tree.max_depth) m_Tree.max_depth = m_Depth;
+    }
+    void m_Pop(std::size_t n) { m_Depth -= n; }
+    std::uint32_t m_Next() const {
+        return static_cast<std::uint32_t>(m_Tree.size());
+    }
+    void m_Add(Kind k, std::uint32_t begin, std::uint32_t payload = 0,
+               Op op = Op::Plus) {
+        m_Tree.kind.push_back(k);
+        m_Tree.op.push_back(op);
+        m_Tree.payload.push_back(payload);
+        m_Tree.begin.push_back(begin);
+    }
+    bool m_Emit(const Expr* e) {
+        std::uint32_t begin = m_Next();
+        switch (e->type()) {
+            case AstType::Number:
+                m_Add(Kind::Number, begin,
+                      static_cast<std::uint32_t>(m_Tree.numbers.size()));
+                m_Tree.numbers.push_back(static_cast<const Number*>(e)->val);
+                m_Push();
+                return true;
+            case AstType::Boolean:
+                m_Add(Kind::Boolean, begin,
+                      static_cast<const Boolean*>(e)->val);
+                m_Push();
+                return true;
+            case AstType::NullExpr:
+                m_Add(Kind::Null, begin);
+                m_Push();
+                return true;
+            case AstType::Identifier:
+                m_Add(Kind::Ident, begin,
+                      static_cast<const Identifier*>(e)->id);
+                m_Push();
+                return true;
+            case AstType::NegativeExpr:
+                if (!m_Emit(static_cast<const NegativeExpr*>(e)->value.get()))
+                    return false;
+                m_Add(Kind::Negative, begin);
+                return true;
+            case AstType::NotExpr:
+                if (!m_Emit(static_cast<const NotExpr*>(e)->value.get()))
+                    return false;
+                m_Add(Kind::Not, begin);
+                return true;
+            case AstType::BinaryOp: {
+                auto* b = static_cast<const BinaryOpExpr*>(e);
+                return m_Binary(Kind::Binary, b->op, b->lhs.get(),
+                                b->rhs.get(), begin);
+            }
+            case AstType::Comparison: {
+                auto* c = static_cast<const Comparison*>(e);
+                return m_Binary(Kind::Compare, c->op, c->lhs.get(),
+                                c->rhs.get(), begin);
+            }
+            case AstType::LogicalExpr: {
+                auto* l = static_cast<const LogicalExpr*>(e);
+                return m_Binary(Kind::Logical, l->op, l->lhs.get(),
+                                l->rhs.get(), begin);
+            }
+            case AstType::Symbol: {
+                auto* s = static_cast<const SymbolExpr*>(e);
+                if (s->symbol == Symbol::Norm || !m_Emit(s->value.get()))
+                    return false;
+                m_Add(s->symbol == Symbol::Abs ? Kind::Abs : Kind::Factorial,
+                      begin);
+                return true;
+            }
+            case AstType::FunctionCall:
+                return m_Call(static_cast<const FunctionCall*>(e), begin);
+            case AstType::IfExpr:
+                return m_If(static_cast<const IfExpr*>(e), begin);
+            default:
+                return false;
+        }
+    }
+    bool m_Binary(Kind k, Op op, const Expr* lhs, const Expr* rhs,
+                  std::uint32_t begin) {
+        if (!m_Emit(lhs) || !m_Emit(rhs)) return false;
+        m_Add(k, begin, 0, op);
+        m_Pop(1);
+        return true;
+    }
+    bool m_Call(const FunctionCall* fc, std::uint32_t begin) {
+        const auto* handler = builtins::function(fc->id);
+        // user functions need call frames and impure builtins can't be
+        // evaluated twice when the walk has to fall back
+        if (handler == nullptr || !handler->pure ||
+            handler->args_count != fc->arguments.size())
+            return false;
+        for (auto& arg : fc->arguments)
+            if (!m_Emit(arg.get())) return false;
+        auto argc = static_cast<std::uint32_t>(fc->arguments.size());
+        m_Add(Kind::Call, begin,
+              static_cast<std::uint32_t>(m_Tree.calls.size()));
+        m_Tree.calls.push_back(Call{handler, argc});
+        if (argc == 0)
+            m_Push();
+        else
+            m_Pop(argc - 1);
+        return true;
+    }
+    // cond Branch body Skip else If, only one of the two parts is walked
+    bool m_If(const IfExpr* iexpr, std::uint32_t begin) {
+        if (!m_Emit(iexpr->cond.get())) return false;
+        std::uint32_t branch = m_Next();
+        m_Add(Kind::Branch, begin);
+        m_Pop(1);
+        if (!m_Emit(iexpr->body.get())) return false;
+        std::uint32_t skip = m_Next();
+        m_Add(Kind::Skip, begin);
+        m_Pop(1);
+        m_Tree.payload[branch] = m_Next();
+        if (iexpr->elsestmt != nullptr) {
+            if (!m_Emit(iexpr->elsestmt.get())) return false;
+        } else {
+            m_Add(Kind::Null, m_Next());
+            m_Push();
+        }
+        m_Tree.payload[skip] = m_Next();
+        m_Add(Kind::If, begin);
+        return true;
+    }
+
+   public:
+    std::optional<Tree> build(const Expr* root) {
+        if (!m_Emit(root)) return std::nullopt;
+        return std::move(m_Tree);
+    }
+};
+struct Value {
+    enum class Type : std::uint8_t { Number, Boolean, Null } type;
+    long double num;
+};
+inline std::optional<Value> from_val(const val_t& v) {
+    if (auto* n = std::get_if<Number>(&v))
+        return Value{Value::Type::Number, n->val};
+    if (auto* b = std::get_if<Boolean>(&v))
+        return Value{Value::Type::Boolean, static_cast<long double>(b->val)};
+    if (std::get_if<NullExpr>(&v)) return Value{Value::Type::Null, 0};
+    return std::nullopt;
+}
+inline val_t to_val(const Value& v) {
+    switch (v.type) {
+        case Value::Type::Number:
+            return Number(v.num);
+        case Value::Type::Boolean:
+            return Boolean(v.num != 0);
+        default:
+            return NullExpr{};
+    }
+}
+}  // namespace details
+// post order layout of `root`, nothing when the tree uses parts of the
+// language the flat walk doesn't cover
+inline std::optional<Tree> flatten(const ptr_t& root) {
+    return details::Builder{}.build(root.get());
+}
+// walks `tree` front to back, returns nothing for anything it can't evaluate
+// the same way the Interpreter does (a value of another type, an undeclared
+// identifier...) so the caller can fall back to it and get its error
+inline std::optional<val_t> evaluate(const Tree& tree) {
+    using details::Value;
+    using Type = Value::Type;
+    std::vector<Value> stack;
+    stack.reserve(tree.max_depth);
+    arg_t args;  // reused by every builtin call
+    auto is_num = [](const Value& v) { return v.type == Type::Number; };
+    auto is_scalar = [](const Value& v) { return v.type != Type::Null; };
+    for (std::size_t i = 0; i < tree.size(); ++i) {
+        switch (tree.kind[i]) {
+            case Kind::Number:
+                stack.push_back({Type::Number, tree.numbers[tree.payload[i]]});
+                break;
+            case Kind::Boolean:
+                stack.push_back(
+                    {Type::Boolean, static_cast<long double>(tree.payload[i])});
+                break;
+            case Kind::Null:
+                stack.push_back({Type::Null, 0});
+                break;
+            case Kind::Ident: {
+                symbol_t id = tree.payload[i];
+                if (const long double* c = builtins::constant(id)) {
+                    stack.push_back({Type::Number, *c});
+                } else if (val_t* v = scope::lookup(scope::userdefined, id)) {
+                    auto value = details::from_val(*v);
+                    if (!value) return std::nullopt;
+                    stack.push_back(*value);
+                } else {
+                    return std::nullopt;
+                }
+                break;
+            }
+            case Kind::Negative:
+                if (!is_num(stack.back())) return std::nullopt;
+                stack.back().num = -stack.back().num;
+                break;
+            case Kind::Not: {
+                Value& v = stack.back();
+                v = {Type::Boolean, static_cast<long double>(v.num == 0)};
+                break;
+            }
+            case Kind::Abs:
+                if (!is_num(stack.back())) return std::nullopt;
+                stack.back().num = std::abs(stack.back().num);
+                break;
+            case Kind::Factorial: {
+                Value& v = stack.back();
+                if (!is_num(v)) return std::nullopt;
+                // past 20! they're an Integer
+                if (exact::integral(v.num) && v.num > 20) return std::nullopt;
+                long double out = 1;
+                if (std::isfinite(v.num) && (v.num <= 1e7)) {
+                    for (long double k = 1; k <= v.num; ++k) out *= k;
+                } else {
+                    out = INFINITY;
+                }
+                v.num = out;
+                break;
+            }
+            case Kind::Binary: {
+                Value rhs = stack.back();
+                stack.pop_back();
+                Value& lhs = stack.back();
+                if (!is_num(lhs) || !is_num(rhs)) return std::nullopt;
+                long double l = lhs.num;
+                switch (tree.op[i]) {
+                    case Op::Plus:
+                        lhs.num += rhs.num;
+                        break;
+                    case Op::Minus:
+                        lhs.num -= rhs.num;
+                        break;
+                    case Op::Mult:
+                        lhs.num *= rhs.num;
+                        break;
+                    case Op::Div:
+                        lhs.num /= rhs.num;
+                        break;
+                    case Op::Pow:
+                        lhs.num = std::pow(lhs.num, rhs.num);
+                        break;
+                    case Op::Mod:
+                        lhs.num = std::fmod(lhs.num, rhs.num);
+                        break;
+                    default:
+                        return std::nullopt;
+                }
+                if (tree.op[i] == Op::Pow
+                        ? exact::inexact_power(l, rhs.num, lhs.num)
+                        : tree.op[i] != Op::Div && tree.op[i] != Op::Mod &&
+                              exact::inexact(l, rhs.num, lhs.num))
+                    return std::nullopt;
+                break;
+            }
+            case Kind::Compare: {
+                Value rhs = stack.back();
+                stack.pop_back();
+                Value& lhs = stack.back();
+                if (!is_scalar(lhs) || !is_scalar(rhs)) return std::nullopt;
+                bool out;
+                switch (tree.op[i]) {
+                    case Op::Greater:
+                        out = lhs.num > rhs.num;
+                        break;
+                    case Op::GreaterOrEqual:
+                        out = lhs.num >= rhs.num;
+                        break;
+                    case Op::Less:
+                        out = lhs.num < rhs.num;
+                        break;
+                    case Op::LessOrEqual:
+                        out = lhs.num <= rhs.num;
+                        break;
+                    case Op::Equals:
+                        out = lhs.num == rhs.num;
+                        break;
+                    case Op::NotEquals:
+                        out = lhs.num != rhs.num;
+                        break;
+                    default:
+                        return std::nullopt;
+                }
+                lhs = {Type::Boolean, static_cast<long double>(out)};
+                break;
+            }
+            case Kind::Logical: {
+                Value rhs = stack.back();
+                stack.pop_back();
+                Value& lhs = stack.back();
+                if (!is_scalar(lhs) || !is_scalar(rhs)) return std::nullopt;
+                bool out = tree.op[i] == Op::LogicalAnd
+                               ? (lhs.num != 0 && rhs.num != 0)
+                               : (lhs.num != 0 || rhs.num != 0);
+                lhs = {Type::Boolean, static_cast<long double>(out)};
+                break;
+            }
+            case Kind::Call: {
+                const Call& call = tree.calls[tree.payload[i]];
+                args.clear();
+                for (std::size_t k = stack.size() - call.args_count;
+                     k < stack.size(); ++k) {
+                    // builtins only take numbers
+                    if (!is_num(stack[k])) return std::nullopt;
+                    args.push_back(details::to_val(stack[k]));
+                }
+                stack.resize(stack.size() - call.args_count);
+                auto value = details::from_val(call.handler->callback(args));
+                if (!value) return std::nullopt;
+                stack.push_back(*value);
+                break;
+            }
+            case Kind::Branch: {
+                Value cond = stack.back();
+                stack.pop_back();
+                if (cond.type == Type::Null || cond.num == 0)
+                    i = tree.payload[i] - 1;
+                break;
+            }
+            case Kind::Skip:
+                i = tree.payload[i] - 1;
+                break;
+            case Kind::If:
+                break;
+        }
+    }
+    return details::to_val(stack.back());
+}
+// evaluates `root` with the flat walk when it can, with `inter` otherwise
+inline val_t eval(const ptr_t& root, Interpreter& inter) {
+    if (auto tree = flatten(root))
+        if (auto value = evaluate(*tree)) return *std::move(value);
+    return inter.visit(root);
+}
+}  // namespace flat
+}  // namespace ami
@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
@@ -16,552 +18,295 @@
 
 #include "builtins.hpp"
 #include "errors.hpp"
+#include "exact.hpp"
+#include "jit.hpp"
+#include "matrix.hpp"
+#include "memo.hpp"
+#include "operators.hpp"
 #include "parser.hpp"
+#include "scope.hpp"
 #include "types.hpp"
 
 // TODO:
 // add functions for operations instead of repetition
 
 namespace ami {
-namespace scope {
-static ami::iscope_t userdefined;
-static ami::fscope_t userdefined_functions;
-}  // namespace scope
 class Interpreter {
-    using nested_scope_t = std::vector<iscope_t>;
     std::size_t max_call_count = 3'000;
     std::size_t m_Pos = 0;
-    ami::exceptions::ExceptionInterface ei;
-    nested_scope_t arguments_scope;
+    ami::exceptions::Diagnostic ei;
+    scope::CallStack arguments_scope;
+    bool m_JitTooDeep = false;  // see jit::call
+    // values of the shared subtrees, kept as long as the Interpreter like
+    // m_Pos so it evaluates a single statement. an entry is only valid in the
+    // call it was computed in, identifiers can refer to other values in
+    // another one
+    struct SharedValue {
+        std::size_t call;
+        val_t value;
+    };
+    std::unordered_map<const Expr*, SharedValue> m_Shared;
+    std::size_t m_Calls = 0, m_Call = 0;
     // exceptions
-    void m_ThrowErr(const std::string& str, const std::string& msg,
-                    std::optional<std::size_t> pos = std::nullopt) {
-        ei.name = str;
+    [[noreturn]] void m_ThrowErr(
+        ami::exceptions::ErrorCode code, const std::string& msg,
+        std::optional<std::size_t> pos = std::nullopt) {
+        ei.code = code;
         ei.err = msg;
-        ei.linepos = pos.value_or(m_Pos);
+        ei.span.begin = pos.value_or(m_Pos);
+        ei.span.end = ei.span.begin + 1;
         throw ami::exceptions::BaseException(ei);
     }
     void m_CheckOrErr(bool t_y, const std::string& msg) {
         if (!t_y) m_Err(msg);
     }
-    void m_Err(const std::string& msg,
-               std::optional<std::size_t> pos = std::nullopt) {
-        m_ThrowErr("Error", msg, pos);
+    [[noreturn]] void m_Err(const std::string& msg,
+                            std::optional<std::size_t> pos = std::nullopt) {
+        m_ThrowErr(ami::exceptions::ErrorCode::Error, msg, pos);
     }
     bool m_IsValidOper(const val_t& vr) {
         // to make operations only valid between numbers
         return std::get_if<Number>(&vr) != nullptr;
     }
-    val_t m_VisitAdd(BinaryOpExpr* boe) {
-        val_t _lhs = visit(boe->lhs);
-        val_t _rhs = visit(boe->rhs);
-        if (m_IsValidOper(_lhs) && m_IsValidOper(_rhs)) {
-            return Number(std::get<Number>(_lhs).val +
-                          std::get<Number>(_rhs).val);
-
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Vector>(&_lhs),
-                                                std::get_if<Vector>(&_rhs)};
-                   (lhs != nullptr) && (rhs != nullptr)) {
-            m_CheckOrErr(lhs->value.size() == rhs->value.size(),
-                         "vectors must have the same size in order to perform "
-                         "binary oprations");
-            std::vector<ptr_t> out;
-            for (std::size_t i = 0; i < lhs->value.size(); i++) {
-                val_t v_lhs_num = visit(lhs->value.at(i)),
-                      v_rhs_num = visit(rhs->value.at(i));
-                Number *lhs_num = std::get_if<Number>(&v_lhs_num),
-                       *rhs_num = std::get_if<Number>(&v_rhs_num);
-                m_CheckOrErr((lhs_num != nullptr) && (rhs_num != nullptr),
-                             "invalid type");
-                out.push_back(
-                    std::make_shared<Number>(lhs_num->val + rhs_num->val));
-            }
-            return visit(std::make_shared<Vector>(out));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Point>(&_lhs),
-                                                std::get_if<Point>(&_rhs)};
-                   (lhs != nullptr) && (rhs != nullptr)) {
-            m_CheckOrErr(lhs->value.size() == rhs->value.size(),
-                         "operands must have the same size in order to perform "
-                         "binary oprations");
-            std::vector<ptr_t> out;
-            for (std::size_t i = 0; i < lhs->value.size(); i++) {
-                val_t v_lhs_num = visit(lhs->value.at(i)),
-                      v_rhs_num = visit(rhs->value.at(i));
-                Number *lhs_num = std::get_if<Number>(&v_lhs_num),
-                       *rhs_num = std::get_if<Number>(&v_rhs_num);
-                m_CheckOrErr((lhs_num != nullptr) && (rhs_num != nullptr),
-                             "invalid type");
-                out.push_back(
-                    std::make_shared<Number>(lhs_num->val + rhs_num->val));
-            }
-            return visit(std::make_shared<Point>(out));
-        } else {
-            m_Err("binary operation '+' is not valid in this context");
-        }
-    }
-    val_t m_VisitSub(BinaryOpExpr* boe) {
-        val_t _lhs = visit(boe->lhs);
-        val_t _rhs = visit(boe->rhs);
-        if (m_IsValidOper(_lhs) && m_IsValidOper(_rhs)) {
-            return Number(std::get<Number>(_lhs).val -
-                          std::get<Number>(_rhs).val);
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<SetObject>(&_lhs),
-                                                std::get_if<SetObject>(&_rhs)};
-                   (lhs != nullptr) && (rhs != nullptr)) {
-            std::vector<ptr_t> val;
-            std::vector<Number> f_temp;
-            for (auto& e : rhs->value) {
-                val_t t_v_num = visit(e);
-                Number* t_num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(t_num != nullptr, "invalid type");
-                f_temp.push_back(*t_num);
-            }
-            for (auto& e : lhs->value) {
-                val_t t_v_num = visit(e);
-                Number* t_num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(t_num != nullptr, "invalid type");
-                if (std::find(f_temp.begin(), f_temp.end(), *t_num) ==
-                    f_temp.end()) {
-                    val.push_back(e);
-                }
-            }
-            return visit(std::make_shared<SetObject>(val));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Point>(&_lhs),
-                                                std::get_if<Point>(&_rhs)};
-                   (lhs != nullptr) && (rhs != nullptr)) {
-            m_CheckOrErr(lhs->value.size() == rhs->value.size(),
-                         "operands must have the same size in order to perform "
-                         "binary oprations");
-            std::vector<ptr_t> out;
-            for (std::size_t i = 0; i < lhs->value.size(); i++) {
-                val_t v_lhs_num = visit(lhs->value.at(i)),
-                      v_rhs_num = visit(rhs->value.at(i));
-                Number *lhs_num = std::get_if<Number>(&v_lhs_num),
-                       *rhs_num = std::get_if<Number>(&v_rhs_num);
-                m_CheckOrErr((lhs_num != nullptr) && (rhs_num != nullptr),
-                             "invalid type");
-                out.push_back(
-                    std::make_shared<Number>(lhs_num->val - rhs_num->val));
-            }
-            return visit(std::make_shared<Point>(out));
-        } else {
-            m_Err("binary operation '-' is not valid in this context");
-        }
-    }
-    val_t m_VisitDiv(BinaryOpExpr* boe) {
-        val_t _lhs = visit(boe->lhs);
-        val_t _rhs = visit(boe->rhs);
-        if (m_IsValidOper(_lhs) && m_IsValidOper(_rhs)) {
-            return Number(std::get<Number>(_lhs).val /
-                          std::get<Number>(_rhs).val);
-
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Point>(&_lhs),
-                                                std::get_if<Point>(&_rhs)};
-                   (lhs != nullptr) && (rhs != nullptr)) {
-            m_CheckOrErr(lhs->value.size() == rhs->value.size(),
-                         "operands must have the same size in order to perform "
-                         "binary oprations");
-            std::vector<ptr_t> out;
-            for (std::size_t i = 0; i < lhs->value.size(); i++) {
-                val_t v_lhs_num = visit(lhs->value.at(i)),
-                      v_rhs_num = visit(rhs->value.at(i));
-                Number *lhs_num = std::get_if<Number>(&v_lhs_num),
-                       *rhs_num = std::get_if<Number>(&v_rhs_num);
-                m_CheckOrErr((lhs_num != nullptr) && (rhs_num != nullptr),
-                             "invalid type");
-                out.push_back(
-                    std::make_shared<Number>(lhs_num->val / rhs_num->val));
-            }
-            return visit(std::make_shared<Point>(out));
-        } else {
-            m_Err("binary operation '/' is not valid in this context");
-        }
-    }
-    val_t m_VisitMult(BinaryOpExpr* boe) {
-        val_t _lhs = visit(boe->lhs);
-        val_t _rhs = visit(boe->rhs);
-        if (m_IsValidOper(_lhs) && m_IsValidOper(_rhs)) {
-            return Number(std::get<Number>(_lhs).val *
-                          std::get<Number>(_rhs).val);
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Number>(&_lhs),
-                                                std::get_if<Vector>(&_rhs)};
-                   (lhs != nullptr && rhs != nullptr)) {
-            std::vector<ptr_t> out;
-            for (auto& elm : rhs->value) {
-                val_t t_v_num = visit(elm);
-                Number* num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(num != nullptr, "invalid type");
-                out.push_back(std::make_shared<Number>(num->val * lhs->val));
-            }
-            return visit(std::make_shared<Vector>(out));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Vector>(&_lhs),
-                                                std::get_if<Number>(&_rhs)};
-                   (lhs != nullptr && rhs != nullptr)) {
-            std::vector<ptr_t> out;
-            for (auto& elm : lhs->value) {
-                val_t t_v_num = visit(elm);
-                Number* num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(num != nullptr, "invalid type");
-                out.push_back(std::make_shared<Number>(num->val * rhs->val));
-            }
-            return visit(std::make_shared<Vector>(out));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Vector>(&_lhs),
-                                                std::get_if<Vector>(&_rhs)};
-                   (lhs != nullptr && rhs != nullptr)) {
-            m_CheckOrErr(lhs->value.size() == rhs->value.size(),
-                         "vectors must have the same size");
-            std::vector<Number> lhs_val;
-            long double fnl = 0;  // dot product
-            for (auto& elm : lhs->value) {
-                val_t t_v_num = visit(elm);
-                Number* num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(num != nullptr, "invalid type");
-                lhs_val.push_back(*num);
-            }
-            for (std::size_t i = 0; i < lhs_val.size(); i++) {
-                val_t t_v_num = visit(rhs->value.at(i));
-                Number* num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(num != nullptr, "invalid type");
-                fnl += (num->val * lhs_val.at(i).val);
-            }
-            return visit(std::make_shared<Number>(fnl));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Point>(&_lhs),
-                                                std::get_if<Point>(&_rhs)};
-                   (lhs != nullptr) && (rhs != nullptr)) {
-            m_CheckOrErr(lhs->value.size() == rhs->value.size(),
-                         "operands must have the same size in order to perform "
-                         "binary oprations");
-            std::vector<ptr_t> out;
-            for (std::size_t i = 0; i < lhs->value.size(); i++) {
-                val_t v_lhs_num = visit(lhs->value.at(i)),
-                      v_rhs_num = visit(rhs->value.at(i));
-                Number *lhs_num = std::get_if<Number>(&v_lhs_num),
-                       *rhs_num = std::get_if<Number>(&v_rhs_num);
-                m_CheckOrErr((lhs_num != nullptr) && (rhs_num != nullptr),
-                             "invalid type");
-                out.push_back(
-                    std::make_shared<Number>(lhs_num->val * rhs_num->val));
-            }
-            return visit(std::make_shared<Point>(out));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Number>(&_lhs),
-                                                std::get_if<Point>(&_rhs)};
-                   (lhs != nullptr && rhs != nullptr)) {
-            std::vector<ptr_t> out;
-            for (auto& elm : rhs->value) {
-                val_t t_v_num = visit(elm);
-                Number* num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(num != nullptr, "invalid type");
-                out.push_back(std::make_shared<Number>(num->val * lhs->val));
-            }
-            return visit(std::make_shared<Point>(out));
-        } else if (auto [lhs, rhs] = std::tuple{std::get_if<Point>(&_lhs),
-                                                std::get_if<Number>(&_rhs)};
-                   (lhs != nullptr && rhs != nullptr)) {
-            std::vector<ptr_t> out;
-            for (auto& elm : lhs->value) {
-                val_t t_v_num = visit(elm);
-                Number* num = std::get_if<Number>(&t_v_num);
-                m_CheckOrErr(num != nullptr, "invalid type");
-                out.push_back(std::make_shared<Number>(num->val * rhs->val));
-            }
-            return visit(std::make_shared<Point>(out));
-        } else {
-            m_Err("binary operation '*' is not valid in this context");
+    // evaluated sets are sorted so union and intersection are a single
+    // merge of both, `merge` is one of the std::set_ algorithms
+    // and `size` the most elements it can write
+    template <class Merge>
+    static SetObject m_MergeSets(const SetObject& lhs, const SetObject& rhs,
+                                 std::size_t size, Merge&& merge) {
+        const Numbers &l = lhs.numbers, &r = rhs.numbers;
+        Numbers out(size);
+        out.resize(merge(l.begin(), l.end(), r.begin(), r.end(), out.begin()) -
+                   out.begin());
+        return SetObject(std::move(out));
+    }
+    // `lhs op rhs` by the kernel for the types of the operands, each of
+    // them is evaluated once. `kind` names the operator in errors
+    val_t m_VisitOperator(Op op, const ptr_t& lhs, const ptr_t& rhs,
+                          std::string_view kind) {
+        val_t _lhs = visit(lhs);
+        val_t _rhs = visit(rhs);
+        operators::kernel_t kernel = operators::table().find(op, _lhs, _rhs);
+        if (kernel == nullptr)
+            m_Err(fmt::format("{} '{}' is not valid in this context", kind,
+                              ops_str.at(op)));
+        try {
+            return kernel(_lhs, _rhs);
+        } catch (const operators::Error& e) {
+            m_Err(e.what());
         }
     }
     val_t m_VisitIdent(Identifier* ident) {
-        bool is_a_function = !arguments_scope.empty();
-        auto get_arg_ident = [this, &ident] {
-            for (auto it = this->arguments_scope.rbegin();
-                 it != this->arguments_scope.rend(); ++it) {
-                for (auto ti = it->begin(); ti != it->end(); ++ti) {
-                    if (ti->first == ident->name) return ti;
-                }
-            }
-            return this->arguments_scope.back().end();
-        }();
-        bool is_a_function_arg = get_arg_ident != arguments_scope.back().end();
-        bool is_a_defined_ident =
-            scope::userdefined.find(ident->name) != scope::userdefined.end();
-        bool is_a_builtin_ident = ami::builtins::constants.find(ident->name) !=
-                                  ami::builtins::constants.end();
-        if (is_a_function_arg) {
-            return get_arg_ident->second;
-        } else if (is_a_builtin_ident) {
-            return Number(ami::builtins::constants.at(ident->name));
-        } else if ((!scope::userdefined.empty()) && is_a_defined_ident) {
-            return scope::userdefined.at(ident->name);
+        // a resolved argument is in the frame of the call whose body it's in
+        if (ident->slot != Identifier::no_slot)
+            if (const val_t* arg = arguments_scope.slot(ident->slot))
+                return *arg;
+        if (const val_t* arg = arguments_scope.find(ident->id)) {
+            return *arg;
+        } else if (const long double* builtin_ident =
+                ami::builtins::constant(ident->id)) {
+            return Number(*builtin_ident);
+        } else if (val_t* defined =
+                       scope::lookup(scope::userdefined, ident->id)) {
+            return *defined;
         } else {
             m_Err(
                 fmt::format("use of undeclared identifier '{}'", ident->name));
         }
     }
     val_t m_VisitUserDefinedIdentifier(UserDefinedIdentifier* udi) {
-        bool is_builtin = ami::builtins::constants.find(udi->name) !=
-                          ami::builtins::constants.end();
+        bool is_builtin = ami::builtins::constant(udi->id) != nullptr;
         if (is_builtin) {
             m_Err(fmt::format("Can't assign to built-in identifier '{}'",
                               udi->name));
         } else {
             auto visited = visit(udi->value);
-            scope::userdefined.insert_or_assign(udi->name, visited);
+            scope::assign(scope::userdefined, udi->id, std::move(visited));
             return fmt::format("defined identifier '{}'", udi->name);
         }
     }
+    // the function's body is evaluated only when it's called. a call of the
+    // function itself in tail position, through the branches of `if`s,
+    // reuses the frame so the recursion runs as a loop. `frame` is the index
+    // of the frame of the call
+    val_t m_VisitBody(symbol_t id, const ptr_t& body,
+                      const std::vector<ptr_t>& params, std::size_t frame) {
+        ptr_t tail = body;
+        while (true) {
+            while (tail->type() == AstType::IfExpr && !tail->shared) {
+                tail = m_Branch(static_cast<IfExpr*>(tail.get()));
+                if (tail == nullptr) return NullExpr{};
+            }
+            if (tail->type() != AstType::FunctionCall || tail->shared)
+                return visit(tail);
+            auto* call = static_cast<FunctionCall*>(tail.get());
+            if (call->id != id || call->arguments.size() != params.size())
+                return visit(tail);
+            for (std::size_t i = 0; i < params.size(); i++) {
+                Identifier* ident = static_cast<Identifier*>(params[i].get());
+                arguments_scope.add(ident->id, visit(call->arguments[i]));
+            }
+            arguments_scope.replace(frame);
+            m_Call = ++m_Calls;
+            tail = body;
+        }
+    }
     val_t m_VisitFunction(FunctionCall* fc) {
-        decltype(ami::builtins::functions)::iterator get_builtin =
-            ami::builtins::functions.find(fc->name);
-        bool is_builtin = get_builtin != ami::builtins::functions.end();
-        auto get_userdefined = scope::userdefined_functions.find(fc->name);
-        bool is_userdefined =
-            get_userdefined != scope::userdefined_functions.end();
+        const builtins::details::FunctionHandler* get_builtin =
+            ami::builtins::function(fc->id);
+        bool is_builtin = get_builtin != nullptr;
+        Function* get_userdefined =
+            scope::lookup(scope::userdefined_functions, fc->id);
+        bool is_userdefined = get_userdefined != nullptr;
         // helper variables
-        std::vector<std::shared_ptr<ami::Expr>> args = fc->arguments;
+        const std::vector<std::shared_ptr<ami::Expr>>& args = fc->arguments;
         if (is_builtin) {
             std::vector<val_t> parsed_args;
-            if (args.size() != get_builtin->second.args_count) {
+            if (args.size() != get_builtin->args_count) {
                 m_Err(fmt::format(
                     "mismatched arguments for function call '{}' "
                     ",called with {} argument, expected {} ",
-                    fc->name, args.size(), get_builtin->second.args_count));
+                    fc->name, args.size(), get_builtin->args_count));
             }
             // evaluate each passed argument
             std::for_each(args.begin(), args.end(),
                           [&parsed_args, this](const auto& arg) {
                               parsed_args.push_back(visit(arg));
                           });
-            return get_builtin->second.callback(parsed_args);
+            return get_builtin->callback(parsed_args);
         } else if (is_userdefined) {
-            if (args.size() != get_userdefined->second.arguments.size()) {
+            if (args.size() != get_userdefined->arguments.size()) {
                 m_Err(
                     fmt::format("mismatched arguments for function call '{}' "
                                 ",called with {} argument, expected {} ",
                                 fc->name, args.size(),
-                                get_userdefined->second.arguments.size()));
+                                get_userdefined->arguments.size()));
             }
-            if (std::size_t count = get_userdefined->second.call_count;
+            if (std::size_t count = get_userdefined->call_count;
                 count >= max_call_count) {
-                get_userdefined->second.call_count = 0;
+                get_userdefined->call_count = 0;
                 m_Err(fmt::format(
                           "function '{}' has been called recursively for {}",
                           fc->name, count),
                       0);
             }
-            std::vector<std::shared_ptr<Expr>> fc_args =
-                get_userdefined->second.arguments;
-            iscope_t tempscope;
-            for (decltype(fc_args)::size_type i = 0; i < fc_args.size(); i++) {
-                Identifier* ident =
-                    static_cast<Identifier*>(fc_args.at(i).get());
-                tempscope.insert_or_assign(ident->name, visit(args.at(i)));
-            }
-            std::shared_ptr<Expr> fc_body = get_userdefined->second.body;
-            get_userdefined->second.call_count++;
-            arguments_scope.push_back(tempscope);
-            // the function's body is evaluated only when it's called
-            return visit(fc_body);
+            // the arguments and the frame they become only last as long as
+            // the call so call_count is the recursion depth of the function
+            struct CallGuard {
+                Interpreter* self;
+                symbol_t id;
+                std::size_t base, depth;
+                std::size_t caller;
+                bool called = false;
+                ~CallGuard() {
+                    self->arguments_scope.unwind(base, depth);
+                    if (!called) return;
+                    self->m_Call = caller;
+                    Function* f =
+                        scope::lookup(scope::userdefined_functions, id);
+                    if (f != nullptr && f->call_count > 0) --f->call_count;
+                }
+            } guard{this, fc->id, arguments_scope.top(),
+                    arguments_scope.depth(), m_Call};
+            const auto& fc_args = get_userdefined->arguments;
+            for (std::size_t i = 0; i < fc_args.size(); i++) {
+                Identifier* ident = static_cast<Identifier*>(fc_args[i].get());
+                arguments_scope.add(ident->id, visit(args[i]));
+            }
+            // numeric functions run as machine code when the jit is enabled
+            // and they compile, the other pure ones called with numbers are
+            // memoized. the native calls would skip the table
+            bool native_first = !m_JitTooDeep && jit::enabled &&
+                                jit::code(*get_userdefined) != nullptr;
+            std::vector<long double> key;
+            bool memoized = !native_first && memo::enabled(*get_userdefined);
+            for (std::size_t i = 0; memoized && i < fc_args.size(); i++) {
+                auto* num = std::get_if<Number>(
+                    arguments_scope.arguments(guard.base) + i);
+                memoized = num != nullptr;
+                if (memoized) key.push_back(num->val);
+            }
+            if (memoized)
+                if (const val_t* known = memo::find(fc->id, key)) return *known;
+            std::optional<long double> native;
+            if (native_first)
+                native = jit::call(*get_userdefined,
+                                   arguments_scope.arguments(guard.base),
+                                   fc_args.size(), arguments_scope,
+                                   m_JitTooDeep);
+            // its long doubles round the integers an Integer would hold
+            if (native && !(std::fabs(*native) >= exact::limit))
+                return Number(*native);
+            std::shared_ptr<Expr> fc_body = get_userdefined->body;
+            get_userdefined->call_count++;
+            guard.called = true;
+            arguments_scope.push(guard.base);
+            m_Call = ++m_Calls;
+            if (!memoized)
+                return m_VisitBody(fc->id, fc_body, fc_args, guard.depth);
+            val_t out = m_VisitBody(fc->id, fc_body, fc_args, guard.depth);
+            memo::store(fc->id, std::move(key), out);
+            return out;
 
         } else {
             m_Err(fmt::format("use of undeclared function '{}'", fc->name));
         }
     }
     val_t m_VisitFunctionDef(Function* func) {
-        std::string name = func->name;
-        bool is_builtin = ami::builtins::functions.find(name) !=
-                          ami::builtins::functions.end();
+        std::string_view name = func->name;
+        bool is_builtin = ami::builtins::function(func->id) != nullptr;
         if (is_builtin) {
             m_Err(fmt::format("can't assign to built-in function '{}'", name));
         } else {
-            scope::userdefined_functions.insert_or_assign(
-                name, Function(func->name, func->body, func->arguments));
+            // the definition outlives its parse so the stored body shares
+            // the ownership of the arena it was parsed into
+            ptr_t body = func->body;
+            if (auto arena = func->arena.lock())
+                body = ptr_t(arena, body.get());
+            scope::assign(scope::userdefined_functions, func->id,
+                          Function(func->id, body, func->arguments));
+            memo::redefined(func->id);
             return fmt::format("defined function '{}'", name);
         }
     }
-    val_t m_VisitMod(BinaryOpExpr* boe) {
-        val_t _lhs = visit(boe->lhs);
-        val_t _rhs = visit(boe->rhs);
-        if (m_IsValidOper(_lhs) && m_IsValidOper(_rhs))
-            return Number(std::fmod(std::get<Number>(_lhs).val,
-                                    std::get<Number>(_rhs).val));
-        else
-            m_Err("binary operation '%%' is not valid in this context");
-    }
-    val_t m_VisitPow(BinaryOpExpr* boe) {
-        val_t _lhs = visit(boe->lhs);
-        val_t _rhs = visit(boe->rhs);
-        if (m_IsValidOper(_lhs) && m_IsValidOper(_rhs))
-            return Number(std::pow(std::get<Number>(_lhs).val,
-                                   std::get<Number>(_rhs).val));
-        else
-            m_Err("binary operation '^' is not valid in this context");
-    }
     val_t m_VisitNegative(NegativeExpr* ex) {
         val_t val = visit(ex->value);
         if (m_IsValidOper(val))
             return Number(-std::get<Number>(val).val);
+        else if (auto* big = std::get_if<Integer>(&val))
+            return Integer(-big->value);
+        else if (auto* frac = std::get_if<Fraction>(&val))
+            return Fraction(-frac->value);
         else
             m_Err("binary operation '-' is not valid in this context");
     }
     bool m_IsBoolOrNum(const val_t& oht) {}
     val_t m_VisitLogicalNot(LogicalExpr*) {}
-    val_t m_VisitLogicalAnd(LogicalExpr* lexpr) {
-        val_t _lhs = visit(lexpr->lhs);
-        val_t _rhs = visit(lexpr->rhs);
-        Number* lhs_get_number = std::get_if<Number>(&_lhs);
-        Boolean* lhs_get_bool = std::get_if<Boolean>(&_lhs);
-        Number* rhs_get_number = std::get_if<Number>(&_rhs);
-        Boolean* rhs_get_bool = std::get_if<Boolean>(&_rhs);
-        bool lhs_is_number = lhs_get_number != nullptr;
-        bool lhs_is_bool = lhs_get_bool != nullptr;
-        bool rhs_is_number = rhs_get_number != nullptr;
-        bool rhs_is_bool = rhs_get_bool != nullptr;
-        if (lhs_is_number && rhs_is_number) {
-            return Boolean(lhs_get_number->val && rhs_get_number->val);
-        } else if (lhs_is_bool && rhs_is_bool) {
-            return Boolean(lhs_get_bool->val && rhs_get_bool->val);
-        } else if (lhs_is_number && rhs_is_bool) {
-            return Boolean(lhs_get_number->val && rhs_get_bool->val);
-        } else if (lhs_is_bool && rhs_is_number) {
-            return Boolean(lhs_get_bool->val && rhs_get_number->val);
-        } else {
-            m_Err("logical 'and' is not valid in this context");
-        }
-    }
-    val_t m_VisitLogicalOr(LogicalExpr* lexpr) {
-        val_t _lhs = visit(lexpr->lhs);
-        val_t _rhs = visit(lexpr->rhs);
-        Number* lhs_get_number = std::get_if<Number>(&_lhs);
-        Boolean* lhs_get_bool = std::get_if<Boolean>(&_lhs);
-        Number* rhs_get_number = std::get_if<Number>(&_rhs);
-        Boolean* rhs_get_bool = std::get_if<Boolean>(&_rhs);
-        bool lhs_is_number = lhs_get_number != nullptr;
-        bool lhs_is_bool = lhs_get_bool != nullptr;
-        bool rhs_is_number = rhs_get_number != nullptr;
-        bool rhs_is_bool = rhs_get_bool != nullptr;
-        if (lhs_is_number && rhs_is_number) {
-            return Boolean(lhs_get_number->val || rhs_get_number->val);
-        } else if (lhs_is_bool && rhs_is_bool) {
-            return Boolean(lhs_get_bool->val || rhs_get_bool->val);
-        } else if (lhs_is_number && rhs_is_bool) {
-            return Boolean(lhs_get_number->val || rhs_get_bool->val);
-        } else if (lhs_is_bool && rhs_is_number) {
-            return Boolean(lhs_get_bool->val || rhs_get_number->val);
-        } else {
-            m_Err("logical 'or' is not valid in this context");
-        }
-    }
-    val_t m_VisitEquals(Comparison* lexpr) {
-        val_t _lhs = visit(lexpr->lhs);
-        val_t _rhs = visit(lexpr->rhs);
-        Number* lhs_get_number = std::get_if<Number>(&_lhs);
-        Boolean* lhs_get_bool = std::get_if<Boolean>(&_lhs);
-        Number* rhs_get_number = std::get_if<Number>(&_rhs);
-        Boolean* rhs_get_bool = std::get_if<Boolean>(&_rhs);
-        SetObject* lhs_get_set = std::get_if<SetObject>(&_lhs);
-        SetObject* rhs_get_set = std::get_if<SetObject>(&_rhs);
-        bool lhs_is_number = lhs_get_number != nullptr;
-        bool lhs_is_bool = lhs_get_bool != nullptr;
-        bool rhs_is_number = rhs_get_number != nullptr;
-        bool rhs_is_bool = rhs_get_bool != nullptr;
-        if (lhs_is_number && rhs_is_number) {
-            return (Boolean(lhs_get_number->val == rhs_get_number->val));
-        } else if (lhs_is_bool && rhs_is_bool) {
-            return (Boolean(lhs_get_bool->val == rhs_get_bool->val));
-        } else if (lhs_is_number && rhs_is_bool) {
-            return (Boolean(lhs_get_number->val == rhs_get_bool->val));
-        } else if (lhs_is_bool && rhs_is_number) {
-            return (Boolean(lhs_get_bool->val == rhs_get_number->val));
-        } else if ((lhs_get_set != nullptr) && (rhs_get_set != nullptr)) {
-            return m_VisitEqualsSet(lhs_get_set, rhs_get_set);
-        } else {
-            m_Err("comparison operator '==' is not valid in this context");
-        }
-    }
-    val_t m_VisitNotEquals(Comparison* lexpr) {
-        auto v_bool = m_VisitEquals(lexpr);
-        return Boolean(!std::get_if<Boolean>(&v_bool)->val);
-    }
-    val_t m_VisitGreaterThan(Comparison* lexpr) {
-        val_t _lhs = visit(lexpr->lhs);
-        val_t _rhs = visit(lexpr->rhs);
-        Number* lhs_get_number = std::get_if<Number>(&_lhs);
-        Boolean* lhs_get_bool = std::get_if<Boolean>(&_lhs);
-        Number* rhs_get_number = std::get_if<Number>(&_rhs);
-        Boolean* rhs_get_bool = std::get_if<Boolean>(&_rhs);
-        bool lhs_is_number = lhs_get_number != nullptr;
-        bool lhs_is_bool = lhs_get_bool != nullptr;
-        bool rhs_is_number = rhs_get_number != nullptr;
-        bool rhs_is_bool = rhs_get_bool != nullptr;
-        if (lhs_is_number && rhs_is_number) {
-            return (Boolean(lhs_get_number->val > rhs_get_number->val));
-        } else if (lhs_is_bool && rhs_is_bool) {
-            return (Boolean(lhs_get_bool->val > rhs_get_bool->val));
-        } else if (lhs_is_number && rhs_is_bool) {
-            return (Boolean(lhs_get_number->val > rhs_get_bool->val));
-        } else if (lhs_is_bool && rhs_is_number) {
-            return (Boolean(lhs_get_bool->val > rhs_get_number->val));
-        } else {
-            m_Err("comparison operator '>' is not valid in this context");
-        }
-    }
-    val_t m_VisitLess(Comparison* lexpr) {
-        val_t _lhs = visit(lexpr->lhs);
-        val_t _rhs = visit(lexpr->rhs);
-        Number* lhs_get_number = std::get_if<Number>(&_lhs);
-        Boolean* lhs_get_bool = std::get_if<Boolean>(&_lhs);
-        Number* rhs_get_number = std::get_if<Number>(&_rhs);
-        Boolean* rhs_get_bool = std::get_if<Boolean>(&_rhs);
-        bool lhs_is_number = lhs_get_number != nullptr;
-        bool lhs_is_bool = lhs_get_bool != nullptr;
-        bool rhs_is_number = rhs_get_number != nullptr;
-        bool rhs_is_bool = rhs_get_bool != nullptr;
-        if (lhs_is_number && rhs_is_number) {
-            return (Boolean(lhs_get_number->val < rhs_get_number->val));
-        } else if (lhs_is_bool && rhs_is_bool) {
-            return (Boolean(lhs_get_bool->val < rhs_get_bool->val));
-        } else if (lhs_is_number && rhs_is_bool) {
-            return (Boolean(lhs_get_number->val < rhs_get_bool->val));
-        } else if (lhs_is_bool && rhs_is_number) {
-            return (Boolean(lhs_get_bool->val < rhs_get_number->val));
-        } else {
-            m_Err("comparison operator '<' is not valid in this context");
-        }
-    }
-    val_t m_VisitLessOrEqual(Comparison* comp) {
-        auto l = m_VisitLess(comp);
-        auto r = m_VisitEquals(comp);
-        return Boolean(std::get_if<Boolean>(&l)->val ||
-                       std::get_if<Boolean>(&r)->val);
-    }
-    val_t m_VisitGreaterOrEqual(Comparison* comp) {
-        auto l = m_VisitGreaterThan(comp);
-        auto r = m_VisitEquals(comp);
-        return Boolean(std::get_if<Boolean>(&l)->val ||
-                       std::get_if<Boolean>(&r)->val);
-    }
     val_t m_VisitOpAndAssignExpr(OpAndAssignExpr* oexpr) {
         m_CheckOrErr(oexpr->lhs->type() == AstType::Identifier,
                      "assign oprators are only valid for identifiers");
         auto t_f_temp = visit(oexpr->rhs);
-        Number* t_new_num = std::get_if<Number>(&t_f_temp);
-        m_CheckOrErr(t_new_num != nullptr,
+        m_CheckOrErr(exact::numeric(t_f_temp),
                      "only numbers are valid as a right operand");
         Identifier* ident = static_cast<Identifier*>(oexpr->lhs.get());
         auto t_v_value = m_VisitIdent(ident);
-        Number* t_num = std::get_if<Number>(&t_v_value);
-        m_CheckOrErr(t_num != nullptr,
+        m_CheckOrErr(exact::numeric(t_v_value),
                      "binary operators are only valid for numbers");
-        bool is_ud =
-            scope::userdefined.find(ident->name) != scope::userdefined.end();
+        bool is_ud = scope::lookup(scope::userdefined, ident->id) != nullptr;
         m_CheckOrErr(
             is_ud, fmt::format("'{}' isn't a defined identifier", ident->name));
-        auto out = visit(std::make_shared<BinaryOpExpr>(
-            oexpr->op, std::make_shared<Number>(t_num->val),
-            std::make_shared<Number>(t_new_num->val)));
-        scope::userdefined.insert_or_assign(ident->name, out);
+        // any two numbers have a kernel for the arithmetic operators
+        auto out = operators::table().find(oexpr->op, t_v_value, t_f_temp)(
+            t_v_value, t_f_temp);
+        scope::assign(scope::userdefined, ident->id, std::move(out));
         return NullExpr{};
     }
     val_t m_VisitIfExpr(IfExpr* iexpr) {
+        ptr_t branch = m_Branch(iexpr);
+        return branch != nullptr ? visit(branch) : NullExpr{};
+    }
+    // the branch `iexpr` takes, nullptr when it has none
+    ptr_t m_Branch(IfExpr* iexpr) {
         auto _cond = visit(iexpr->cond);
         Boolean* get_bool = std::get_if<Boolean>(&_cond);
         Number* get_num = std::get_if<Number>(&_cond);
@@ -571,17 +316,15 @@ class Interpreter {
         bool is_num = get_num != nullptr;
         bool is_str = get_str != nullptr;
         bool is_null = get_null != nullptr;
-        bool is_true = is_bool
-                           ? get_bool->val
-                           : (is_num ? get_num->val
-                                     : (is_str ? !get_str->empty() : false));
-        if (is_true && !(is_null)) {
-            return visit(iexpr->body);
-        } else if (iexpr->elsestmt != nullptr) {
-            return visit(iexpr->elsestmt);
-        } else {
-            return NullExpr{};
-        }
+        // integers and fractions are never zero, see exact.hpp
+        bool is_exact = std::holds_alternative<Integer>(_cond) ||
+                        std::holds_alternative<Fraction>(_cond);
+        bool is_true =
+            is_exact ||
+            (is_bool ? get_bool->val
+                     : (is_num ? get_num->val
+                               : (is_str ? !get_str->empty() : false)));
+        return is_true && !(is_null) ? iexpr->body : iexpr->elsestmt;
     }
     val_t m_VisitNumber(Number* num) { return Number(num->val); }
     val_t m_VisitNull() { return NullExpr{}; }
@@ -590,6 +333,9 @@ class Interpreter {
         auto value = visit(_b->value);
         if (auto _number = std::get_if<Number>(&value)) {
             return Boolean(!_number->val);
+        } else if (std::holds_alternative<Integer>(value) ||
+                   std::holds_alternative<Fraction>(value)) {
+            return Boolean(false);
         } else if (auto _bool = std::get_if<Boolean>(&value)) {
             return Boolean(!_bool->val);
         } else if (std::get_if<NullExpr>(&value)) {
@@ -598,8 +344,18 @@ class Interpreter {
             m_Err("operator 'not' is only valid for numbers and booleans");
         }
     }
+    // sets, vectors, matrices, points and intervals hold long doubles, an
+    // integer or a fraction is rounded to one
+    val_t m_VisitElement(const ptr_t& e) {
+        val_t v = visit(e);
+        if (std::holds_alternative<Integer>(v) ||
+            std::holds_alternative<Fraction>(v))
+            return Number(*exact::to_long_double(v));
+        return v;
+    }
     val_t m_VisitInterval(IntervalExpr* iexpr) {
-        val_t s_min = visit(iexpr->min.value), s_max = visit(iexpr->max.value);
+        val_t s_min = m_VisitElement(iexpr->min.value),
+              s_max = m_VisitElement(iexpr->max.value);
         Number *get_n = std::get_if<Number>(&s_min),
                *get_nn = std::get_if<Number>(&s_max);
         if ((get_n == nullptr) || (get_nn == nullptr)) {
@@ -616,271 +372,149 @@ class Interpreter {
                                 iexpr->max.strict));
         }
     }
-    bool m_IsInInterval(long double t_num, long double t_min, long double t_max,
-                        bool strict_min, bool strict_max) {
-        return ((strict_min ? (t_min < t_num) : (t_min <= t_num)) &&
-                (strict_max ? (t_max > t_num) : (t_max >= t_num)));
+    // `v` as disjoint intervals when it's an interval, a union or an
+    // intersection of them
+    std::optional<IntervalSet> m_ToIntervals(const val_t& v) {
+        if (auto* un = std::get_if<UnionExpr>(&v)) return un->intervals;
+        if (auto* in = std::get_if<InterSectionExpr>(&v)) return in->intervals;
+        auto* inter = std::get_if<IntervalExpr>(&v);
+        if (inter == nullptr) return std::nullopt;
+        // the bounds of an evaluated interval are numbers
+        return IntervalSet(IntervalSet::Interval{
+            static_cast<Number*>(inter->min.value.get())->val,
+            static_cast<Number*>(inter->max.value.get())->val,
+            inter->min.strict, inter->max.strict});
     }
     val_t m_VisitInExpr(InExpr* iexpr) {
-        val_t num = visit(iexpr->number), inter = visit(iexpr->inter);
+        val_t num = m_VisitElement(iexpr->number), inter = visit(iexpr->inter);
         Number* get_num = std::get_if<Number>(&num);
         SetObject* get_setf = std::get_if<SetObject>(&num);
-        IntervalExpr* get_inter = std::get_if<IntervalExpr>(&inter);
-        UnionExpr* get_union = std::get_if<UnionExpr>(&inter);
-        InterSectionExpr* get_intersection =
-            std::get_if<InterSectionExpr>(&inter);
         SetObject* get_set = std::get_if<SetObject>(&inter);
-        if (get_union != nullptr && get_num != nullptr) {
-            return m_VisitInExprUnionHelper(get_num->val, get_union);
-        } else if (get_intersection != nullptr && get_num != nullptr) {
-            return m_VisitInExprIntersectionHelper(get_num->val,
-                                                   get_intersection);
+        std::optional<IntervalSet> intervals = m_ToIntervals(inter);
+        if (get_num != nullptr && intervals) {
+            return Boolean(intervals->contains(get_num->val));
+        } else if (get_setf != nullptr && intervals) {
+            // a set is in intervals when all of its elements are
+            const Numbers& nums = get_setf->numbers;
+            std::unique_ptr<bool[]> in(new bool[nums.size()]);
+            intervals->contains(nums.data(), nums.size(), in.get());
+            return Boolean(std::all_of(in.get(), in.get() + nums.size(),
+                                       [](bool b) { return b; }));
         } else if (get_num != nullptr && get_set != nullptr) {
-            auto search_result = std::find_if(
-                get_set->value.begin(), get_set->value.end(),
-                [this, get_num](auto& e) {
-                    auto visited = visit(e);
-                    if (Number* t_number = std::get_if<Number>(&visited)) {
-                        return (t_number->val == get_num->val);
-                    } else {
-                        m_Err("invalid type");
-                    }
-                });
-            return Boolean(search_result != get_set->value.end());
-        } else if (get_num != nullptr && get_inter != nullptr) {
-            val_t s_min = visit(get_inter->min.value);
-            val_t s_max = visit(get_inter->max.value);
-            Number *get_min = std::get_if<Number>(&s_min),
-                   *get_max = std::get_if<Number>(&s_max);
-            m_CheckOrErr((get_min != nullptr) && (get_max != nullptr),
-                         "operator 'in' is only valid between numbers and "
-                         "intervals");
-            return Boolean(m_IsInInterval(get_num->val, get_min->val,
-                                          get_max->val, get_inter->min.strict,
-                                          get_inter->max.strict));
+            return Boolean(std::binary_search(get_set->numbers.begin(),
+                                              get_set->numbers.end(),
+                                              get_num->val));
         } else if (get_setf != nullptr && get_set != nullptr) {
-            auto search_result = std::find_if(
-                get_set->value.begin(), get_set->value.end(),
-                [this, get_setf](auto& e) {
-                    auto visited = visit(e);
-                    if (SetObject* t_setobj =
-                            std::get_if<SetObject>(&visited)) {
-                        return (t_setobj->value == get_setf->value);
-                    } else {
-                        m_Err("invalid type");
-                    }
-                });
-            return Boolean(search_result != get_set->value.end());
+            // sets only hold numbers so a set is never an element of one
+            m_CheckOrErr(get_set->numbers.empty(), "invalid type");
+            return Boolean(false);
         } else {
             m_Err("invalid use of keyword 'in'");
         }
     }
-    val_t m_VisitInExprUnionHelper(long double x, UnionExpr* iun) {
-        m_CheckOrErr((iun != nullptr), "invalid union");
-        val_t t_right_inter = visit(iun->right_interval);
-        val_t t_left_inter = visit(iun->left_interval);
-        IntervalExpr* right_inter = std::get_if<IntervalExpr>(&t_right_inter);
-        IntervalExpr* left_inter = std::get_if<IntervalExpr>(&t_left_inter);
-        UnionExpr* right_union = std::get_if<UnionExpr>(&t_right_inter);
-        UnionExpr* left_union = std::get_if<UnionExpr>(&t_left_inter);
-        if (left_union != nullptr) {
-            val_t v_is_in = m_VisitInExprUnionHelper(x, left_union);
-            val_t v_n_max = visit(right_inter->max.value);
-            val_t v_n_min = visit(right_inter->min.value);
-            Number* n_max = std::get_if<Number>(&v_n_max);
-            Number* n_min = std::get_if<Number>(&v_n_min);
-            Boolean* is_in = std::get_if<Boolean>(&v_is_in);
-            return Boolean(is_in->val ||
-                           (m_IsInInterval(x, n_min->val, n_max->val,
-                                           right_inter->min.strict,
-                                           right_inter->max.strict)));
-        } else if (right_union != nullptr) {
-            val_t v_is_in = m_VisitInExprUnionHelper(x, right_union);
-            val_t v_n_max = visit(left_inter->max.value);
-            val_t v_n_min = visit(left_inter->min.value);
-            Number* n_max = std::get_if<Number>(&v_n_max);
-            Number* n_min = std::get_if<Number>(&v_n_min);
-            Boolean* is_in = std::get_if<Boolean>(&v_is_in);
-            return Boolean(is_in->val ||
-                           (m_IsInInterval(x, n_min->val, n_max->val,
-                                           left_inter->min.strict,
-                                           left_inter->max.strict)));
-        } else {
-            val_t v_l_max = visit(left_inter->max.value);
-            val_t v_l_min = visit(left_inter->min.value);
-            val_t v_r_max = visit(right_inter->max.value);
-            val_t v_r_min = visit(right_inter->min.value);
-            Number* l_max = std::get_if<Number>(&v_l_max);
-            Number* l_min = std::get_if<Number>(&v_l_min);
-            Number* r_max = std::get_if<Number>(&v_r_max);
-            Number* r_min = std::get_if<Number>(&v_r_min);
-            return Boolean(m_IsInInterval(x, l_min->val, l_max->val,
-                                          left_inter->min.strict,
-                                          left_inter->max.strict) ||
-                           m_IsInInterval(x, r_min->val, r_max->val,
-                                          right_inter->min.strict,
-                                          right_inter->max.strict));
-        }
-    }
-    val_t m_VisitInExprIntersectionHelper(long double x,
-                                          InterSectionExpr* iun) {
-        m_CheckOrErr((iun != nullptr), "invalid intersection");
-        val_t t_right_inter = visit(iun->rhs);
-        val_t t_left_inter = visit(iun->lhs);
-        IntervalExpr* right_inter = std::get_if<IntervalExpr>(&t_right_inter);
-        IntervalExpr* left_inter = std::get_if<IntervalExpr>(&t_left_inter);
-        InterSectionExpr* right_intersection =
-            std::get_if<InterSectionExpr>(&t_right_inter);
-        InterSectionExpr* left_intersection =
-            std::get_if<InterSectionExpr>(&t_left_inter);
-        if (left_intersection != nullptr) {
-            val_t v_is_in =
-                m_VisitInExprIntersectionHelper(x, left_intersection);
-            val_t v_n_max = visit(right_inter->max.value);
-            val_t v_n_min = visit(right_inter->min.value);
-            Number* n_max = std::get_if<Number>(&v_n_max);
-            Number* n_min = std::get_if<Number>(&v_n_min);
-            Boolean* is_in = std::get_if<Boolean>(&v_is_in);
-            return Boolean(is_in->val &&
-                           (m_IsInInterval(x, n_min->val, n_max->val,
-                                           right_inter->min.strict,
-                                           right_inter->max.strict)));
-        } else if (right_intersection != nullptr) {
-            val_t v_is_in =
-                m_VisitInExprIntersectionHelper(x, right_intersection);
-            val_t v_n_max = visit(left_inter->max.value);
-            val_t v_n_min = visit(left_inter->min.value);
-            Number* n_max = std::get_if<Number>(&v_n_max);
-            Number* n_min = std::get_if<Number>(&v_n_min);
-            Boolean* is_in = std::get_if<Boolean>(&v_is_in);
-            return Boolean(is_in->val &&
-                           (m_IsInInterval(x, n_min->val, n_max->val,
-                                           left_inter->min.strict,
-                                           left_inter->max.strict)));
-        } else {
-            val_t v_l_max = visit(left_inter->max.value);
-            val_t v_l_min = visit(left_inter->min.value);
-            val_t v_r_max = visit(right_inter->max.value);
-            val_t v_r_min = visit(right_inter->min.value);
-            Number* l_max = std::get_if<Number>(&v_l_max);
-            Number* l_min = std::get_if<Number>(&v_l_min);
-            Number* r_max = std::get_if<Number>(&v_r_max);
-            Number* r_min = std::get_if<Number>(&v_r_min);
-            return Boolean(m_IsInInterval(x, l_min->val, l_max->val,
-                                          left_inter->min.strict,
-                                          left_inter->max.strict) &&
-                           m_IsInInterval(x, r_min->val, r_max->val,
-                                          right_inter->min.strict,
-                                          right_inter->max.strict));
-        }
-    }
     val_t m_VisitUnionExpr(UnionExpr* iun) {
         val_t _l = visit(iun->left_interval), _r = visit(iun->right_interval);
-        IntervalExpr *left_inter = std::get_if<IntervalExpr>(&_l),
-                     *right_inter = std::get_if<IntervalExpr>(&_r);
         SetObject *left_set = std::get_if<SetObject>(&_l),
                   *right_set = std::get_if<SetObject>(&_r);
-        UnionExpr *left_un = std::get_if<UnionExpr>(&_l),
-                  *right_un = std::get_if<UnionExpr>(&_r);
-        if (left_un != nullptr) {
-            return UnionExpr(std::make_shared<UnionExpr>(*left_un),
-                             std::make_shared<IntervalExpr>(*right_inter));
-        } else if (right_un != nullptr) {
-            return UnionExpr(std::make_shared<IntervalExpr>(*left_inter),
-                             std::make_shared<UnionExpr>(*right_un));
-        } else if (left_un != nullptr && right_un != nullptr) {
-            return UnionExpr(std::make_shared<UnionExpr>(*left_un),
-                             std::make_shared<UnionExpr>(*right_un));
-        } else if (left_inter != nullptr && right_inter != nullptr) {
-            return UnionExpr(std::make_shared<IntervalExpr>(*left_inter),
-                             std::make_shared<IntervalExpr>(*right_inter));
+        std::optional<IntervalSet> left_inter = m_ToIntervals(_l),
+                                   right_inter = m_ToIntervals(_r);
+        if (left_inter && right_inter) {
+            return UnionExpr(IntervalSet::unite(*left_inter, *right_inter));
         } else if (left_set != nullptr && right_set != nullptr) {
-            std::vector<ptr_t> set_elms = left_set->value;
-            for (auto& e : right_set->value) {
-                set_elms.push_back(e);
-            }
-            return visit(std::make_shared<SetObject>(set_elms));
+            return m_MergeSets(
+                *left_set, *right_set,
+                left_set->numbers.size() + right_set->numbers.size(),
+                [](auto... args) { return std::set_union(args...); });
         } else {
             m_Err("invalid use of 'union'");
         }
     }
     val_t m_VisitInterSectionExpr(InterSectionExpr* iun) {
         val_t _l = visit(iun->lhs), _r = visit(iun->rhs);
-        IntervalExpr *left_inter = std::get_if<IntervalExpr>(&_l),
-                     *right_inter = std::get_if<IntervalExpr>(&_r);
         SetObject *left_set = std::get_if<SetObject>(&_l),
                   *right_set = std::get_if<SetObject>(&_r);
-        InterSectionExpr *left_un = std::get_if<InterSectionExpr>(&_l),
-                         *right_un = std::get_if<InterSectionExpr>(&_r);
-        if (left_un != nullptr) {
+        std::optional<IntervalSet> left_inter = m_ToIntervals(_l),
+                                   right_inter = m_ToIntervals(_r);
+        if (left_inter && right_inter) {
             return InterSectionExpr(
-                std::make_shared<InterSectionExpr>(*left_un),
-                std::make_shared<IntervalExpr>(*right_inter));
-        } else if (right_un != nullptr) {
-            return InterSectionExpr(
-                std::make_shared<IntervalExpr>(*left_inter),
-                std::make_shared<InterSectionExpr>(*right_un));
-        } else if (left_un != nullptr && right_un != nullptr) {
-            return InterSectionExpr(
-                std::make_shared<InterSectionExpr>(*left_un),
-                std::make_shared<InterSectionExpr>(*right_un));
-        } else if (left_inter != nullptr && right_inter != nullptr) {
-            return InterSectionExpr(
-                std::make_shared<IntervalExpr>(*left_inter),
-                std::make_shared<IntervalExpr>(*right_inter));
+                IntervalSet::intersect(*left_inter, *right_inter));
         } else if (left_set != nullptr && right_set != nullptr) {
-            std::vector<ptr_t> set_elms;
-            std::vector<Number> temp_elms;
-            for (auto& e : right_set->value) {
-                auto n_v = visit(e);
-                m_CheckOrErr(std::get_if<Number>(&n_v) != nullptr,
-                             "set can only contains numbers");
-                temp_elms.push_back(*std::get_if<Number>(&n_v));
-            }
-            for (auto& e : left_set->value) {
-                auto n_v = visit(e);
-                m_CheckOrErr(std::get_if<Number>(&n_v) != nullptr,
-                             "set can only contains numbers");
-                if (std::find(temp_elms.begin(), temp_elms.end(),
-                              *std::get_if<Number>(&n_v)) != temp_elms.end()) {
-                    set_elms.push_back(e);
-                }
-            }
-            return visit(std::make_shared<SetObject>(set_elms));
+            return m_MergeSets(
+                *left_set, *right_set,
+                std::min(left_set->numbers.size(), right_set->numbers.size()),
+                [](auto... args) { return std::set_intersection(args...); });
         } else {
             m_Err("invalid use of 'intersection'");
         }
     }
     val_t m_VisitSet(SetObject* so) {
-        if (!so->value.empty()) {
-            std::vector<ptr_t> content = so->value;
-            std::set<Number> numbers;
-            for (auto& e : content) {
-                auto n_v = visit(e);
-                m_CheckOrErr(std::get_if<Number>(&n_v) != nullptr,
-                             "set can only contains numbers");
-                numbers.insert(*std::get_if<Number>(&n_v));
-            }
-            content.clear();
-            for (auto& e : numbers) {
-                content.push_back(std::make_shared<Number>(e.val));
-            }
-            return SetObject(content);
-        } else {
-            return SetObject(so->value);
+        // an evaluated set is sorted and has no duplicates
+        Numbers numbers;
+        numbers.reserve(so->value.size());
+        for (auto& e : so->value) {
+            auto n_v = m_VisitElement(e);
+            m_CheckOrErr(std::get_if<Number>(&n_v) != nullptr,
+                         "set can only contains numbers");
+            numbers.push_back(std::get_if<Number>(&n_v)->val);
         }
+        // literals are often written in order already
+        if (!std::is_sorted(numbers.begin(), numbers.end()))
+            std::sort(numbers.begin(), numbers.end());
+        numbers.resize(std::unique(numbers.begin(), numbers.end()) -
+                       numbers.begin());
+        return SetObject(std::move(numbers));
     }
     val_t m_VisitVector(Vector* vec) {
         m_CheckOrErr((vec->value.size() == 2) || (vec->value.size() == 3),
                      "vector must have at least 2 elements");
-        for (auto& e : vec->value) {
-            val_t t_f_v_num = visit(e);
-            m_CheckOrErr(std::get_if<Number>(&t_f_v_num) != nullptr,
-                         "vectors can only contain numbers");
-            m_CheckOrErr(std::isfinite(std::get_if<Number>(&t_f_v_num)->val),
-                         "invalid value");
+        Numbers out(vec->value.size());
+        for (std::size_t i = 0; i < out.size(); i++) {
+            val_t t_f_v_num = m_VisitElement(vec->value[i]);
+            Number* num = std::get_if<Number>(&t_f_v_num);
+            m_CheckOrErr(num != nullptr, "vectors can only contain numbers");
+            m_CheckOrErr(std::isfinite(num->val), "invalid value");
+            out[i] = num->val;
+        }
+        return Vector(std::move(out));
+    }
+    // the elements of `row` appended to `out`
+    void m_MatrixRow(const std::vector<ptr_t>& row, Numbers& out) {
+        for (auto& e : row) {
+            val_t t_f_v_num = m_VisitElement(e);
+            Number* num = std::get_if<Number>(&t_f_v_num);
+            m_CheckOrErr(num != nullptr, "matrices can only contain numbers");
+            out.push_back(num->val);
+        }
+    }
+    val_t m_VisitMatrix(Matrix* mat) {
+        m_CheckOrErr(!mat->value.empty(), "matrix can't be empty");
+        AstType first = mat->value.front()->type();
+        // a list of numbers is a single column, like a vector
+        if (first != AstType::Vector && first != AstType::Matrix) {
+            std::size_t rows = mat->value.size();
+            Numbers out;
+            out.reserve(rows);
+            m_MatrixRow(mat->value, out);
+            return Matrix(rows, 1, std::move(out));
         }
-        return Vector(vec->value);
+        auto row_of = [this](const ptr_t& row) -> const std::vector<ptr_t>& {
+            if (row->type() == AstType::Vector)
+                return static_cast<Vector*>(row.get())->value;
+            m_CheckOrErr(row->type() == AstType::Matrix,
+                         "matrix rows must be in brackets");
+            return static_cast<Matrix*>(row.get())->value;
+        };
+        std::size_t rows = mat->value.size();
+        std::size_t cols = row_of(mat->value.front()).size();
+        Numbers out;
+        out.reserve(rows * cols);
+        for (auto& row : mat->value) {
+            const std::vector<ptr_t>& elms = row_of(row);
+            m_CheckOrErr(elms.size() == cols,
+                         "matrix rows must have the same size");
+            m_MatrixRow(elms, out);
+        }
+        return Matrix(rows, cols, std::move(out));
     }
     val_t m_VisitSliceExpr(SliceExpr* sexpr) {
         val_t v_target = visit(sexpr->target);
@@ -890,17 +524,25 @@ class Interpreter {
                      "subscript expression is valid only for sets");
         Number* num = std::get_if<Number>(&v_num);
         m_CheckOrErr(num != nullptr, "invalid type");
-        m_CheckOrErr((num->val < target->value.size()) && (num->val >= 0),
+        m_CheckOrErr((num->val < target->numbers.size()) && (num->val >= 0),
                      "invalid index");
-        return visit(target->value.at(num->val));
+        return Number(target->numbers[static_cast<std::size_t>(num->val)]);
     }
     val_t m_VisitFactorial(SymbolExpr* sexpr) {
         val_t t_visit = visit(sexpr->value);
+        if (auto* big = std::get_if<Integer>(&t_visit))
+            return Number(big->value.negative() ? 1 : INFINITY);
         Number* num = std::get_if<Number>(&t_visit);
         m_CheckOrErr(num != nullptr, "invalid use of '!'");
         long double out = 1;
+        // 20! is the last one a long double holds exactly
+        if (exact::integral(num->val) && num->val > 20) {
+            auto big = bigint::Int::factorial(
+                static_cast<std::uint64_t>(num->val));
+            return big ? exact::integer(std::move(*big)) : Number(INFINITY);
+        }
         if (std::isfinite(num->val) && (num->val <= 1e7)) {
-            for (long double i = 1; i <= num->val; ++i) {
+            for (long double i = 1; i <= num->val && std::isfinite(out); ++i) {
                 out *= i;
             }
             return Number(out);
@@ -911,17 +553,23 @@ class Interpreter {
     val_t m_VisitPoint(Point* p) {
         m_CheckOrErr((p->value.size() == 2) || (p->value.size() == 3),
                      "point must have at least 2 elements");
-        for (auto& e : p->value) {
-            val_t t_f_v_num = visit(e);
-            m_CheckOrErr(std::get_if<Number>(&t_f_v_num) != nullptr,
-                         "points can only contain numbers");
-            m_CheckOrErr(std::isfinite(std::get_if<Number>(&t_f_v_num)->val),
-                         "invalid value");
+        Numbers out(p->value.size());
+        for (std::size_t i = 0; i < out.size(); i++) {
+            val_t t_f_v_num = m_VisitElement(p->value[i]);
+            Number* num = std::get_if<Number>(&t_f_v_num);
+            m_CheckOrErr(num != nullptr, "points can only contain numbers");
+            m_CheckOrErr(std::isfinite(num->val), "invalid value");
+            out[i] = num->val;
         }
-        return Point(p->value);
+        return Point(std::move(out));
     }
     val_t m_VisitAbsExpr(SymbolExpr* sexpr) {
         val_t t_visit = visit(sexpr->value);
+        if (auto* big = std::get_if<Integer>(&t_visit))
+            return Integer(big->value.abs());
+        if (auto* frac = std::get_if<Fraction>(&t_visit))
+            return Fraction(frac->value.num().negative() ? -frac->value
+                                                         : frac->value);
         Number* num = std::get_if<Number>(&t_visit);
         m_CheckOrErr(num != nullptr, "invalid type");
         return Number(std::abs(num->val));
@@ -935,99 +583,47 @@ class Interpreter {
         Vector* vec = std::get_if<Vector>(&v_val);
         m_CheckOrErr(vec != nullptr, "can only compute the norm of a vector");
         long double out = 0;
-        for (auto& elm : vec->value) {
-            val_t t_vnum = visit(elm);
-            Number* num = std::get_if<Number>(&t_vnum);
-            m_CheckOrErr(num != nullptr, "invalid type");
-            out += std::pow(num->val, 2);
-        }
+        for (long double n : vec->numbers) out += n * n;
         return Number(std::sqrt(out));
     }
-    val_t m_VisitEqualsSet(SetObject* left_set, SetObject* right_set) {
-        m_CheckOrErr(left_set->value.size() == right_set->value.size(),
-                     "compared sets must have the same size");
-        for (std::size_t i = 0; i < left_set->value.size(); ++i) {
-            m_CheckOrErr(
-                right_set->value.at(i)->type() == left_set->value.at(i)->type(),
-                "compared sets must have the same type");
-            val_t v_left_num = visit(left_set->value.at(i));
-            val_t v_right_num = visit(right_set->value.at(i));
-            Number* left_num = std::get_if<Number>(&v_left_num);
-            Number* right_num = std::get_if<Number>(&v_right_num);
-            SetObject* t_left_set = std::get_if<SetObject>(&v_left_num);
-            SetObject* t_right_set = std::get_if<SetObject>(&v_right_num);
-            if ((left_num != nullptr) && (right_num != nullptr)) {
-                if (left_num->val != right_num->val) return Boolean(false);
-            }
-            if ((t_left_set != nullptr) && (t_right_set != nullptr)) {
-                if (t_left_set->value != t_right_set->value)
-                    return Boolean(false);
-            }
-        }
-        return Boolean(true);
+    val_t m_VisitShared(const ptr_t& expr) {
+        auto it = m_Shared.find(expr.get());
+        if (it != m_Shared.end() && it->second.call == m_Call)
+            return it->second.value;
+        val_t out = m_Visit(expr);
+        m_Shared.insert_or_assign(expr.get(), SharedValue{m_Call, out});
+        return out;
     }
-
-   public:
-    Interpreter(const ami::exceptions::ExceptionInterface& ei) : ei(ei){};
-    val_t visit(ptr_t expr) {
+    val_t m_Visit(const ptr_t& expr) {
         m_Pos++;
         switch (expr->type()) {
             default: {
                 m_Err("invalid expression");
             }
             case AstType::BinaryOp: {
-                BinaryOpExpr* bopexpr = static_cast<BinaryOpExpr*>(expr.get());
-                switch (bopexpr->op) {
-                    default:
-                        m_Err("invalid operator");
-                        break;
-                    case Op::Plus:
-                        return m_VisitAdd(bopexpr);
-                    case Op::Minus:
-                        return m_VisitSub(bopexpr);
-                    case Op::Div:
-                        return m_VisitDiv(bopexpr);
-                    case Op::Mult:
-                        return m_VisitMult(bopexpr);
-                    case Op::Pow:
-                        return m_VisitPow(bopexpr);
-                    case Op::Mod:
-                        return m_VisitMod(bopexpr);
-                }
+                auto* bopexpr = static_cast<BinaryOpExpr*>(expr.get());
+                return m_VisitOperator(bopexpr->op, bopexpr->lhs, bopexpr->rhs,
+                                       "binary operation");
             }
             case AstType::LogicalExpr: {
-                LogicalExpr* lexpr = static_cast<LogicalExpr*>(expr.get());
-                switch (lexpr->op) {
-                    default:
-                        m_Err("invalid logical operator");
-                    case Op::LogicalAnd:
-                        return m_VisitLogicalAnd(lexpr);
-                    case Op::LogicalOr:
-                        return m_VisitLogicalOr(lexpr);
-                }
+                auto* lexpr = static_cast<LogicalExpr*>(expr.get());
+                return m_VisitOperator(lexpr->op, lexpr->lhs, lexpr->rhs,
+                                       "logical");
             }
             case AstType::Comparison: {
-                Comparison* comp = static_cast<Comparison*>(expr.get());
-                switch (comp->op) {
-                    default:
-                        m_Err("invalid comparison operator");
-                    case Op::Greater:
-                        return m_VisitGreaterThan(comp);
-                    case Op::GreaterOrEqual:
-                        return m_VisitGreaterOrEqual(comp);
-                    case Op::Less:
-                        return m_VisitLess(comp);
-                    case Op::LessOrEqual:
-                        return m_VisitLessOrEqual(comp);
-                    case Op::Equals:
-                        return m_VisitEquals(comp);
-                    case Op::NotEquals:
-                        return m_VisitNotEquals(comp);
-                }
+                auto* comp = static_cast<Comparison*>(expr.get());
+                return m_VisitOperator(comp->op, comp->lhs, comp->rhs,
+                                       "comparison operator");
             }
             case AstType::Number: {
                 return m_VisitNumber(static_cast<Number*>(expr.get()));
             }
+            case AstType::Integer: {
+                return *static_cast<Integer*>(expr.get());
+            }
+            case AstType::Fraction: {
+                return *static_cast<Fraction*>(expr.get());
+            }
             case AstType::Identifier: {
                 return m_VisitIdent(static_cast<Identifier*>(expr.get()));
             }
@@ -1096,8 +692,18 @@ class Interpreter {
             case AstType::Point: {
                 return m_VisitPoint(static_cast<Point*>(expr.get()));
             }
+            case AstType::Matrix: {
+                return m_VisitMatrix(static_cast<Matrix*>(expr.get()));
+            }
         }
     }
+
+   public:
+    Interpreter(const ami::exceptions::Diagnostic& ei) : ei(ei){};
+    val_t visit(const ptr_t& expr) {
+        if (expr->shared) return m_VisitShared(expr);
+        return m_Visit(expr);
+    }
     val_t visitvec(const std::vector<ptr_t>& exprs) {
         val_t out = visit(exprs.at(0));
         for (auto& elm : exprs) out = visit(elm);
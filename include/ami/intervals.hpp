@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// union of intervals kept as a sorted list of disjoint intervals. any
+// union or intersection of intervals has one so membership is a binary
+// search instead of a walk over the expression that built it. the list
+// isn't changed once it's built so copies of a set share it
+
+namespace ami {
+class IntervalSet {
+   public:
+    struct Interval {
+        long double min, max;
+        bool min_strict, max_strict;
+        bool empty() const {
+            return min > max || (min == max && (min_strict || max_strict));
+        }
+        bool contains(long double x) const {
+            return (min_strict ? min < x : min <= x) &&
+                   (max_strict ? x < max : x <= max);
+        }
+    };
+    using list_t = std::vector<Interval>;
+
+   private:
+    // sorted by `min`, no two of them overlap or touch on a point one of
+    // them contains
+    std::shared_ptr<const list_t> m_Intervals;
+    static const list_t& m_Empty() {
+        static const list_t empty;
+        return empty;
+    }
+    // whether `lhs` starts before `rhs`, a closed bound before an open one
+    static bool m_StartsBefore(const Interval& lhs, const Interval& rhs) {
+        if (lhs.min != rhs.min) return lhs.min < rhs.min;
+        return !lhs.min_strict && rhs.min_strict;
+    }
+    // adds `in` to `out`, `in` doesn't start before the last interval
+    static void m_Append(list_t& out, const Interval& in) {
+        if (in.empty()) return;
+        if (!out.empty()) {
+            Interval& last = out.back();
+            bool joins = in.min < last.max ||
+                         (in.min == last.max &&
+                          !(in.min_strict && last.max_strict));
+            if (joins) {
+                if (in.max > last.max) {
+                    last.max = in.max;
+                    last.max_strict = in.max_strict;
+                } else if (in.max == last.max) {
+                    last.max_strict = last.max_strict && in.max_strict;
+                }
+                return;
+            }
+        }
+        out.push_back(in);
+    }
+    explicit IntervalSet(list_t list) {
+        if (!list.empty())
+            m_Intervals = std::make_shared<const list_t>(std::move(list));
+    }
+
+   public:
+    IntervalSet() = default;
+    explicit IntervalSet(const Interval& in) {
+        list_t list;
+        m_Append(list, in);
+        *this = IntervalSet(std::move(list));
+    }
+    const list_t& intervals() const {
+        return m_Intervals != nullptr ? *m_Intervals : m_Empty();
+    }
+    bool empty() const { return m_Intervals == nullptr; }
+    static IntervalSet unite(const IntervalSet& lhs, const IntervalSet& rhs) {
+        const list_t &a = lhs.intervals(), &b = rhs.intervals();
+        list_t out;
+        out.reserve(a.size() + b.size());
+        auto l = a.begin(), r = b.begin();
+        while (l != a.end() || r != b.end()) {
+            if (r == b.end() || (l != a.end() && m_StartsBefore(*l, *r)))
+                m_Append(out, *l++);
+            else
+                m_Append(out, *r++);
+        }
+        return IntervalSet(std::move(out));
+    }
+    static IntervalSet intersect(const IntervalSet& lhs,
+                                 const IntervalSet& rhs) {
+        const list_t &a = lhs.intervals(), &b = rhs.intervals();
+        list_t out;
+        auto l = a.begin(), r = b.begin();
+        while (l != a.end() && r != b.end()) {
+            Interval in = *l;
+            if (r->min > in.min || (r->min == in.min && r->min_strict)) {
+                in.min = r->min;
+                in.min_strict = r->min_strict;
+            }
+            if (r->max < in.max || (r->max == in.max && r->max_strict)) {
+                in.max = r->max;
+                in.max_strict = r->max_strict;
+            }
+            if (!in.empty()) out.push_back(in);
+            // the one that ends first can't meet anything else
+            if (l->max < r->max || (l->max == r->max && l->max_strict))
+                ++l;
+            else
+                ++r;
+        }
+        return IntervalSet(std::move(out));
+    }
+    bool contains(long double x) const {
+        const list_t& list = intervals();
+        // the only interval that can contain `x` is the last one that starts
+        // at or before it
+        auto it = std::upper_bound(
+            list.begin(), list.end(), x,
+            [](long double v, const Interval& in) { return v < in.min; });
+        return it != list.begin() && std::prev(it)->contains(x);
+    }
+    // out[i] = contains(xs[i]), sorted points are answered in a single
+    // pass over the intervals
+    void contains(const long double* xs, std::size_t n, bool* out) const {
+        if (!std::is_sorted(xs, xs + n)) {
+            for (std::size_t i = 0; i < n; ++i) out[i] = contains(xs[i]);
+            return;
+        }
+        const list_t& list = intervals();
+        auto at = list.begin();
+        for (std::size_t i = 0; i < n; ++i) {
+            while (at != list.end() && at->max < xs[i]) ++at;
+            out[i] = at != list.end() && at->contains(xs[i]);
+        }
+    }
+    bool operator==(const IntervalSet& oth) const {
+        return std::equal(intervals().begin(), intervals().end(),
+                          oth.intervals().begin(), oth.intervals().end(),
+                          [](const Interval& a, const Interval& b) {
+                              return a.min == b.min && a.max == b.max &&
+                                     a.min_strict == b.min_strict &&
+                                     a.max_strict == b.max_strict;
+                          });
+    }
+};
+}  // namespace ami
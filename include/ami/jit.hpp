@@ -0,0 +1,629 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "exact.hpp"
+#include "scope.hpp"
+#include "types.hpp"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define AMI_JIT_X86_64 1
+#endif
+
+// optional jit for user functions that only compute numbers. a body made of
+// numbers, booleans, the parameters, builtin constants, arithmetic,
+// comparisons, logical operators, `if`/`else`, `|x|`, `!`, pure builtins and
+// calls to user functions is compiled to x86-64 machine code in mmap'd pages
+// the first time the function is called. the code works on x87 registers so
+// every value keeps the long double precision the Interpreter computes with.
+// the frame of a call is an array of 16 bytes slots on the native stack, the
+// value of each subexpression is stored in the slot of its depth.
+// a call that can't run natively (an argument that isn't a number, a
+// function that uses sets, vectors or globals...) is evaluated by the
+// Interpreter as before, compiled functions call themselves directly
+
+namespace ami {
+namespace jit {
+// off by default, set it to run numeric user functions as machine code
+inline bool enabled = false;
+struct Call {
+    symbol_t id;
+    std::uint32_t args_count;
+};
+class Code {
+    void* m_Memory = nullptr;
+    std::size_t m_Size = 0;
+
+   public:
+    // writes the value of the call to `out` and returns 0, otherwise the call
+    // has to be evaluated by the Interpreter: 2 when the recursion got too
+    // deep, 1 for anything else
+    using entry_t = int (*)(const long double* args, long double* out);
+    entry_t entry = nullptr;
+    std::vector<symbol_t> params;
+    std::vector<symbol_t> free;  // builtin constants read by the body
+    // read by the machine code through their address, a deque never moves
+    // its elements
+    std::deque<long double> numbers;
+    std::deque<Call> calls;
+    Code() = default;
+    Code(const Code&) = delete;
+    Code& operator=(const Code&) = delete;
+    // copies `bytes` to executable memory
+    bool load(const std::vector<std::uint8_t>& bytes) {
+#ifdef AMI_JIT_X86_64
+        std::size_t size = bytes.size();
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return false;
+        std::memcpy(memory, bytes.data(), size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return false;
+        }
+        m_Memory = memory;
+        m_Size = size;
+        entry = reinterpret_cast<entry_t>(memory);
+        return true;
+#else
+        return false;
+#endif
+    }
+    ~Code() {
+#ifdef AMI_JIT_X86_64
+        if (m_Memory != nullptr) munmap(m_Memory, m_Size);
+#endif
+    }
+};
+const Code* code(Function& f);
+namespace details {
+// depth of the native calls, deeper recursion is left to the Interpreter
+// which reports it
+inline std::size_t depth = 0;
+constexpr std::size_t max_depth = 3'000;
+struct Context {
+    // argument frames of the Interpreter that made the outermost call
+    const scope::CallStack* frames = nullptr;
+    std::vector<const Code*> active;
+};
+inline Context& context() {
+    static Context ctx;
+    return ctx;
+}
+// identifiers aren't lexically scoped, a constant read by `code` resolves
+// to an argument of any function still running when one has its name
+inline bool shadowed(const Code& code) {
+    const Context& ctx = context();
+    auto binds = [](const std::vector<symbol_t>& ids, symbol_t id) {
+        return std::find(ids.begin(), ids.end(), id) != ids.end();
+    };
+    for (symbol_t id : code.free) {
+        for (const Code* c : ctx.active)
+            if (binds(c->params, id)) return true;
+        if (ctx.frames != nullptr && ctx.frames->binds(id)) return true;
+    }
+    return false;
+}
+// called by the machine code, none of them may throw through it. integers
+// a long double may have rounded and fractions it can't hold are left to the
+// Interpreter, see exact::inexact
+inline int power(long double* lhs, const long double* rhs) noexcept {
+    long double out = std::pow(*lhs, *rhs);
+    if (exact::inexact_power(*lhs, *rhs, out)) return 1;
+    *lhs = out;
+    return 0;
+}
+// `out` is the sum, difference or product of `lhs` and `rhs`, past
+// exact::limit
+inline int checked(long double* lhs, const long double* rhs,
+                   const long double* out) noexcept {
+    if (exact::inexact(*lhs, *rhs, *out)) return 1;
+    *lhs = *out;
+    return 0;
+}
+inline int modulo(long double* lhs, const long double* rhs) noexcept {
+    *lhs = std::fmod(*lhs, *rhs);
+    return 0;
+}
+inline int factorial(long double* value) noexcept {
+    // 20! is the last one a long double holds exactly
+    if (exact::integral(*value) && *value > 20) return 1;
+    long double out = 1;
+    if (std::isfinite(*value) && (*value <= 1e7)) {
+        for (long double k = 1; k <= *value; ++k) out *= k;
+    } else {
+        out = INFINITY;
+    }
+    *value = out;
+    return 0;
+}
+// the value is written over the first argument
+inline int call_builtin(const builtins::details::FunctionHandler* handler,
+                        long double* args) noexcept {
+    try {
+        arg_t values;
+        values.reserve(handler->args_count);
+        for (std::size_t i = 0; i < handler->args_count; ++i)
+            values.push_back(Number(args[i]));
+        val_t out = handler->callback(values);
+        auto* num = std::get_if<Number>(&out);
+        if (num == nullptr) return 1;
+        args[0] = num->val;
+        return 0;
+    } catch (...) {
+        return 1;
+    }
+}
+inline int call_user(const Call* call, const long double* args,
+                     long double* out) noexcept {
+    try {
+        Function* f = scope::lookup(scope::userdefined_functions, call->id);
+        if (f == nullptr || f->arguments.size() != call->args_count) return 1;
+        const Code* callee = jit::code(*f);
+        if (callee == nullptr || shadowed(*callee)) return 1;
+        auto& active = context().active;
+        active.push_back(callee);
+        int status = callee->entry(args, out);
+        active.pop_back();
+        return status;
+    } catch (...) {
+        return 1;
+    }
+}
+#ifdef AMI_JIT_X86_64
+class Assembler {
+    std::vector<std::uint8_t> m_Bytes;
+
+   public:
+    std::size_t size() const { return m_Bytes.size(); }
+    std::vector<std::uint8_t> take() { return std::move(m_Bytes); }
+    void emit(std::initializer_list<std::uint8_t> bytes) {
+        m_Bytes.insert(m_Bytes.end(), bytes);
+    }
+    void u32(std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) m_Bytes.push_back((v >> (8 * i)) & 0xFF);
+    }
+    void u64(std::uint64_t v) {
+        for (int i = 0; i < 8; ++i) m_Bytes.push_back((v >> (8 * i)) & 0xFF);
+    }
+    void patch(std::size_t at, std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) m_Bytes[at + i] = (v >> (8 * i)) & 0xFF;
+    }
+    // points the rel32 at `at` to `target`
+    void link(std::size_t at, std::size_t target) {
+        patch(at, static_cast<std::uint32_t>(target - (at + 4)));
+    }
+    // mov rax, imm64
+    void mov_rax(const void* p) {
+        emit({0x48, 0xB8});
+        u64(reinterpret_cast<std::uintptr_t>(p));
+    }
+    // mov rdi, imm64
+    void mov_rdi(const void* p) {
+        emit({0x48, 0xBF});
+        u64(reinterpret_cast<std::uintptr_t>(p));
+    }
+    // fld tword [rsp + off]
+    void fld_slot(std::uint32_t off) {
+        emit({0xDB, 0xAC, 0x24});
+        u32(off);
+    }
+    // fstp tword [rsp + off]
+    void fstp_slot(std::uint32_t off) {
+        emit({0xDB, 0xBC, 0x24});
+        u32(off);
+    }
+    // fld tword [rbx + off], rbx holds the arguments
+    void fld_arg(std::uint32_t off) {
+        emit({0xDB, 0xAB});
+        u32(off);
+    }
+    // fld tword [p]
+    void fld_abs(const void* p) {
+        mov_rax(p);
+        emit({0xDB, 0x28});
+    }
+    // lea rdi/rsi, [rsp + off]
+    void lea_rdi(std::uint32_t off) {
+        emit({0x48, 0x8D, 0xBC, 0x24});
+        u32(off);
+    }
+    void lea_rsi(std::uint32_t off) {
+        emit({0x48, 0x8D, 0xB4, 0x24});
+        u32(off);
+    }
+    // mov rax, f; call rax
+    template <class F>
+    void call_abs(F* f) {
+        mov_rax(reinterpret_cast<const void*>(f));
+        emit({0xFF, 0xD0});
+    }
+    // fucomip st0, st1; fstp st0
+    void compare() { emit({0xDF, 0xE9, 0xDD, 0xD8}); }
+    // jump with a rel32 to link later, returns where the rel32 is
+    std::size_t jump(std::initializer_list<std::uint8_t> opcode) {
+        emit(opcode);
+        u32(0);
+        return size() - 4;
+    }
+};
+enum class Type { Number, Boolean };
+class Compiler {
+    Code& m_Code;
+    symbol_t m_Self;
+    Assembler m_Asm;
+    std::uint32_t m_Slots = 0;
+    std::vector<std::size_t> m_Bails;  // jumps to the epilogue with a status
+    // [rsp] is scratch space, slot k is at [rsp + 16 * (k + 1)]
+    std::uint32_t m_Slot(std::uint32_t k) {
+        m_Slots = std::max(m_Slots, k + 1);
+        return 16 * (k + 1);
+    }
+    void m_Load(const void* p, std::uint32_t d) {
+        m_Asm.fld_abs(p);
+        m_Asm.fstp_slot(m_Slot(d));
+    }
+    // test eax, eax; jnz epilogue, the status is passed on to the caller
+    void m_BailOnError() {
+        m_Asm.emit({0x85, 0xC0});
+        m_Bails.push_back(m_Asm.jump({0x0F, 0x85}));
+    }
+    // al = slot d is truthy, any value but 0 (nan included)
+    void m_Truth(std::uint32_t d) {
+        m_Asm.emit({0xD9, 0xEE});  // fldz
+        m_Asm.fld_slot(m_Slot(d));
+        m_Asm.compare();
+        m_Asm.emit({0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1});  // setne al; setp cl
+        m_Asm.emit({0x08, 0xC8});                          // or al, cl
+    }
+    // slot d = al as 0 or 1
+    void m_StoreBool(std::uint32_t d) {
+        m_Asm.emit({0x0F, 0xB6, 0xC0});  // movzx eax, al
+        m_Asm.emit({0x89, 0x04, 0x24});  // mov [rsp], eax
+        m_Asm.emit({0xDB, 0x04, 0x24});  // fild dword [rsp]
+        m_Asm.fstp_slot(m_Slot(d));
+    }
+    bool m_Numbers(std::optional<Type> lhs, std::optional<Type> rhs) {
+        return lhs == Type::Number && rhs == Type::Number;
+    }
+    std::optional<Type> m_Emit(const Expr* e, std::uint32_t d) {
+        switch (e->type()) {
+            case AstType::Number:
+                m_Load(&m_Code.numbers.emplace_back(
+                           static_cast<const Number*>(e)->val),
+                       d);
+                return Type::Number;
+            case AstType::Boolean:
+                m_Asm.emit({0xD9, static_cast<const Boolean*>(e)->val
+                                      ? std::uint8_t{0xE8}    // fld1
+                                      : std::uint8_t{0xEE}});  // fldz
+                m_Asm.fstp_slot(m_Slot(d));
+                return Type::Boolean;
+            case AstType::Identifier:
+                return m_Ident(static_cast<const Identifier*>(e)->id, d);
+            case AstType::NegativeExpr:
+                return m_Unary(static_cast<const NegativeExpr*>(e)->value,
+                               {0xD9, 0xE0}, d);  // fchs
+            case AstType::NotExpr:
+                if (!m_Emit(static_cast<const NotExpr*>(e)->value.get(), d))
+                    return std::nullopt;
+                m_Asm.emit({0xD9, 0xEE});  // fldz
+                m_Asm.fld_slot(m_Slot(d));
+                m_Asm.compare();
+                // sete al; setnp cl; and al, cl
+                m_Asm.emit({0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8});
+                m_StoreBool(d);
+                return Type::Boolean;
+            case AstType::BinaryOp:
+                return m_Binary(static_cast<const BinaryOpExpr*>(e), d);
+            case AstType::Comparison:
+                return m_Compare(static_cast<const Comparison*>(e), d);
+            case AstType::LogicalExpr:
+                return m_Logical(static_cast<const LogicalExpr*>(e), d);
+            case AstType::Symbol: {
+                auto* s = static_cast<const SymbolExpr*>(e);
+                if (s->symbol == Symbol::Abs)
+                    return m_Unary(s->value, {0xD9, 0xE1}, d);  // fabs
+                if (s->symbol != Symbol::Factorial ||
+                    m_Emit(s->value.get(), d) != Type::Number)
+                    return std::nullopt;
+                m_Asm.lea_rdi(m_Slot(d));
+                m_Asm.call_abs(&factorial);
+                m_BailOnError();
+                return Type::Number;
+            }
+            case AstType::FunctionCall:
+                return m_Call(static_cast<const FunctionCall*>(e), d);
+            case AstType::IfExpr:
+                return m_If(static_cast<const IfExpr*>(e), d);
+            default:
+                return std::nullopt;
+        }
+    }
+    std::optional<Type> m_Ident(symbol_t id, std::uint32_t d) {
+        const auto& params = m_Code.params;
+        auto it = std::find(params.begin(), params.end(), id);
+        if (it != params.end()) {
+            auto slot = static_cast<std::uint32_t>(it - params.begin());
+            m_Asm.fld_arg(16 * slot);
+            m_Asm.fstp_slot(m_Slot(d));
+            return Type::Number;
+        }
+        // globals can change between calls, only constants are compiled
+        const long double* c = builtins::constant(id);
+        if (c == nullptr) return std::nullopt;
+        if (std::find(m_Code.free.begin(), m_Code.free.end(), id) ==
+            m_Code.free.end())
+            m_Code.free.push_back(id);
+        m_Load(c, d);
+        return Type::Number;
+    }
+    std::optional<Type> m_Unary(const ptr_t& value,
+                                std::initializer_list<std::uint8_t> op,
+                                std::uint32_t d) {
+        if (m_Emit(value.get(), d) != Type::Number) return std::nullopt;
+        m_Asm.fld_slot(m_Slot(d));
+        m_Asm.emit(op);
+        m_Asm.fstp_slot(m_Slot(d));
+        return Type::Number;
+    }
+    std::optional<Type> m_Binary(const BinaryOpExpr* b, std::uint32_t d) {
+        auto lhs = m_Emit(b->lhs.get(), d);
+        if (!m_Numbers(lhs, m_Emit(b->rhs.get(), d + 1))) return std::nullopt;
+        if (b->op == Op::Pow || b->op == Op::Mod) {
+            m_Asm.lea_rdi(m_Slot(d));
+            m_Asm.lea_rsi(m_Slot(d + 1));
+            if (b->op == Op::Pow) {
+                m_Asm.call_abs(&power);
+                m_BailOnError();
+            } else {
+                m_Asm.call_abs(&modulo);
+            }
+            return Type::Number;
+        }
+        // st1 = lhs, st0 = rhs, the result is left in st1 and st0 popped
+        std::uint8_t op;
+        switch (b->op) {
+            case Op::Plus:
+                op = 0xC1;  // faddp
+                break;
+            case Op::Minus:
+                op = 0xE9;  // fsubp
+                break;
+            case Op::Mult:
+                op = 0xC9;  // fmulp
+                break;
+            case Op::Div:
+                op = 0xF9;  // fdivp
+                break;
+            default:
+                return std::nullopt;
+        }
+        m_Asm.fld_slot(m_Slot(d));
+        m_Asm.fld_slot(m_Slot(d + 1));
+        m_Asm.emit({0xDE, op});
+        if (b->op == Op::Div) {
+            m_Asm.fstp_slot(m_Slot(d));
+            return Type::Number;
+        }
+        // below exact::limit the value is exact, otherwise `checked` tells
+        // whether it's an integer the Interpreter has to compute
+        m_Asm.emit({0xD9, 0xC0, 0xD9, 0xE1});  // fld st0; fabs
+        m_Asm.fld_abs(&exact::limit);
+        m_Asm.compare();
+        std::size_t exact = m_Asm.jump({0x0F, 0x87});  // ja
+        m_Asm.fstp_slot(m_Slot(d + 2));
+        m_Asm.lea_rdi(m_Slot(d));
+        m_Asm.lea_rsi(m_Slot(d + 1));
+        m_Asm.emit({0x48, 0x8D, 0x94, 0x24});  // lea rdx, [rsp + off]
+        m_Asm.u32(m_Slot(d + 2));
+        m_Asm.call_abs(&checked);
+        m_BailOnError();
+        std::size_t done = m_Asm.jump({0xE9});  // jmp
+        m_Asm.link(exact, m_Asm.size());
+        m_Asm.fstp_slot(m_Slot(d));
+        m_Asm.link(done, m_Asm.size());
+        return Type::Number;
+    }
+    std::optional<Type> m_Compare(const Comparison* c, std::uint32_t d) {
+        if (!m_Emit(c->lhs.get(), d) || !m_Emit(c->rhs.get(), d + 1))
+            return std::nullopt;
+        // fucomip compares st0 to st1, `<` and `<=` are done as `>` and `>=`
+        // with the operands swapped so nan compares false like in C++
+        bool swap = c->op == Op::Less || c->op == Op::LessOrEqual;
+        m_Asm.fld_slot(m_Slot(swap ? d : d + 1));
+        m_Asm.fld_slot(m_Slot(swap ? d + 1 : d));
+        m_Asm.compare();
+        switch (c->op) {
+            case Op::Greater:
+            case Op::Less:
+                m_Asm.emit({0x0F, 0x97, 0xC0});  // seta al
+                break;
+            case Op::GreaterOrEqual:
+            case Op::LessOrEqual:
+                m_Asm.emit({0x0F, 0x93, 0xC0});  // setae al
+                break;
+            case Op::Equals:
+                // sete al; setnp cl; and al, cl
+                m_Asm.emit({0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8});
+                break;
+            case Op::NotEquals:
+                // setne al; setp cl; or al, cl
+                m_Asm.emit({0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8});
+                break;
+            default:
+                return std::nullopt;
+        }
+        m_StoreBool(d);
+        return Type::Boolean;
+    }
+    std::optional<Type> m_Logical(const LogicalExpr* l, std::uint32_t d) {
+        if (l->op != Op::LogicalAnd && l->op != Op::LogicalOr)
+            return std::nullopt;
+        // both operands are evaluated, like in the Interpreter
+        if (!m_Emit(l->lhs.get(), d) || !m_Emit(l->rhs.get(), d + 1))
+            return std::nullopt;
+        m_Truth(d);
+        m_Asm.emit({0x88, 0xC2});  // mov dl, al
+        m_Truth(d + 1);
+        if (l->op == Op::LogicalAnd)
+            m_Asm.emit({0x20, 0xD0});  // and al, dl
+        else
+            m_Asm.emit({0x08, 0xD0});  // or al, dl
+        m_StoreBool(d);
+        return Type::Boolean;
+    }
+    std::optional<Type> m_Call(const FunctionCall* fc, std::uint32_t d) {
+        const auto* handler = builtins::function(fc->id);
+        if (handler != nullptr &&
+            (!handler->pure || handler->args_count != fc->arguments.size()))
+            return std::nullopt;
+        // compiled functions only take numbers
+        for (std::size_t i = 0; i < fc->arguments.size(); ++i)
+            if (m_Emit(fc->arguments[i].get(), d + i) != Type::Number)
+                return std::nullopt;
+        std::uint32_t args = m_Slot(d);
+        if (handler != nullptr) {
+            m_Asm.mov_rdi(handler);
+            m_Asm.lea_rsi(args);
+            m_Asm.call_abs(&call_builtin);
+        } else if (fc->id == m_Self) {
+            // the arguments become the callee's and the value is written
+            // over them, it's only stored once they've all been read
+            m_Asm.lea_rdi(args);
+            m_Asm.lea_rsi(args);
+            std::size_t at = m_Asm.jump({0xE8});  // call rel32
+            m_Asm.link(at, 0);
+        } else {
+            const Call& call = m_Code.calls.emplace_back(Call{
+                fc->id, static_cast<std::uint32_t>(fc->arguments.size())});
+            m_Asm.mov_rdi(&call);
+            m_Asm.lea_rsi(args);
+            m_Asm.emit({0x48, 0x89, 0xF2});  // mov rdx, rsi
+            m_Asm.call_abs(&call_user);
+        }
+        m_BailOnError();
+        return Type::Number;
+    }
+    std::optional<Type> m_If(const IfExpr* iexpr, std::uint32_t d) {
+        // without an else part the value can be null
+        if (iexpr->elsestmt == nullptr || !m_Emit(iexpr->cond.get(), d))
+            return std::nullopt;
+        m_Truth(d);
+        m_Asm.emit({0x84, 0xC0});  // test al, al
+        std::size_t branch = m_Asm.jump({0x0F, 0x84});  // jz
+        auto body = m_Emit(iexpr->body.get(), d);
+        std::size_t skip = m_Asm.jump({0xE9});  // jmp
+        m_Asm.link(branch, m_Asm.size());
+        auto other = m_Emit(iexpr->elsestmt.get(), d);
+        m_Asm.link(skip, m_Asm.size());
+        if (!body || body != other) return std::nullopt;
+        return body;
+    }
+
+   public:
+    Compiler(Code& code, symbol_t self) : m_Code(code), m_Self(self) {}
+    std::optional<std::vector<std::uint8_t>> build(const Expr* body) {
+        // push rbp; mov rbp, rsp; push rbx; push r12
+        m_Asm.emit({0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54});
+        // mov rbx, rdi; mov r12, rsi
+        m_Asm.emit({0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4});
+        m_Asm.emit({0x48, 0x81, 0xEC});  // sub rsp, frame size
+        std::size_t frame = m_Asm.size();
+        m_Asm.u32(0);
+        m_Asm.mov_rax(&depth);
+        m_Asm.emit({0x48, 0x83, 0x00, 0x01});  // add qword [rax], 1
+        m_Asm.emit({0x48, 0x81, 0x38});        // cmp qword [rax], max_depth
+        m_Asm.u32(static_cast<std::uint32_t>(max_depth));
+        std::size_t too_deep = m_Asm.jump({0x0F, 0x87});  // ja
+        if (m_Emit(body, 0) != Type::Number) return std::nullopt;
+        m_Asm.fld_slot(m_Slot(0));
+        m_Asm.emit({0x41, 0xDB, 0x3C, 0x24});  // fstp tword [r12]
+        m_Asm.emit({0x31, 0xC0, 0xEB, 0x05});  // xor eax, eax; jmp done
+        m_Asm.link(too_deep, m_Asm.size());
+        m_Asm.emit({0xB8, 0x02, 0x00, 0x00, 0x00});  // mov eax, 2
+        for (std::size_t at : m_Bails) m_Asm.link(at, m_Asm.size());
+        // done: mov rcx, &depth; sub qword [rcx], 1
+        m_Asm.emit({0x48, 0xB9});
+        m_Asm.u64(reinterpret_cast<std::uintptr_t>(&depth));
+        m_Asm.emit({0x48, 0x83, 0x29, 0x01});
+        // lea rsp, [rbp - 16]; pop r12; pop rbx; pop rbp; ret
+        m_Asm.emit({0x48, 0x8D, 0x65, 0xF0, 0x41, 0x5C, 0x5B, 0x5D, 0xC3});
+        // the slots and the scratch space, a multiple of 16 keeps the stack
+        // aligned for the calls
+        m_Asm.patch(frame, 16 * (m_Slots + 1));
+        return m_Asm.take();
+    }
+};
+#endif
+inline std::shared_ptr<const Code> compile(const Function& f) {
+#ifdef AMI_JIT_X86_64
+    auto out = std::make_shared<Code>();
+    for (auto& arg : f.arguments)
+        out->params.push_back(static_cast<const Identifier*>(arg.get())->id);
+    auto bytes = Compiler(*out, f.id).build(f.body.get());
+    if (!bytes || !out->load(*bytes)) return nullptr;
+    return out;
+#else
+    return nullptr;
+#endif
+}
+}  // namespace details
+// the machine code of `f`'s body, compiled on the first call. null when the
+// body can't be compiled
+inline const Code* code(Function& f) {
+    if (!f.native_compiled) {
+        f.native_compiled = true;
+        f.native = details::compile(f);
+    }
+    return f.native.get();
+}
+// runs `f` natively with the `count` evaluated `args` of a call, nothing
+// when the jit is disabled or the call has to be evaluated by the
+// Interpreter. `frames` are the argument frames of the calls the Interpreter
+// is in.
+// `too_deep` is set when the native recursion hit its limit, the caller has
+// to stop using the jit for the rest of the evaluation so the Interpreter's
+// own limit decides whether the recursion is an error
+inline std::optional<long double> call(Function& f, const val_t* args,
+                                       std::size_t count,
+                                       const scope::CallStack& frames,
+                                       bool& too_deep) {
+    if (!enabled) return std::nullopt;
+    std::vector<long double> values;
+    values.reserve(count);
+    for (const val_t* arg = args; arg != args + count; ++arg) {
+        auto* num = std::get_if<Number>(arg);
+        if (num == nullptr) return std::nullopt;
+        values.push_back(num->val);
+    }
+    const Code* native = code(f);
+    if (native == nullptr) return std::nullopt;
+    auto& ctx = details::context();
+    const auto* outer = std::exchange(ctx.frames, &frames);
+    std::optional<long double> out;
+    if (!details::shadowed(*native)) {
+        ctx.active.push_back(native);
+        long double value;
+        int status = native->entry(values.data(), &value);
+        if (status == 0) out = value;
+        too_deep = status == 2;
+        ctx.active.pop_back();
+    }
+    ctx.frames = outer;
+    return out;
+}
+}  // namespace jit
+}  // namespace ami
@@ -1,10 +1,15 @@
 #pragma once
 #include <algorithm>
-#include <iostream>
-#include <map>
+#include <deque>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "scan.hpp"
+#include "symbols.hpp"
+#include "tables.hpp"
+
 namespace ami {
 enum class Tokens {
     Digit,
@@ -59,269 +64,343 @@ enum class Tokens {
     NormBegin,  // ||x||
     NormEnd,
     AbsBegin,  // |x|
-    AbsEnd
+    AbsEnd,
+    Newline  // end of a statement, only emitted by TokenStream, keep it last
 };
+// tokens don't own their text, they only point back into the lexed source
+// by offset and length, use `text` to get the lexeme
 struct TokenHandler {
-    std::string value;
     Tokens token;
+    symbol_t sym = 0;  // interned name of an `Identifier` token
     std::size_t pos;
+    std::size_t len;
+    long double num = 0;  // value of a `Digit` token
+    std::string_view text(std::string_view src) const {
+        return src.substr(pos, len);
+    }
     template <class... Args>
-    bool is(Args&&... args) {
+    bool is(Args&&... args) const {
         for (auto& e : {(args)...})
             if (e == this->token) return true;
         return false;
     }
     template <class... Args>
-    bool isNot(Args&&... args) {
+    bool isNot(Args&&... args) const {
         for (auto& e : {(args)...})
             if (e != this->token) return true;
         return false;
     }
 };
+namespace details {
+inline constexpr std::size_t tokens_count =
+    static_cast<std::size_t>(Tokens::Newline) + 1;
+struct KeywordHash {
+    constexpr std::size_t operator()(std::string_view s) const {
+        return s.size() + s.front() + 7 * s.back();
+    }
+};
+// one hash and one compare per identifier
+inline constexpr tables::PerfectHash<Tokens, 32, KeywordHash> keywords{
+    {{"if", Tokens::KeywordIf},
+     {"else", Tokens::KeywordElse},
+     {"true", Tokens::Boolean},
+     {"false", Tokens::Boolean},
+     {"and", Tokens::KeywordAnd},
+     {"or", Tokens::KeywordOr},
+     {"not", Tokens::KeywordNot},
+     {"in", Tokens::KeywordIn},
+     {"null", Tokens::KeywordNull},
+     {"return", Tokens::KeywordReturn},
+     {"union", Tokens::KeywordUnion},
+     {"superset", Tokens::KeywordSuperset},
+     {"subset", Tokens::KeywordSubset},
+     {"intersection", Tokens::KeywordIntersection}},
+    Tokens::Identifier};
+}  // namespace details
 // lexer
 class Lexer {
     std::vector<TokenHandler> m_Tokens;
     std::size_t m_Pos = 0;
     bool is_abs{}, is_norm{};
-    std::string m_Src;
+    std::string_view m_Src;  // borrowed, must outlive the lexer
     bool m_IsDigit(char c) { return (c >= '0' && c <= '9'); }
     bool not_eof() { return m_Pos < m_Src.size(); }
     bool m_AtEnd() { return (m_Pos == (m_Src.size() - 1)); }
     bool m_IsAlpha(char c) {
         return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
     }
+    // indices are clamped so there's no need for a bounds checked `at`
     char m_Get() {
-        return m_Src.at((m_Pos >= m_Src.size()) ? (m_Src.size() - 1) : m_Pos);
+        return m_Src[(m_Pos >= m_Src.size()) ? (m_Src.size() - 1) : m_Pos];
     }
     char m_Peek(std::size_t x = 1) {
-        return m_Src.at((m_Pos + x) >= m_Src.size() ? (m_Src.size() - 1)
-                                                    : (m_Pos + x));
+        return m_Src[(m_Pos + x) >= m_Src.size() ? (m_Src.size() - 1)
+                                                 : (m_Pos + x)];
     }
     char m_Prev(std::size_t x = 1) {
-        return m_Src.at((m_Pos) == 0 ? 0 : m_Pos - x);
+        return m_Src[(m_Pos) == 0 ? 0 : m_Pos - x];
     }
-    Tokens m_GetKeyword(const std::string& ident) {
-        // if (condition) stmt1 else stmt2
-        if (ident == "if") {
-            return Tokens::KeywordIf;
-        } else if (ident == "else") {
-            return Tokens::KeywordElse;
-        } else if (ident == "true" || ident == "false") {
-            return Tokens::Boolean;
-        } else if (ident == "and") {
-            return Tokens::KeywordAnd;
-        } else if (ident == "or") {
-            return Tokens::KeywordOr;
-        } else if (ident == "not") {
-            return Tokens::KeywordNot;
-        } else if (ident == "in") {
-            return Tokens::KeywordIn;
-        } else if (ident == "null") {
-            return Tokens::KeywordNull;
-        } else if (ident == "return") {
-            return Tokens::KeywordReturn;
-        } else if (ident == "union") {
-            return Tokens::KeywordUnion;
-        } else if (ident == "superset") {
-            return Tokens::KeywordSuperset;
-        } else if (ident == "subset") {
-            return Tokens::KeywordSubset;
-        } else if (ident == "intersection") {
-            return Tokens::KeywordIntersection;
-        } else {
-            return Tokens::Identifier;
-        }
+    // moves m_Pos on the last character of the run starting at m_Pos that
+    // `skip` stops after and returns the length of that run
+    template <class Skip>
+    std::size_t m_SkipRun(Skip skip) {
+        std::size_t start = m_Pos;
+        const char* end = m_Src.data() + m_Src.size();
+        m_Pos = skip(m_Src.data() + m_Pos, end) - m_Src.data();
+        m_Advance(-1);
+        return m_Pos + 1 - start;
+    }
+    Tokens m_GetKeyword(std::string_view ident) {
+        return details::keywords.find(ident);
     }
     void m_Advance(std::size_t x = 1) { m_Pos += x; }
-    void m_AddTok(Tokens tok, const std::string& val) {
+    // m_Pos is on the last character of the token when it gets added
+    void m_AddTok(Tokens tok, std::size_t len = 1) {
         m_Tokens.push_back(
-            TokenHandler{.value = val, .token = tok, .pos = m_Pos});
+            TokenHandler{.token = tok, .pos = m_Pos + 1 - len, .len = len});
     }
-    std::string m_GetIdent() {
-        std::string out{};
-        while (not_eof() && (m_IsAlpha(m_Get()) || m_IsDigit(m_Get()))) {
-            out += m_Get();
-            m_Advance();
-        }
-        m_Advance(-1);
-        return out;
+    std::size_t m_GetIdent() { return m_SkipRun(scan::skip_ident); }
+    // the whole literal (1'000.5e-3) becomes one token holding its value
+    void m_AddNumber() {
+        long double value = 0;
+        const char* begin = m_Src.data() + m_Pos;
+        const char* end =
+            scan::scan_number(begin, m_Src.data() + m_Src.size(), value);
+        m_Advance(end - begin - 1);
+        m_AddTok(Tokens::Digit, end - begin);
+        m_Tokens.back().num = value;
     }
-    std::string m_GetDigit() {
-        std::string temp{};
-        while (not_eof() && m_IsDigit(m_Get())) {
-            temp += m_Get();
-            m_Advance();
-        }
-        m_Advance(-1);
-        return temp;
+    void m_AddIdent() {
+        std::size_t len = m_GetIdent();
+        std::string_view word = m_Src.substr(m_Pos + 1 - len, len);
+        Tokens tok = m_GetKeyword(word);
+        m_AddTok(tok, len);
+        if (tok == Tokens::Identifier)
+            m_Tokens.back().sym = symbols::intern(word);
     }
 
    public:
-    explicit Lexer(const std::string& text) : m_Src(text) {}
+    // the lexer borrows `text`, tokens refer to it by offset so it has to
+    // stay alive for as long as the tokens are used
+    explicit Lexer(std::string_view text) : m_Src(text) {}
     std::vector<TokenHandler> lex() {
         while (m_Pos < m_Src.size()) {
-            switch (m_Src.at(m_Pos)) {
+            switch (m_Src[m_Pos]) {
                 default:
                     if (m_IsDigit(m_Get())) {
-                        m_AddTok(Tokens::Digit, m_GetDigit());
+                        m_AddNumber();
                     } else if (m_IsAlpha(m_Get())) {
-                        std::string ident = m_GetIdent();
-                        m_AddTok(m_GetKeyword(ident), ident);
-                    } else if (!std::isspace(m_Get())) {
-                        m_AddTok(Tokens::Unkown, std::string{m_Get()});
+                        m_AddIdent();
+                    } else if (std::isspace(m_Get())) {
+                        m_SkipRun(scan::skip_space);
+                    } else {
+                        m_AddTok(Tokens::Unkown);
                     }
                     break;
                 case '*':
                     if (m_Peek() == '=') {
                         m_Advance();
-                        m_AddTok(Tokens::MultAssign, "*=");
+                        m_AddTok(Tokens::MultAssign, 2);
                     } else {
-                        m_AddTok(Tokens::Mult, "*");
+                        m_AddTok(Tokens::Mult);
                     }
                     break;
                 case '+':
                     if (m_Peek() == '=') {
                         m_Advance();
-                        m_AddTok(Tokens::PlusAssign, "+=");
+                        m_AddTok(Tokens::PlusAssign, 2);
                     } else {
-                        m_AddTok(Tokens::Plus, "+");
+                        m_AddTok(Tokens::Plus);
                     }
                     break;
                 case '-':
                     if (m_Peek() == '>') {
                         m_Advance();
-                        m_AddTok(Tokens::FunctionDef, "->");
+                        m_AddTok(Tokens::FunctionDef, 2);
                     } else if (m_Peek() == '=') {
                         m_Advance();
-                        m_AddTok(Tokens::MinusAssign, "-=");
+                        m_AddTok(Tokens::MinusAssign, 2);
 
                     } else {
-                        m_AddTok(Tokens::Minus, "-");
+                        m_AddTok(Tokens::Minus);
                     }
                     break;
                 case '/':
                     if (m_Peek() == '=') {
                         m_Advance();
-                        m_AddTok(Tokens::DivAssign, "/=");
+                        m_AddTok(Tokens::DivAssign, 2);
                     } else {
-                        m_AddTok(Tokens::Div, "/");
+                        m_AddTok(Tokens::Div);
                     }
                     break;
                 case '(':
-                    m_AddTok(Tokens::Lparen, "(");
+                    m_AddTok(Tokens::Lparen);
                     break;
                 case ')':
-                    m_AddTok(Tokens::Rparen, ")");
+                    m_AddTok(Tokens::Rparen);
                     break;
                 case '^':
                     if (m_Peek() == '=') {
                         m_Advance();
-                        m_AddTok(Tokens::PowAssign, "^=");
+                        m_AddTok(Tokens::PowAssign, 2);
                     } else {
-                        m_AddTok(Tokens::Pow, "^");
+                        m_AddTok(Tokens::Pow);
                     }
                     break;
                 case '%':
                     if (m_Peek() == '=') {
                         m_Advance();
-                        m_AddTok(Tokens::ModAssign, "%=");
+                        m_AddTok(Tokens::ModAssign, 2);
                     } else {
-                        m_AddTok(Tokens::Mod, "%");
+                        m_AddTok(Tokens::Mod);
                     }
                     break;
                 case ',':
                     // for function args
-                    m_AddTok(Tokens::Comma, ",");
+                    m_AddTok(Tokens::Comma);
                     break;
                 case '.':
                     if (m_Peek() == '.' && not_eof()) {
                         m_Advance();
-                        m_AddTok(Tokens::Range, "..");
+                        m_AddTok(Tokens::Range, 2);
                     } else {
-                        m_AddTok(Tokens::Dot, ".");
+                        m_AddTok(Tokens::Dot);
                     }
                     break;
                 case '\'':
-                    // delim for number to improve readability like :
-                    // 1'000'000'000
-                    m_AddTok(Tokens::Delim, "'");
+                    // delims inside numbers (1'000'000) are part of the
+                    // number token, this one is on its own
+                    m_AddTok(Tokens::Delim);
                     break;
                 case 'e':
                     if (m_IsAlpha(m_Peek()) && not_eof()) {
-                        std::string ident = m_GetIdent();
-                        m_AddTok(m_GetKeyword(ident), ident);
+                        m_AddIdent();
                     } else if (m_IsDigit(m_Prev())) {
-                        m_AddTok(Tokens::Edelim, "e");
+                        m_AddTok(Tokens::Edelim);
                     } else {
-                        m_AddTok(Tokens::Identifier, "e");
+                        m_AddIdent();
                     }
                     break;
                 case '=':
                     if (m_Peek() == '=' && !m_AtEnd()) {
                         m_Advance();
-                        m_AddTok(Tokens::Equals, "==");
+                        m_AddTok(Tokens::Equals, 2);
                     } else {
-                        m_AddTok(Tokens::Assign, "=");
+                        m_AddTok(Tokens::Assign);
                     }
                     break;
                 case '<':
                     if (m_Peek() == '=' && not_eof()) {
                         m_Advance();
-                        m_AddTok(Tokens::LessThanOrEqual, "<=");
+                        m_AddTok(Tokens::LessThanOrEqual, 2);
                     } else {
-                        m_AddTok(Tokens::LessThan, "<");
+                        m_AddTok(Tokens::LessThan);
                     }
                     break;
                 case '>':
                     if (m_Peek() == '=' && not_eof()) {
                         m_Advance();
-                        m_AddTok(Tokens::GreaterThanOrEqual, ">=");
+                        m_AddTok(Tokens::GreaterThanOrEqual, 2);
                     } else {
-                        m_AddTok(Tokens::GreaterThan, ">");
+                        m_AddTok(Tokens::GreaterThan);
                     }
                     break;
                 case '[':
-                    m_AddTok(Tokens::Lcbracket, "[");
+                    m_AddTok(Tokens::Lcbracket);
                     break;
                 case ']':
-                    m_AddTok(Tokens::Rcbracket, "]");
+                    m_AddTok(Tokens::Rcbracket);
                     break;
                 case ';':
-                    m_AddTok(Tokens::Semicolon, ";");
+                    m_AddTok(Tokens::Semicolon);
                     break;
                 case '{':
-                    m_AddTok(Tokens::Lbracket, "{");
+                    m_AddTok(Tokens::Lbracket);
                     break;
                 case '}':
-                    m_AddTok(Tokens::Rbracket, "}");
+                    m_AddTok(Tokens::Rbracket);
                     break;
                 case '!':
                     if (m_Peek() == '=' && !m_AtEnd()) {
                         m_Advance();
-                        m_AddTok(Tokens::NotEquals, "!=");
+                        m_AddTok(Tokens::NotEquals, 2);
                     } else {
-                        m_AddTok(Tokens::Factorial, "!");
+                        m_AddTok(Tokens::Factorial);
                     }
                     break;
                 case '|':
                     if (m_Peek() == '|' && !m_AtEnd()) {
                         m_Advance();
                         m_AddTok(is_norm ? Tokens::NormEnd : Tokens::NormBegin,
-                                 "||");
+                                 2);
                         is_norm = !is_norm;
                     } else {
-                        m_AddTok(is_abs ? Tokens::AbsEnd : Tokens::AbsBegin,
-                                 "|");
+                        m_AddTok(is_abs ? Tokens::AbsEnd : Tokens::AbsBegin);
                         is_abs = !is_abs;
                     }
                     break;
             }
             m_Advance();
         }
-        return m_Tokens;
+        return std::move(m_Tokens);
+    }
+};
+// pull based lexer reading its input from a stream, the input is read in
+// chunks of at most `chunk_size` bytes and lexed one line (statement) at a
+// time so only the tokens of the current statement are kept in memory.
+// each line ends with a `Newline` token, lookahead doesn't cross it
+class TokenStream {
+    std::istream& m_In;
+    std::string m_Chunk;
+    std::string m_Pending;  // read but not lexed yet
+    std::string m_Line;     // source of the tokens in the window
+    std::deque<TokenHandler> m_Window;
+    bool m_ReadChunk() {
+        if (!m_In.good()) return false;
+        // stops at '\n' so reading never blocks waiting for the next line
+        m_In.get(m_Chunk.data(), m_Chunk.size(), '\n');
+        m_Pending.append(m_Chunk.data(), m_In.gcount());
+        if (m_In.fail() && !m_In.eof()) m_In.clear();  // empty line
+        if (m_In.peek() == '\n') {
+            m_In.ignore();
+            m_Pending += '\n';
+        }
+        return true;
+    }
+    bool m_ReadLine() {
+        std::size_t nl;
+        while ((nl = m_Pending.find('\n')) == std::string::npos) {
+            if (!m_ReadChunk()) break;
+        }
+        if (nl == std::string::npos && m_Pending.empty()) return false;
+        m_Line.assign(m_Pending, 0, nl);
+        m_Pending.erase(0, nl == std::string::npos ? nl : nl + 1);
+        for (auto& tok : Lexer(m_Line).lex()) m_Window.push_back(tok);
+        m_Window.push_back(TokenHandler{
+            .token = Tokens::Newline, .pos = m_Line.size(), .len = 0});
+        return true;
+    }
+    bool m_Fill() { return !m_Window.empty() || m_ReadLine(); }
+
+   public:
+    explicit TokenStream(std::istream& in, std::size_t chunk_size = 4096)
+        : m_In(in), m_Chunk(chunk_size + 1, '\0') {}
+    bool eof() { return !m_Fill(); }
+    TokenHandler next() {
+        m_Fill();
+        TokenHandler tok = peek();
+        if (!m_Window.empty()) m_Window.pop_front();
+        return tok;
+    }
+    TokenHandler peek(std::size_t k = 0) {
+        if (!m_Fill())
+            return TokenHandler{.token = Tokens::Newline, .pos = 0, .len = 0};
+        return m_Window.at(std::min(k, m_Window.size() - 1));
     }
+    // source of the tokens currently in the window
+    std::string_view line() const { return m_Line; }
 };
-static std::map<Tokens, std::string_view> tokens_str{
+inline constexpr tables::EnumNames<Tokens, details::tokens_count> tokens_str{{
     {Tokens::Div, "DIV"},
     {Tokens::Mult, "MULT"},
     {Tokens::Plus, "PLUS"},
@@ -368,6 +447,15 @@ static std::map<Tokens, std::string_view> tokens_str{
     {Tokens::Lcbracket,
      "LEFTCUBEBRACKET"},  // lmao idk from where did I get this name
     {Tokens::Rcbracket, "RIGHTCUBEBRACKET"},
-};
+    {Tokens::PowAssign, "POWASSIGN"},
+    {Tokens::ModAssign, "MODASSIGN"},
+    {Tokens::KeywordReturn, "KEYWORDRETURN"},
+    {Tokens::KeywordSubset, "KEYWORDSUBSET"},
+    {Tokens::KeywordSuperset, "KEYWORDSUPERSET"},
+    {Tokens::KeywordIntersection, "KEYWORDINTERSECTION"},
+    {Tokens::Factorial, "FACTORIAL"},
+    {Tokens::Range, "RANGE"},
+    {Tokens::Newline, "NEWLINE"},
+}};
 
 }  // namespace ami
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+
+// kernels over row major dense matrices. the loops only walk contiguous
+// rows in their innermost loop so the compiler can vectorize them, the
+// product and the transpose work on square tiles that fit in the cache so
+// big matrices aren't read from memory once per row
+
+namespace ami {
+namespace matrix {
+// side of the tiles, 3 tiles of long doubles take 48KiB
+inline constexpr std::size_t tile = 32;
+// out[i] = lhs[i] op rhs[i] for the `size` elements
+template <class F>
+void zip(const long double* lhs, const long double* rhs, long double* out,
+         std::size_t size, F&& op) {
+    for (std::size_t i = 0; i < size; ++i) out[i] = op(lhs[i], rhs[i]);
+}
+inline void scale(const long double* in, long double k, long double* out,
+                  std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) out[i] = in[i] * k;
+}
+// `out` (cols x rows) is the transpose of `in` (rows x cols)
+inline void transpose(const long double* in, std::size_t rows,
+                      std::size_t cols, long double* out) {
+    for (std::size_t ii = 0; ii < rows; ii += tile) {
+        std::size_t i_end = std::min(ii + tile, rows);
+        for (std::size_t jj = 0; jj < cols; jj += tile) {
+            std::size_t j_end = std::min(jj + tile, cols);
+            for (std::size_t i = ii; i < i_end; ++i)
+                for (std::size_t j = jj; j < j_end; ++j)
+                    out[j * rows + i] = in[i * cols + j];
+        }
+    }
+}
+// `out` (n x m) = `lhs` (n x k) * `rhs` (k x m). the i-k-j order makes the
+// inner loop scale a row of `rhs` into a row of `out`, both contiguous
+inline void multiply(const long double* lhs, const long double* rhs,
+                     long double* out, std::size_t n, std::size_t k,
+                     std::size_t m) {
+    std::fill(out, out + n * m, 0.0L);
+    for (std::size_t ii = 0; ii < n; ii += tile) {
+        std::size_t i_end = std::min(ii + tile, n);
+        for (std::size_t kk = 0; kk < k; kk += tile) {
+            std::size_t k_end = std::min(kk + tile, k);
+            for (std::size_t jj = 0; jj < m; jj += tile) {
+                std::size_t j_end = std::min(jj + tile, m);
+                for (std::size_t i = ii; i < i_end; ++i) {
+                    long double* out_row = out + i * m;
+                    for (std::size_t p = kk; p < k_end; ++p) {
+                        const long double a = lhs[i * k + p];
+                        const long double* rhs_row = rhs + p * m;
+                        for (std::size_t j = jj; j < j_end; ++j)
+                            out_row[j] += a * rhs_row[j];
+                    }
+                }
+            }
+        }
+    }
+}
+// `out` (n) = `lhs` (n x k) * `vec` (k), a dot product per row
+inline void multiply_vector(const long double* lhs, const long double* vec,
+                            long double* out, std::size_t n, std::size_t k) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const long double* row = lhs + i * k;
+        long double sum = 0;
+        for (std::size_t p = 0; p < k; ++p) sum += row[p] * vec[p];
+        out[i] = sum;
+    }
+}
+// `out` (m) = `vec` (k) * `rhs` (k x m), rows of `rhs` scaled and summed
+inline void vector_multiply(const long double* vec, const long double* rhs,
+                            long double* out, std::size_t k, std::size_t m) {
+    std::fill(out, out + m, 0.0L);
+    for (std::size_t p = 0; p < k; ++p) {
+        const long double a = vec[p];
+        const long double* row = rhs + p * m;
+        for (std::size_t j = 0; j < m; ++j) out[j] += a * row[j];
+    }
+}
+}  // namespace matrix
+}  // namespace ami
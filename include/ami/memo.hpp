@@ -0,0 +1,250 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "scope.hpp"
+#include "symbols.hpp"
+#include "types.hpp"
+
+// values of the calls to pure user functions by their numeric arguments. a
+// function is pure when its body only reads its own arguments and calls
+// pure builtins and pure user functions, so a call with the same arguments
+// always gives the same value. a function the jit compiles runs as machine
+// code instead when the jit is enabled. each function has its own table,
+// the least recently used entries are evicted when a table is full or when
+// all of them take more memory than `capacity`.
+// defining a function clears the tables of the functions that call it, their
+// purity depends on it
+
+namespace ami {
+namespace memo {
+// estimated bytes kept for all the functions, and entries kept for each one
+// of them
+inline std::size_t capacity = 16 << 20;
+inline std::size_t function_capacity = 1 << 12;
+struct Stats {
+    std::size_t hits = 0, misses = 0;
+};
+namespace details {
+using key_t = std::vector<long double>;
+struct KeyHash {
+    std::size_t operator()(const key_t& key) const {
+        std::size_t h = key.size();
+        for (long double v : key)
+            h ^= std::hash<long double>{}(v) + 0x9e3779b9 + (h << 6) +
+                 (h >> 2);
+        return h;
+    }
+};
+// -0 and 0 are the same number but a function can tell them apart
+struct KeyEqual {
+    bool operator()(const key_t& lhs, const key_t& rhs) const {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                          [](long double a, long double b) {
+                              return a == b &&
+                                     std::signbit(a) == std::signbit(b);
+                          });
+    }
+};
+struct Entry {
+    key_t key;
+    val_t value;
+    std::size_t used;  // tick of the last lookup, for the global eviction
+    std::size_t bytes;
+};
+struct Table {
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<key_t, std::list<Entry>::iterator, KeyHash, KeyEqual>
+        index;
+    Stats stats;
+};
+struct State {
+    std::unordered_map<symbol_t, Table> tables;
+    std::unordered_set<symbol_t> excluded;
+    // the user functions each checked function calls, directly or not
+    std::unordered_map<symbol_t, std::unordered_set<symbol_t>> calls;
+    std::size_t bytes = 0, tick = 0;
+};
+inline State& state() {
+    static State s;
+    return s;
+}
+// what an entry takes with its list node, its index node and the heap
+// memory of its key, which is stored in both, and of its value
+inline std::size_t bytes(const key_t& key, const val_t& value) {
+    std::size_t out = sizeof(Entry) + sizeof(key_t) + 6 * sizeof(void*) +
+                      2 * key.size() * sizeof(long double);
+    std::visit(
+        [&](const auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, SetObject> ||
+                          std::is_same_v<T, Point> ||
+                          std::is_same_v<T, Vector> ||
+                          std::is_same_v<T, Matrix>)
+                out += v.numbers.size() * sizeof(long double);
+            else if constexpr (std::is_same_v<T, UnionExpr> ||
+                               std::is_same_v<T, InterSectionExpr>)
+                out += v.intervals.intervals().size() *
+                       sizeof(IntervalSet::Interval);
+            else if constexpr (std::is_same_v<T, Integer>)
+                out += v.value.bits() / 8;
+            else if constexpr (std::is_same_v<T, Fraction>)
+                out += (v.value.num().bits() + v.value.den().bits()) / 8;
+            else if constexpr (std::is_same_v<T, std::string>)
+                out += v.size();
+        },
+        value);
+    return out;
+}
+inline void drop(Table& table) {
+    for (const Entry& entry : table.lru) state().bytes -= entry.bytes;
+    table.lru.clear();
+    table.index.clear();
+}
+inline void evict(Table& table) {
+    state().bytes -= table.lru.back().bytes;
+    table.index.erase(table.lru.back().key);
+    table.lru.pop_back();
+}
+// evicts the least recently used entry of all the tables
+inline void evict_oldest() {
+    Table* oldest = nullptr;
+    for (auto& [id, table] : state().tables) {
+        if (table.lru.empty()) continue;
+        std::size_t used = table.lru.back().used;
+        if (oldest == nullptr || used < oldest->lru.back().used)
+            oldest = &table;
+    }
+    if (oldest != nullptr) evict(*oldest);
+}
+// whether `e` is pure, the user functions it calls are added to `seen`
+inline bool pure(Expr& e, std::unordered_set<symbol_t>& seen) {
+    switch (e.type()) {
+        case AstType::UserDefinedIdentifier:
+        case AstType::OpAndAssign:
+        case AstType::Function:
+            return false;
+        // anything else can be an argument of a caller, see
+        // optimize::resolve_slots
+        case AstType::Identifier:
+            return static_cast<Identifier&>(e).slot != Identifier::no_slot;
+        case AstType::FunctionCall: {
+            auto& fc = static_cast<FunctionCall&>(e);
+            if (const auto* handler = builtins::function(fc.id)) {
+                if (!handler->pure) return false;
+            } else if (seen.insert(fc.id).second) {
+                Function* f =
+                    scope::lookup(scope::userdefined_functions, fc.id);
+                if (f == nullptr || !pure(*f->body, seen)) return false;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    bool out = true;
+    for_each_child(e, [&](std::shared_ptr<Expr>& child) {
+        out = out && pure(*child, seen);
+    });
+    return out;
+}
+// the functions are checked again on their next call
+inline void forget() {
+    for (auto& f : scope::userdefined_functions)
+        if (f) f->memo_checked = false;
+}
+}  // namespace details
+// whether calls to `f` are memoized
+inline bool enabled(Function& f) {
+    if (!f.memo_checked) {
+        auto& s = details::state();
+        std::unordered_set<symbol_t> seen;
+        bool pure = details::pure(*f.body, seen);
+        f.memoized = s.excluded.count(f.id) == 0 && pure;
+        s.calls[f.id] = std::move(seen);
+        f.memo_checked = true;
+    }
+    return f.memoized;
+}
+// calls to `function` aren't memoized even when it's pure
+inline void opt_out(std::string_view function) {
+    details::state().excluded.insert(symbols::intern(function));
+    details::forget();
+}
+inline void opt_in(std::string_view function) {
+    details::state().excluded.erase(symbols::intern(function));
+    details::forget();
+}
+inline Stats stats(std::string_view function) {
+    auto& tables = details::state().tables;
+    auto it = tables.find(symbols::intern(function));
+    return it != tables.end() ? it->second.stats : Stats{};
+}
+// the value of `id` called with `args`, nullptr when it isn't known
+inline const val_t* find(symbol_t id, const details::key_t& args) {
+    auto& s = details::state();
+    details::Table& table = s.tables[id];
+    auto it = table.index.find(args);
+    if (it == table.index.end()) {
+        ++table.stats.misses;
+        return nullptr;
+    }
+    ++table.stats.hits;
+    table.lru.splice(table.lru.begin(), table.lru, it->second);
+    it->second->used = ++s.tick;
+    return &it->second->value;
+}
+inline void store(symbol_t id, details::key_t args, const val_t& value) {
+    auto& s = details::state();
+    if (capacity == 0 || function_capacity == 0) return;
+    details::Table& table = s.tables[id];
+    if (table.index.count(args) != 0) return;
+    std::size_t bytes = details::bytes(args, value);
+    table.lru.push_front({std::move(args), value, ++s.tick, bytes});
+    table.index.emplace(table.lru.front().key, table.lru.begin());
+    s.bytes += bytes;
+    if (table.lru.size() > function_capacity) details::evict(table);
+    while (s.bytes > capacity) details::evict_oldest();
+}
+// drops the values of `id` and of the functions that call it, they are
+// checked again on their next call
+inline void redefined(symbol_t id) {
+    auto& s = details::state();
+    if (auto it = s.tables.find(id); it != s.tables.end())
+        details::drop(it->second);
+    for (auto it = s.calls.begin(); it != s.calls.end();) {
+        if (it->first != id && it->second.count(id) == 0) {
+            ++it;
+            continue;
+        }
+        if (auto table = s.tables.find(it->first); table != s.tables.end())
+            details::drop(table->second);
+        Function* f = scope::lookup(scope::userdefined_functions, it->first);
+        if (f != nullptr) f->memo_checked = false;
+        it = s.calls.erase(it);
+    }
+}
+// drops the values and checks the functions again, the statistics are kept
+inline void clear() {
+    auto& s = details::state();
+    for (auto& [id, table] : s.tables) {
+        table.lru.clear();
+        table.index.clear();
+    }
+    s.bytes = 0;
+    details::forget();
+}
+}  // namespace memo
+}  // namespace ami
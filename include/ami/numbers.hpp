@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+
+// contiguous storage for the elements of an evaluated vector, point or set.
+// vectors and points have 2 or 3 elements so those are kept inline, only
+// bigger sets allocate
+
+namespace ami {
+class Numbers {
+    static constexpr std::size_t inline_size = 3;
+    std::size_t m_Size = 0;
+    std::size_t m_Capacity = inline_size;
+    long double m_Inline[inline_size];
+    std::unique_ptr<long double[]> m_Heap;
+    void m_Grow(std::size_t capacity) {
+        // not make_unique, it would zero the array
+        std::unique_ptr<long double[]> heap(new long double[capacity]);
+        std::copy(begin(), end(), heap.get());
+        m_Heap = std::move(heap);
+        m_Capacity = capacity;
+    }
+
+   public:
+    Numbers() = default;
+    explicit Numbers(std::size_t size) { resize(size); }
+    Numbers(std::initializer_list<long double> values) {
+        reserve(values.size());
+        for (long double v : values) push_back(v);
+    }
+    Numbers(const Numbers& oth) {
+        reserve(oth.m_Size);
+        std::copy(oth.begin(), oth.end(), data());
+        m_Size = oth.m_Size;
+    }
+    Numbers(Numbers&& oth) noexcept { *this = std::move(oth); }
+    Numbers& operator=(const Numbers& oth) {
+        if (this != &oth) {
+            m_Size = 0;
+            reserve(oth.m_Size);
+            std::copy(oth.begin(), oth.end(), data());
+            m_Size = oth.m_Size;
+        }
+        return *this;
+    }
+    Numbers& operator=(Numbers&& oth) noexcept {
+        if (this == &oth) return *this;
+        m_Size = std::exchange(oth.m_Size, 0);
+        if (oth.m_Heap != nullptr) {
+            m_Heap = std::move(oth.m_Heap);
+            m_Capacity = std::exchange(oth.m_Capacity, inline_size);
+        } else {
+            m_Heap.reset();
+            m_Capacity = inline_size;
+            std::copy(oth.m_Inline, oth.m_Inline + m_Size, m_Inline);
+        }
+        return *this;
+    }
+    long double* data() { return m_Heap != nullptr ? m_Heap.get() : m_Inline; }
+    const long double* data() const {
+        return m_Heap != nullptr ? m_Heap.get() : m_Inline;
+    }
+    long double* begin() { return data(); }
+    long double* end() { return data() + m_Size; }
+    const long double* begin() const { return data(); }
+    const long double* end() const { return data() + m_Size; }
+    std::size_t size() const { return m_Size; }
+    bool empty() const { return m_Size == 0; }
+    long double& operator[](std::size_t i) { return data()[i]; }
+    long double operator[](std::size_t i) const { return data()[i]; }
+    void reserve(std::size_t capacity) {
+        if (capacity > m_Capacity) m_Grow(capacity);
+    }
+    void resize(std::size_t size) {
+        reserve(size);
+        m_Size = size;
+    }
+    void push_back(long double v) {
+        if (m_Size == m_Capacity) m_Grow(m_Capacity * 2);
+        data()[m_Size++] = v;
+    }
+    bool operator==(const Numbers& oth) const {
+        return std::equal(begin(), end(), oth.begin(), oth.end());
+    }
+    bool operator!=(const Numbers& oth) const { return !(*this == oth); }
+    bool operator<(const Numbers& oth) const {
+        return std::lexicographical_compare(begin(), end(), oth.begin(),
+                                            oth.end());
+    }
+    bool operator>(const Numbers& oth) const { return oth < *this; }
+};
+}  // namespace ami
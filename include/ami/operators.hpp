@@ -0,0 +1,386 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "ast.hpp"
+#include "bigint.hpp"
+#include "exact.hpp"
+#include "matrix.hpp"
+#include "numbers.hpp"
+#include "types.hpp"
+
+// the binary operators, comparisons and logical operators by operator and
+// by the types of both operands. each pair of types an operator is valid
+// for has a kernel so the Interpreter evaluates both operands once and calls
+// the one for their types, a value type only has to add its kernels to
+// make_table
+
+namespace ami {
+namespace operators {
+// raised by a kernel when its operands don't fit each other, the
+// Interpreter reports it at the operator
+struct Error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+using kernel_t = val_t (*)(const val_t&, const val_t&);
+inline constexpr std::size_t op_count =
+    static_cast<std::size_t>(Op::LessOrEqual) + 1;
+inline constexpr std::size_t type_count = std::variant_size_v<val_t>;
+namespace details {
+template <class T, std::size_t I = 0>
+constexpr std::size_t index() {
+    if constexpr (std::is_same_v<std::variant_alternative_t<I, val_t>, T>)
+        return I;
+    else
+        return index<T, I + 1>();
+}
+// the kernels are only called with the types they're added for
+template <class T>
+const T& get(const val_t& v) {
+    return *std::get_if<T>(&v);
+}
+inline void check(bool cond, const char* msg) {
+    if (!cond) throw Error(msg);
+}
+// numbers and booleans are compared by their value
+inline long double value(const Number& n) { return n.val; }
+inline long double value(const Boolean& b) { return b.val; }
+inline long double value(const Integer& i) { return i.value.to_long_double(); }
+inline long double value(const Fraction& f) {
+    return f.value.to_long_double();
+}
+// integers and fractions are never zero, they'd be a Number
+inline bool truthy(const Number& n) { return n.val != 0; }
+inline bool truthy(const Boolean& b) { return b.val; }
+inline bool truthy(const Integer&) { return true; }
+inline bool truthy(const Fraction&) { return true; }
+struct Modulo {
+    long double operator()(long double lhs, long double rhs) const {
+        return std::fmod(lhs, rhs);
+    }
+};
+template <class F>
+val_t arithmetic(const val_t& lhs, const val_t& rhs) {
+    return Number(F{}(get<Number>(lhs).val, get<Number>(rhs).val));
+}
+// sums, differences and products of integers stay exact past the mantissa
+// of a long double
+template <class F>
+val_t integer_arithmetic(const val_t& lhs, const val_t& rhs) {
+    long double l = get<Number>(lhs).val, r = get<Number>(rhs).val;
+    long double out = F{}(l, r);
+    if (!exact::inexact(l, r, out)) return Number(out);
+    return exact::integer(F{}(bigint::Int::from(l), bigint::Int::from(r)));
+}
+template <class F, class L, class R>
+val_t compare(const val_t& lhs, const val_t& rhs) {
+    return Boolean(static_cast<bool>(
+        F{}(value(get<L>(lhs)), value(get<R>(rhs)))));
+}
+template <class F, class L, class R>
+val_t logical(const val_t& lhs, const val_t& rhs) {
+    return Boolean(F{}(truthy(get<L>(lhs)), truthy(get<R>(rhs))));
+}
+// an operator with an integer or a fraction is exact when the other operand
+// is exact too, a long double is all a number that isn't an integer has
+template <class F>
+val_t exact_arithmetic(const val_t& lhs, const val_t& rhs) {
+    auto l = exact::to_rational(lhs), r = exact::to_rational(rhs);
+    if (!l || !r)
+        return Number(
+            F{}(*exact::to_long_double(lhs), *exact::to_long_double(rhs)));
+    return exact::rational(F{}(*l, *r));
+}
+inline val_t exact_quotient(const val_t& lhs, const val_t& rhs) {
+    auto l = exact::to_rational(lhs), r = exact::to_rational(rhs);
+    if (!l || !r || r->num().zero())
+        return Number(*exact::to_long_double(lhs) /
+                      *exact::to_long_double(rhs));
+    // a quotient of integers is often one, that skips the gcd of a fraction
+    if (l->integral() && r->integral()) {
+        bigint::Int q, rem;
+        bigint::Int::divmod(l->num(), r->num(), q, rem);
+        if (rem.zero()) return exact::integer(std::move(q));
+    }
+    return exact::rational(*l / *r);
+}
+// truncated like std::fmod
+inline val_t exact_modulo(const val_t& lhs, const val_t& rhs) {
+    auto l = exact::to_rational(lhs), r = exact::to_rational(rhs);
+    if (!l || !r || r->num().zero())
+        return Number(std::fmod(*exact::to_long_double(lhs),
+                                *exact::to_long_double(rhs)));
+    bigint::Rational q = *l / *r;
+    return exact::rational(*l - *r * bigint::Rational(q.num() / q.den()));
+}
+inline val_t exact_power(const val_t& lhs, const val_t& rhs) {
+    long double approx =
+        std::pow(*exact::to_long_double(lhs), *exact::to_long_double(rhs));
+    auto base = exact::to_rational(lhs);
+    auto exp = exact::to_integer(rhs);
+    if (!base || !exp || exp->bits() > 63 ||
+        (exp->negative() && base->num().zero()))
+        return Number(approx);
+    auto out = bigint::Rational::pow(
+        *base, static_cast<std::uint64_t>(exp->abs().to_long_double()));
+    if (!out) return Number(approx);
+    return exact::rational(exp->negative() ? bigint::Rational(1) / *out
+                                           : std::move(*out));
+}
+// powers of integers stay exact past the mantissa of a long double, and
+// negative ones are fractions like those of an Integer
+inline val_t power(const val_t& lhs, const val_t& rhs) {
+    long double l = get<Number>(lhs).val, r = get<Number>(rhs).val;
+    long double out = std::pow(l, r);
+    if (!exact::inexact_power(l, r, out)) return Number(out);
+    return exact_power(lhs, rhs);
+}
+// compared by the values the operands hold, a long double past the
+// mantissa isn't equal to the integers it's the closest to
+template <class F>
+val_t exact_compare(const val_t& lhs, const val_t& rhs) {
+    auto l = exact::value(lhs), r = exact::value(rhs);
+    if (l && r) return Boolean(F{}(compare(*l, *r), 0));
+    return Boolean(
+        F{}(*exact::to_long_double(lhs), *exact::to_long_double(rhs)));
+}
+// element wise `lhs op rhs` of two vectors or points
+template <class T, class F>
+val_t zip(const val_t& lhs, const val_t& rhs) {
+    const Numbers &l = get<T>(lhs).numbers, &r = get<T>(rhs).numbers;
+    check(l.size() == r.size(),
+          std::is_same_v<T, Vector>
+              ? "vectors must have the same size in order to perform "
+                "binary oprations"
+              : "operands must have the same size in order to perform "
+                "binary oprations");
+    Numbers out(l.size());
+    for (std::size_t i = 0; i < l.size(); i++) out[i] = F{}(l[i], r[i]);
+    return T(std::move(out));
+}
+inline Numbers scale(const Numbers& nums, long double k) {
+    Numbers out(nums.size());
+    for (std::size_t i = 0; i < nums.size(); i++) out[i] = nums[i] * k;
+    return out;
+}
+// `S` is the type of the scalar, integers and fractions are rounded
+template <class T, class S = Number>
+val_t scale_left(const val_t& lhs, const val_t& rhs) {
+    return T(scale(get<T>(rhs).numbers, value(get<S>(lhs))));
+}
+template <class T, class S = Number>
+val_t scale_right(const val_t& lhs, const val_t& rhs) {
+    return T(scale(get<T>(lhs).numbers, value(get<S>(rhs))));
+}
+inline val_t dot(const val_t& lhs, const val_t& rhs) {
+    const Numbers &l = get<Vector>(lhs).numbers, &r = get<Vector>(rhs).numbers;
+    check(l.size() == r.size(), "vectors must have the same size");
+    long double out = 0;
+    for (std::size_t i = 0; i < l.size(); i++) out += l[i] * r[i];
+    return Number(out);
+}
+// the same shape as `lhs` and `rhs`, each element is `F` of theirs
+template <class F>
+val_t zip_matrix(const val_t& lhs, const val_t& rhs) {
+    const Matrix &l = get<Matrix>(lhs), &r = get<Matrix>(rhs);
+    check(l.rows == r.rows && l.cols == r.cols,
+          std::is_same_v<F, std::plus<long double>>
+              ? "matrices must have the same dimensions for binary "
+                "operation '+'"
+              : "matrices must have the same dimensions for binary "
+                "operation '-'");
+    Numbers out(l.numbers.size());
+    matrix::zip(l.numbers.data(), r.numbers.data(), out.data(), out.size(),
+                F{});
+    return Matrix(l.rows, l.cols, std::move(out));
+}
+inline Matrix scale_matrix(const Matrix& m, long double k) {
+    Numbers out(m.numbers.size());
+    matrix::scale(m.numbers.data(), k, out.data(), out.size());
+    return Matrix(m.rows, m.cols, std::move(out));
+}
+template <class S>
+val_t scale_matrix_left(const val_t& lhs, const val_t& rhs) {
+    return scale_matrix(get<Matrix>(rhs), value(get<S>(lhs)));
+}
+template <class S>
+val_t scale_matrix_right(const val_t& lhs, const val_t& rhs) {
+    return scale_matrix(get<Matrix>(lhs), value(get<S>(rhs)));
+}
+// a product with a vector is a vector when it has the size of one,
+// a matrix with a single row or column otherwise
+inline val_t vector_or_matrix(Numbers nums, bool column) {
+    if (nums.size() == 2 || nums.size() == 3) return Vector(std::move(nums));
+    std::size_t size = nums.size();
+    return column ? Matrix(size, 1, std::move(nums))
+                  : Matrix(1, size, std::move(nums));
+}
+inline val_t multiply_matrices(const val_t& lhs, const val_t& rhs) {
+    const Matrix &l = get<Matrix>(lhs), &r = get<Matrix>(rhs);
+    check(l.cols == r.rows,
+          "the left matrix must have as many columns as the right one has "
+          "rows");
+    Numbers out(l.rows * r.cols);
+    matrix::multiply(l.numbers.data(), r.numbers.data(), out.data(), l.rows,
+                     l.cols, r.cols);
+    return Matrix(l.rows, r.cols, std::move(out));
+}
+inline val_t matrix_vector(const val_t& lhs, const val_t& rhs) {
+    const Matrix& m = get<Matrix>(lhs);
+    const Numbers& v = get<Vector>(rhs).numbers;
+    check(m.cols == v.size(),
+          "the matrix must have as many columns as the vector has elements");
+    Numbers out(m.rows);
+    matrix::multiply_vector(m.numbers.data(), v.data(), out.data(), m.rows,
+                            m.cols);
+    return vector_or_matrix(std::move(out), true);
+}
+inline val_t vector_matrix(const val_t& lhs, const val_t& rhs) {
+    const Numbers& v = get<Vector>(lhs).numbers;
+    const Matrix& m = get<Matrix>(rhs);
+    check(m.rows == v.size(),
+          "the matrix must have as many rows as the vector has elements");
+    Numbers out(m.cols);
+    matrix::vector_multiply(v.data(), m.numbers.data(), out.data(), m.rows,
+                            m.cols);
+    return vector_or_matrix(std::move(out), false);
+}
+// evaluated sets are sorted so the difference is a single merge of both
+inline val_t set_difference(const val_t& lhs, const val_t& rhs) {
+    const Numbers &l = get<SetObject>(lhs).numbers,
+                  &r = get<SetObject>(rhs).numbers;
+    Numbers out(l.size());
+    out.resize(std::set_difference(l.begin(), l.end(), r.begin(), r.end(),
+                                   out.begin()) -
+               out.begin());
+    return SetObject(std::move(out));
+}
+template <bool Equal>
+val_t set_equals(const val_t& lhs, const val_t& rhs) {
+    const Numbers &l = get<SetObject>(lhs).numbers,
+                  &r = get<SetObject>(rhs).numbers;
+    check(l.size() == r.size(), "compared sets must have the same size");
+    return Boolean((l == r) == Equal);
+}
+}  // namespace details
+class Table {
+    std::array<kernel_t, op_count * type_count * type_count> m_Kernels{};
+    static std::size_t m_At(Op op, std::size_t lhs, std::size_t rhs) {
+        return (static_cast<std::size_t>(op) * type_count + lhs) * type_count +
+               rhs;
+    }
+
+   public:
+    template <class L, class R>
+    void add(Op op, kernel_t kernel) {
+        m_Kernels[m_At(op, details::index<L>(), details::index<R>())] = kernel;
+    }
+    // nullptr when `op` isn't valid for the types of `lhs` and `rhs`
+    kernel_t find(Op op, const val_t& lhs, const val_t& rhs) const {
+        return m_Kernels[m_At(op, lhs.index(), rhs.index())];
+    }
+};
+namespace details {
+// comparisons and logical operators between numbers and booleans
+template <class L, class R>
+void add_scalars(Table& t) {
+    t.add<L, R>(Op::Equals, compare<std::equal_to<long double>, L, R>);
+    t.add<L, R>(Op::NotEquals, compare<std::not_equal_to<long double>, L, R>);
+    t.add<L, R>(Op::Greater, compare<std::greater<long double>, L, R>);
+    t.add<L, R>(Op::Less, compare<std::less<long double>, L, R>);
+    t.add<L, R>(Op::GreaterOrEqual,
+                compare<std::greater_equal<long double>, L, R>);
+    t.add<L, R>(Op::LessOrEqual, compare<std::less_equal<long double>, L, R>);
+    t.add<L, R>(Op::LogicalAnd, logical<std::logical_and<>, L, R>);
+    t.add<L, R>(Op::LogicalOr, logical<std::logical_or<>, L, R>);
+}
+// integers and fractions with each other and with numbers
+template <class L, class R>
+void add_exact(Table& t) {
+    t.add<L, R>(Op::Plus, exact_arithmetic<std::plus<>>);
+    t.add<L, R>(Op::Minus, exact_arithmetic<std::minus<>>);
+    t.add<L, R>(Op::Mult, exact_arithmetic<std::multiplies<>>);
+    t.add<L, R>(Op::Div, exact_quotient);
+    t.add<L, R>(Op::Mod, exact_modulo);
+    t.add<L, R>(Op::Pow, exact_power);
+    t.add<L, R>(Op::Equals, exact_compare<std::equal_to<>>);
+    t.add<L, R>(Op::NotEquals, exact_compare<std::not_equal_to<>>);
+    t.add<L, R>(Op::Greater, exact_compare<std::greater<>>);
+    t.add<L, R>(Op::Less, exact_compare<std::less<>>);
+    t.add<L, R>(Op::GreaterOrEqual, exact_compare<std::greater_equal<>>);
+    t.add<L, R>(Op::LessOrEqual, exact_compare<std::less_equal<>>);
+    t.add<L, R>(Op::LogicalAnd, logical<std::logical_and<>, L, R>);
+    t.add<L, R>(Op::LogicalOr, logical<std::logical_or<>, L, R>);
+}
+// products of a scalar of type `S` with vectors, points and matrices
+template <class S>
+void add_scaling(Table& t) {
+    t.add<S, Vector>(Op::Mult, scale_left<Vector, S>);
+    t.add<Vector, S>(Op::Mult, scale_right<Vector, S>);
+    t.add<S, Point>(Op::Mult, scale_left<Point, S>);
+    t.add<Point, S>(Op::Mult, scale_right<Point, S>);
+    t.add<S, Matrix>(Op::Mult, scale_matrix_left<S>);
+    t.add<Matrix, S>(Op::Mult, scale_matrix_right<S>);
+}
+inline Table make_table() {
+    Table t;
+    t.add<Number, Number>(Op::Plus, integer_arithmetic<std::plus<>>);
+    t.add<Number, Number>(Op::Minus, integer_arithmetic<std::minus<>>);
+    t.add<Number, Number>(Op::Mult, integer_arithmetic<std::multiplies<>>);
+    t.add<Number, Number>(Op::Div, arithmetic<std::divides<long double>>);
+    t.add<Number, Number>(Op::Pow, power);
+    t.add<Number, Number>(Op::Mod, arithmetic<Modulo>);
+    add_scalars<Number, Number>(t);
+    add_scalars<Number, Boolean>(t);
+    add_scalars<Boolean, Number>(t);
+    add_scalars<Boolean, Boolean>(t);
+    add_exact<Integer, Integer>(t);
+    add_exact<Integer, Fraction>(t);
+    add_exact<Fraction, Integer>(t);
+    add_exact<Fraction, Fraction>(t);
+    add_exact<Number, Integer>(t);
+    add_exact<Integer, Number>(t);
+    add_exact<Number, Fraction>(t);
+    add_exact<Fraction, Number>(t);
+    add_scalars<Integer, Boolean>(t);
+    add_scalars<Boolean, Integer>(t);
+    add_scalars<Fraction, Boolean>(t);
+    add_scalars<Boolean, Fraction>(t);
+
+    t.add<SetObject, SetObject>(Op::Minus, set_difference);
+    t.add<SetObject, SetObject>(Op::Equals, set_equals<true>);
+    t.add<SetObject, SetObject>(Op::NotEquals, set_equals<false>);
+
+    t.add<Vector, Vector>(Op::Plus, zip<Vector, std::plus<long double>>);
+    t.add<Vector, Vector>(Op::Mult, dot);
+
+    t.add<Point, Point>(Op::Plus, zip<Point, std::plus<long double>>);
+    t.add<Point, Point>(Op::Minus, zip<Point, std::minus<long double>>);
+    t.add<Point, Point>(Op::Mult, zip<Point, std::multiplies<long double>>);
+    t.add<Point, Point>(Op::Div, zip<Point, std::divides<long double>>);
+
+    t.add<Matrix, Matrix>(Op::Plus, zip_matrix<std::plus<long double>>);
+    t.add<Matrix, Matrix>(Op::Minus, zip_matrix<std::minus<long double>>);
+    t.add<Matrix, Matrix>(Op::Mult, multiply_matrices);
+    t.add<Matrix, Vector>(Op::Mult, matrix_vector);
+    t.add<Vector, Matrix>(Op::Mult, vector_matrix);
+    add_scaling<Number>(t);
+    add_scaling<Integer>(t);
+    add_scaling<Fraction>(t);
+    return t;
+}
+}  // namespace details
+inline const Table& table() {
+    static const Table t = details::make_table();
+    return t;
+}
+}  // namespace operators
+}  // namespace ami
@@ -0,0 +1,439 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "errors.hpp"
+#include "interpreter.hpp"
+#include "scope.hpp"
+#include "types.hpp"
+
+// passes over a parsed tree that run before it's evaluated
+
+namespace ami {
+namespace optimize {
+namespace details {
+inline bool is_literal(const ptr_t& e) {
+    AstType t = e->type();
+    return t == AstType::Number || t == AstType::Boolean ||
+           t == AstType::NullExpr || t == AstType::Integer ||
+           t == AstType::Fraction;
+}
+class Folder {
+    Interpreter m_Inter{exceptions::Diagnostic{}};
+    bool m_InFunction = false;
+    // the literal `e` evaluates to, `e` itself when evaluating it fails so
+    // the error is still raised when the tree is evaluated
+    ptr_t m_Compute(const ptr_t& e) {
+        try {
+            val_t v = m_Inter.visit(e);
+            if (auto* n = std::get_if<Number>(&v))
+                return std::make_shared<Number>(n->val);
+            if (auto* b = std::get_if<Boolean>(&v))
+                return std::make_shared<Boolean>(b->val);
+            if (std::get_if<NullExpr>(&v)) return std::make_shared<NullExpr>();
+            if (auto* i = std::get_if<Integer>(&v))
+                return std::make_shared<Integer>(i->value);
+            if (auto* f = std::get_if<Fraction>(&v))
+                return std::make_shared<Fraction>(f->value);
+        } catch (const exceptions::BaseException&) {
+        } catch (const std::exception&) {
+        }
+        return e;
+    }
+    // folds the operands, `e` is computed once they're all literals
+    void m_Operands(ptr_t& e, std::initializer_list<ptr_t*> operands) {
+        bool literals = true;
+        for (ptr_t* operand : operands) {
+            fold(*operand);
+            literals = literals && is_literal(*operand);
+        }
+        if (literals) e = m_Compute(e);
+    }
+    void m_If(ptr_t& e) {
+        auto* iexpr = static_cast<IfExpr*>(e.get());
+        fold(iexpr->cond);
+        if (!is_literal(iexpr->cond)) {
+            fold(iexpr->body);
+            if (iexpr->elsestmt != nullptr) fold(iexpr->elsestmt);
+            return;
+        }
+        // the same truth values as m_VisitIfExpr
+        bool is_true = false;
+        if (auto* b = dynamic_cast<Boolean*>(iexpr->cond.get()))
+            is_true = b->val;
+        else if (auto* n = dynamic_cast<Number*>(iexpr->cond.get()))
+            is_true = n->val != 0;
+        else
+            is_true = iexpr->cond->type() == AstType::Integer ||
+                      iexpr->cond->type() == AstType::Fraction;
+        if (is_true) {
+            e = iexpr->body;
+        } else if (iexpr->elsestmt != nullptr) {
+            e = iexpr->elsestmt;
+        } else {
+            e = std::make_shared<NullExpr>();
+            return;
+        }
+        fold(e);
+    }
+
+   public:
+    void fold(ptr_t& e) {
+        switch (e->type()) {
+            case AstType::Identifier: {
+                // identifiers are looked up in the callers' arguments first,
+                // in a function body any of them can shadow a constant
+                if (m_InFunction) return;
+                auto* ident = static_cast<Identifier*>(e.get());
+                if (const long double* c = builtins::constant(ident->id))
+                    e = std::make_shared<Number>(*c);
+                return;
+            }
+            case AstType::NegativeExpr:
+                m_Operands(e, {&static_cast<NegativeExpr*>(e.get())->value});
+                return;
+            case AstType::NotExpr:
+                m_Operands(e, {&static_cast<NotExpr*>(e.get())->value});
+                return;
+            case AstType::Symbol:
+                m_Operands(e, {&static_cast<SymbolExpr*>(e.get())->value});
+                return;
+            case AstType::BinaryOp: {
+                auto* b = static_cast<BinaryOpExpr*>(e.get());
+                m_Operands(e, {&b->lhs, &b->rhs});
+                return;
+            }
+            case AstType::Comparison: {
+                auto* c = static_cast<Comparison*>(e.get());
+                m_Operands(e, {&c->lhs, &c->rhs});
+                return;
+            }
+            case AstType::LogicalExpr: {
+                auto* l = static_cast<LogicalExpr*>(e.get());
+                m_Operands(e, {&l->lhs, &l->rhs});
+                return;
+            }
+            case AstType::FunctionCall: {
+                auto* fc = static_cast<FunctionCall*>(e.get());
+                bool literals = true;
+                for (auto& arg : fc->arguments) {
+                    fold(arg);
+                    literals = literals && is_literal(arg);
+                }
+                const auto* handler = builtins::function(fc->id);
+                if (literals && handler != nullptr && handler->pure)
+                    e = m_Compute(e);
+                return;
+            }
+            case AstType::IfExpr:
+                m_If(e);
+                return;
+            case AstType::UserDefinedIdentifier:
+                fold(static_cast<UserDefinedIdentifier*>(e.get())->value);
+                return;
+            case AstType::OpAndAssign:
+                fold(static_cast<OpAndAssignExpr*>(e.get())->rhs);
+                return;
+            case AstType::Function: {
+                bool outer = m_InFunction;
+                m_InFunction = true;
+                fold(static_cast<Function*>(e.get())->body);
+                m_InFunction = outer;
+                return;
+            }
+            // the elements are evaluated to numbers, the ones of a set are
+            // kept as they're written
+            case AstType::Vector:
+                for (auto& elm : static_cast<Vector*>(e.get())->value)
+                    fold(elm);
+                return;
+            case AstType::Point:
+                for (auto& elm : static_cast<Point*>(e.get())->value)
+                    fold(elm);
+                return;
+            case AstType::Matrix:
+                for (auto& elm : static_cast<Matrix*>(e.get())->value)
+                    fold(elm);
+                return;
+            default:
+                return;
+        }
+    }
+};
+// what evaluating a subtree can do besides computing its value
+struct Effects {
+    bool pure = true;     // the same value each time
+    bool writes = false;  // assigns identifiers or defines functions
+};
+class Sharer {
+    // the merged subtrees by hash, a subtree is only merged with one of the
+    // statement or of the function body it's in
+    std::unordered_multimap<std::size_t, ptr_t> m_Table;
+    std::unordered_map<symbol_t, Effects> m_Functions;
+    bool m_InFunction = false;
+    // user functions are followed to their bodies, nothing can redefine them
+    // while a statement is evaluated but they can be before the function
+    // body that calls them is
+    void m_Collect(Expr& e, Effects& out, std::unordered_set<symbol_t>& seen) {
+        switch (e.type()) {
+            case AstType::UserDefinedIdentifier:
+            case AstType::OpAndAssign:
+            case AstType::Function:
+                out = Effects{false, true};
+                return;
+            case AstType::FunctionCall: {
+                auto& fc = static_cast<FunctionCall&>(e);
+                if (const auto* handler = builtins::function(fc.id)) {
+                    out.pure = out.pure && handler->pure;
+                } else if (m_InFunction) {
+                    out = Effects{false, true};
+                    return;
+                } else if (seen.insert(fc.id).second) {
+                    Function* f =
+                        scope::lookup(scope::userdefined_functions, fc.id);
+                    if (f == nullptr)
+                        out.pure = false;
+                    else
+                        m_Collect(*f->body, out, seen);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        for_each_child(e, [&](ptr_t& child) { m_Collect(*child, out, seen); });
+    }
+    Effects m_Effects(Expr& e) {
+        Effects out;
+        std::unordered_set<symbol_t> seen;
+        m_Collect(e, out, seen);
+        return out;
+    }
+    bool m_Mergeable(Expr& e) {
+        switch (e.type()) {
+            case AstType::Number:
+            case AstType::Boolean:
+            case AstType::NullExpr:
+            case AstType::Identifier:
+            case AstType::NegativeExpr:
+            case AstType::NotExpr:
+            case AstType::Symbol:
+            case AstType::BinaryOp:
+            case AstType::Comparison:
+            case AstType::LogicalExpr:
+            case AstType::IfExpr:
+            case AstType::Vector:
+            case AstType::Point:
+            case AstType::Matrix:
+                return true;
+            case AstType::FunctionCall: {
+                auto& fc = static_cast<FunctionCall&>(e);
+                if (const auto* handler = builtins::function(fc.id))
+                    return handler->pure;
+                if (m_InFunction) return false;
+                auto it = m_Functions.find(fc.id);
+                if (it == m_Functions.end())
+                    it = m_Functions.emplace(fc.id, m_Effects(e)).first;
+                return it->second.pure && !it->second.writes;
+            }
+            default:
+                return false;
+        }
+    }
+    static std::vector<const Expr*> m_Children(Expr& e) {
+        std::vector<const Expr*> out;
+        for_each_child(e, [&out](ptr_t& child) { out.push_back(child.get()); });
+        return out;
+    }
+    // the operands are already merged so comparing them is comparing
+    // pointers
+    static bool m_Same(Expr& a, Expr& b) {
+        if (a.type() != b.type()) return false;
+        switch (a.type()) {
+            case AstType::Number: {
+                long double x = static_cast<Number&>(a).val;
+                long double y = static_cast<Number&>(b).val;
+                if (std::signbit(x) != std::signbit(y)) return false;
+                if (x != y && !(std::isnan(x) && std::isnan(y))) return false;
+                break;
+            }
+            case AstType::Boolean:
+                if (static_cast<Boolean&>(a).val != static_cast<Boolean&>(b).val)
+                    return false;
+                break;
+            case AstType::Identifier:
+                if (static_cast<Identifier&>(a).id !=
+                    static_cast<Identifier&>(b).id)
+                    return false;
+                break;
+            case AstType::FunctionCall:
+                if (static_cast<FunctionCall&>(a).id !=
+                    static_cast<FunctionCall&>(b).id)
+                    return false;
+                break;
+            case AstType::BinaryOp:
+                if (static_cast<BinaryOpExpr&>(a).op !=
+                    static_cast<BinaryOpExpr&>(b).op)
+                    return false;
+                break;
+            case AstType::Comparison:
+                if (static_cast<Comparison&>(a).op !=
+                    static_cast<Comparison&>(b).op)
+                    return false;
+                break;
+            case AstType::LogicalExpr:
+                if (static_cast<LogicalExpr&>(a).op !=
+                    static_cast<LogicalExpr&>(b).op)
+                    return false;
+                break;
+            case AstType::Symbol:
+                if (static_cast<SymbolExpr&>(a).symbol !=
+                    static_cast<SymbolExpr&>(b).symbol)
+                    return false;
+                break;
+            default:
+                break;
+        }
+        return m_Children(a) == m_Children(b);
+    }
+    static std::size_t m_Hash(Expr& e) {
+        std::size_t h = static_cast<std::size_t>(e.type());
+        auto mix = [&h](std::size_t v) {
+            h ^= v + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+        };
+        switch (e.type()) {
+            case AstType::Number:
+                mix(std::hash<long double>{}(static_cast<Number&>(e).val));
+                break;
+            case AstType::Boolean:
+                mix(static_cast<Boolean&>(e).val);
+                break;
+            case AstType::Identifier:
+                mix(static_cast<Identifier&>(e).id);
+                break;
+            case AstType::FunctionCall:
+                mix(static_cast<FunctionCall&>(e).id);
+                break;
+            case AstType::BinaryOp:
+                mix(static_cast<std::size_t>(static_cast<BinaryOpExpr&>(e).op));
+                break;
+            case AstType::Comparison:
+                mix(static_cast<std::size_t>(static_cast<Comparison&>(e).op));
+                break;
+            case AstType::LogicalExpr:
+                mix(static_cast<std::size_t>(static_cast<LogicalExpr&>(e).op));
+                break;
+            case AstType::Symbol:
+                mix(static_cast<std::size_t>(
+                    static_cast<SymbolExpr&>(e).symbol));
+                break;
+            default:
+                break;
+        }
+        for (const Expr* child : m_Children(e))
+            mix(std::hash<const Expr*>{}(child));
+        return h;
+    }
+    // merges the subtrees of `e` bottom up, returns whether `e` can be merged
+    bool m_Share(ptr_t& e) {
+        bool mergeable = true;
+        for_each_child(*e, [&](ptr_t& child) {
+            mergeable = m_Share(child) && mergeable;
+        });
+        if (!mergeable || !m_Mergeable(*e)) return false;
+        std::size_t h = m_Hash(*e);
+        auto [it, end] = m_Table.equal_range(h);
+        for (; it != end; ++it) {
+            if (!m_Same(*it->second, *e)) continue;
+            e = it->second;
+            // leaves are cheaper to evaluate than to look up
+            if (!m_Children(*e).empty()) e->shared = true;
+            return true;
+        }
+        m_Table.emplace(h, e);
+        return true;
+    }
+
+   public:
+    // the statement `e`, or the body of a function
+    void share(ptr_t& e) {
+        switch (e->type()) {
+            case AstType::Function: {
+                auto table = std::exchange(m_Table, {});
+                bool outer = std::exchange(m_InFunction, true);
+                share(static_cast<Function*>(e.get())->body);
+                m_InFunction = outer;
+                m_Table = std::move(table);
+                return;
+            }
+            case AstType::UserDefinedIdentifier:
+                // assigned once its value is computed
+                share(static_cast<UserDefinedIdentifier*>(e.get())->value);
+                return;
+            default:
+                // a subtree could be computed before an assignment and used
+                // after it
+                if (!m_Effects(*e).writes) m_Share(e);
+                return;
+        }
+    }
+};
+// sets the slot of the identifiers under `e` that name one of `params`, the
+// arguments of the function whose body `e` is in
+inline void resolve(Expr& e, const std::vector<ptr_t>* params) {
+    if (e.type() == AstType::Function) {
+        params = &static_cast<Function&>(e).arguments;
+    } else if (e.type() == AstType::Identifier && params != nullptr) {
+        auto& ident = static_cast<Identifier&>(e);
+        // the first one wins like in the Interpreter's frames
+        for (std::size_t i = 0; i < params->size(); ++i) {
+            if (static_cast<Identifier&>(*(*params)[i]).id == ident.id) {
+                ident.slot = i;
+                break;
+            }
+        }
+    }
+    for_each_child(e, [params](ptr_t& child) { resolve(*child, params); });
+}
+}  // namespace details
+// points the identifiers in function bodies that name an argument of the
+// function to its index in the call frame, see Identifier::slot
+inline ptr_t resolve_slots(const ptr_t& root) {
+    details::resolve(*root, nullptr);
+    return root;
+}
+// replaces the subtrees of `root` that only depend on literals, builtin
+// constants and pure builtins with their value and the `if`s with a constant
+// condition with the branch it picks, function bodies included. anything
+// that fails to evaluate is left as it is for the Interpreter to report
+inline ptr_t fold_constants(const ptr_t& root) {
+    ptr_t out = root;
+    details::Folder{}.fold(out);
+    // nodes under the root are borrowed from the parse's arena, a branch
+    // that becomes the root has to keep the arena alive
+    if (out.get() != root.get() && out.use_count() == 0)
+        return ptr_t(root, out.get());
+    return out;
+}
+// merges the identical subtrees of `root` so each of them is computed once
+// by the Interpreter, see Expr::shared. only the ones that give the same
+// value every time are, nothing is merged in a statement or function body
+// that assigns identifiers or calls user functions that do
+inline ptr_t share_common(const ptr_t& root) {
+    ptr_t out = root;
+    details::Sharer{}.share(out);
+    return out;
+}
+}  // namespace optimize
+}  // namespace ami
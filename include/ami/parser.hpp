@@ -1,47 +1,178 @@
 #pragma once
 #include <fmt/core.h>
 
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
-#include <iostream>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <thread>
 
+#include "arena.hpp"
 #include "ast.hpp"
 #include "errors.hpp"
+#include "exact.hpp"
 #include "lexer.hpp"
 #include "types.hpp"
 namespace ami {
+// both produce the same tree, the recursive descent parser is kept around to
+// compare against
+enum class ParseMode { Pratt, RecursiveDescent };
+namespace details {
+// precedence levels of the binary operators, loosest first, they follow the
+// recursive descent levels m_ParseComp -> m_ParseExpr -> ... -> m_ParseSymbols
+enum class Level : std::uint8_t {
+    None,
+    Comp,
+    Expr,
+    Term,
+    Su,
+    Logical,
+    SetOps,
+    Symbols
+};
+enum class Infix : std::uint8_t {
+    None,
+    Comparison,
+    Binary,
+    Assign,
+    In,
+    Logical,
+    Union,
+    Intersection,
+    Factorial,
+    Invalid
+};
+struct BindingPower {
+    Level level = Level::None;  // Level::None when the token isn't infix
+    Level rhs = Level::None;    // level the right operand is parsed at
+    Infix kind = Infix::None;
+    Op op = Op::Plus;
+};
+// indexed by Tokens
+inline constexpr std::array<BindingPower, tokens_count> binding_powers = [] {
+    std::array<BindingPower, tokens_count> t{};
+    auto set = [&t](Tokens tok, Level level, Level rhs, Infix kind,
+                    Op op = Op::Plus) {
+        t[static_cast<std::size_t>(tok)] = BindingPower{level, rhs, kind, op};
+    };
+    using L = Level;
+    using I = Infix;
+    set(Tokens::GreaterThan, L::Comp, L::Expr, I::Comparison, Op::Greater);
+    set(Tokens::GreaterThanOrEqual, L::Comp, L::Expr, I::Comparison,
+        Op::GreaterOrEqual);
+    set(Tokens::LessThan, L::Comp, L::Expr, I::Comparison, Op::Less);
+    set(Tokens::LessThanOrEqual, L::Comp, L::Expr, I::Comparison,
+        Op::LessOrEqual);
+    set(Tokens::Equals, L::Comp, L::Expr, I::Comparison, Op::Equals);
+    set(Tokens::NotEquals, L::Comp, L::Expr, I::Comparison, Op::NotEquals);
+    set(Tokens::Plus, L::Expr, L::Term, I::Binary, Op::Plus);
+    set(Tokens::PlusAssign, L::Expr, L::Term, I::Assign, Op::Plus);
+    set(Tokens::Minus, L::Expr, L::Term, I::Binary, Op::Minus);
+    set(Tokens::MinusAssign, L::Expr, L::Term, I::Assign, Op::Minus);
+    set(Tokens::KeywordIn, L::Expr, L::SetOps, I::In);
+    set(Tokens::Unkown, L::Expr, L::None, I::Invalid);
+    set(Tokens::Mult, L::Term, L::Su, I::Binary, Op::Mult);
+    set(Tokens::MultAssign, L::Term, L::Term, I::Assign, Op::Mult);
+    set(Tokens::Div, L::Term, L::Su, I::Binary, Op::Div);
+    set(Tokens::DivAssign, L::Term, L::Term, I::Assign, Op::Div);
+    set(Tokens::Pow, L::Su, L::Logical, I::Binary, Op::Pow);
+    set(Tokens::PowAssign, L::Su, L::Term, I::Assign, Op::Pow);
+    set(Tokens::Mod, L::Su, L::Logical, I::Binary, Op::Mod);
+    set(Tokens::ModAssign, L::Su, L::Term, I::Assign, Op::Mod);
+    set(Tokens::KeywordAnd, L::Logical, L::SetOps, I::Logical,
+        Op::LogicalAnd);
+    set(Tokens::KeywordOr, L::Logical, L::SetOps, I::Logical, Op::LogicalOr);
+    set(Tokens::KeywordUnion, L::SetOps, L::Symbols, I::Union);
+    set(Tokens::KeywordIntersection, L::SetOps, L::Symbols, I::Intersection);
+    set(Tokens::Factorial, L::Symbols, L::None, I::Factorial);
+    return t;
+}();
+}  // namespace details
 class Parser {
+    // lookahead computed once per statement by m_Index so the parser never
+    // has to scan ahead for a delimiter
+    struct Lookahead {
+        std::size_t match;          // matching ')' of a '(', npos otherwise
+        std::size_t next_semi;      // first ';' at or after this token
+        std::size_t next_cbracket;  // first '[' or ']' at or after it
+        bool has_comma = false;     // a '(' with a comma at its own depth
+    };
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
     std::vector<TokenHandler> m_Src;
+    std::vector<Lookahead> m_Look;
+    std::shared_ptr<Arena> m_Arena;
+    ParseMode m_Mode = ParseMode::Pratt;
     std::size_t m_Pos = 0;
-    ami::exceptions::ExceptionInterface ei;
+    TokenStream* m_Stream = nullptr;
+    using ErrorCode = ami::exceptions::ErrorCode;
+    ami::exceptions::Diagnostic ei;
     // to disable syntax checking for nunbers in funtion's args
 
-    TokenHandler m_Get() {
-        return m_Src.at(m_Pos >= m_Src.size() ? m_Src.size() - 1 : m_Pos);
+    std::string_view m_Text(const TokenHandler& tok) const {
+        return tok.text(ei.src);
     }
-    TokenHandler m_Prev(std::size_t x = 1) {
-        return m_Src.at((m_Pos) == 0 ? 0 : m_Pos - x);
+
+    const TokenHandler& m_Get() const {
+        return m_Src[m_Pos >= m_Src.size() ? m_Src.size() - 1 : m_Pos];
+    }
+    const TokenHandler& m_Prev(std::size_t x = 1) const {
+        return m_Src[(m_Pos) == 0 ? 0 : m_Pos - x];
+    }
+    bool not_eof() const { return m_Pos < m_Src.size(); }
+    // nodes are allocated in the parse's arena and don't own each other
+    template <class T, class... Args>
+    ptr_t m_Make(Args&&... args) {
+        return borrow<Expr>(m_Arena->make<T>(std::forward<Args>(args)...));
+    }
+    // the returned root keeps the whole arena alive
+    ptr_t m_Own(const ptr_t& root) { return ptr_t(m_Arena, root.get()); }
+    // one linear pass over the statement filling m_Look, parens and braces
+    // share a stack so commas are attributed to the innermost of them
+    void m_Index() {
+        std::size_t n = m_Src.size();
+        m_Look.assign(n, Lookahead{npos, n, n});
+        std::vector<std::size_t> open;
+        for (std::size_t i = 0; i < n; ++i) {
+            const TokenHandler& tok = m_Src[i];
+            if (tok.is(Tokens::Lparen, Tokens::Lbracket)) {
+                open.push_back(i);
+            } else if (tok.is(Tokens::Rparen) && !open.empty() &&
+                       m_Src[open.back()].is(Tokens::Lparen)) {
+                m_Look[open.back()].match = i;
+                open.pop_back();
+            } else if (tok.is(Tokens::Rbracket) && !open.empty() &&
+                       m_Src[open.back()].is(Tokens::Lbracket)) {
+                open.pop_back();
+            } else if (tok.is(Tokens::Comma) && !open.empty()) {
+                m_Look[open.back()].has_comma = true;
+            }
+        }
+        for (std::size_t i = n; i-- > 0;) {
+            if (i + 1 < n) {
+                m_Look[i].next_semi = m_Look[i + 1].next_semi;
+                m_Look[i].next_cbracket = m_Look[i + 1].next_cbracket;
+            }
+            if (m_Src[i].is(Tokens::Semicolon)) m_Look[i].next_semi = i;
+            if (m_Src[i].is(Tokens::Lcbracket, Tokens::Rcbracket))
+                m_Look[i].next_cbracket = i;
+        }
     }
-    bool not_eof() { return m_Pos < m_Src.size(); }
-    bool m_IsAnOp(TokenHandler tok) {
+    bool m_IsAnOp(const TokenHandler& tok) const {
         return tok.is(Tokens::Mod, Tokens::ModAssign, Tokens::Div,
                       Tokens::DivAssign, Tokens::Mult, Tokens::MultAssign,
                       Tokens::Plus, Tokens::PlusAssign, Tokens::Minus,
                       Tokens::MinusAssign, Tokens::Pow, Tokens::PowAssign);
     }
-    bool m_IsValidAfterNumber(TokenHandler tok) {
+    bool m_IsValidAfterNumber(const TokenHandler& tok) const {
         return m_IsAnOp(tok) ||
-               tok.is(Tokens::Lparen, Tokens::Rparen, Tokens::Digit,
-                      Tokens::Delim, Tokens::Edelim, Tokens::KeywordElse,
-                      Tokens::Dot, Tokens::Semicolon, Tokens::Lcbracket,
-                      Tokens::Comma, Tokens::Rcbracket, Tokens::KeywordIn,
-                      Tokens::Factorial, Tokens::Rbracket, Tokens::AbsEnd,
-                      Tokens::NormEnd);
+               tok.is(Tokens::Lparen, Tokens::Rparen, Tokens::KeywordElse,
+                      Tokens::Semicolon, Tokens::Lcbracket, Tokens::Comma,
+                      Tokens::Rcbracket, Tokens::KeywordIn, Tokens::Factorial,
+                      Tokens::Rbracket, Tokens::AbsEnd, Tokens::NormEnd);
     }
     std::vector<ptr_t> m_ParseSplitedInput(Tokens end, Tokens delim,
                                            const std::string& delimstr,
@@ -58,7 +189,7 @@ class Parser {
                 if (m_Get().is(delim)) {
                     m_Advance();
                 } else if (!not_eof()) {
-                    m_ThrowErr("ParseError",
+                    m_ThrowErr(ErrorCode::ParseError,
                                fmt::format("EOF while parsing {}", msg));
                 } else {
                     out.push_back(m_ParseComp());
@@ -66,7 +197,7 @@ class Parser {
             }
         }
         if (m_Get().isNot(end)) {
-            m_ThrowErr("SyntaxError",
+            m_ThrowErr(ErrorCode::SyntaxError,
                        fmt::format("expected '{}' after {}", delimstr, msg));
         }
         m_Advance();
@@ -91,7 +222,7 @@ class Parser {
                     else
                         m_Err();
                 } else if (!not_eof()) {
-                    m_ThrowErr("ParseError",
+                    m_ThrowErr(ErrorCode::ParseError,
                                "EOF while parsing function arguments ");
                 } else {
                     ptr_t temp = m_ParseComp();
@@ -101,48 +232,31 @@ class Parser {
                         // to allow only identifier in arguments when defining a
                         // function i.e: this is invalid `f(5) -> x`
                         m_ThrowErr(
-                            "TypeError",
+                            ErrorCode::TypeError,
                             "expected identifier in function's arguments");
                     }
                 }
             } while (m_Get().isNot(Tokens::Rparen));
         }
         if (m_Get().isNot(Tokens::Rparen)) {
-            m_ThrowErr("SyntaxError", "expected ')' after arguments list");
+            m_ThrowErr(ErrorCode::SyntaxError,
+                       "expected ')' after arguments list");
         }
         m_Advance();
         return args;
     }
-    ptr_t m_ParseFunctionDefOrCall(TokenHandler tok) {
+    ptr_t m_ParseFunctionDefOrCall(const TokenHandler& tok) {
         /*
-         * create a subvector from the main source so
-         * helper variables won't look for out of
-         * range tokens i.e:
-         * m_Src have a function definition that's
-         * call another function: 'func(x) ->
-         * sqrt(x)+x`, get_rparen and get_assign will
-         * look up at m_Src range for rparen and
-         * assign tokens
-         * ) and = for function 'func' will be found
-         * and a unexpected sigfault will happen
+         * it's a definition only when the ')' closing this '(' is
+         * followed by '->', so `func(x) -> sqrt(x)+x` defines func
+         * while sqrt(x) stays a call, the '(' is the previous token
          */
-        std::string name = tok.value;
-        std::vector<TokenHandler> src(m_Src.begin() + m_Pos, m_Src.end());
-        auto get_rparen = std::find_if(src.begin(), src.end(), [](auto t) {
-            return t.is(Tokens::Rparen);
-        });
-        auto get_fdef = std::find_if(src.begin(), src.end(), [](auto t) {
-            return t.is(Tokens::FunctionDef);
-        });
-        bool contains_fdef = get_fdef != src.end();
-        bool invalid_fdef = get_fdef < get_rparen;
-        // to prevent somth like f(->) from being a valid syntax
-        std::vector<ptr_t> args;
-        if (contains_fdef && !invalid_fdef) {
-            args = m_ParseFunctionDefArgs();
-        } else if (!contains_fdef) {
-            args = m_ParseFunctionArgs();
-        }
+        symbol_t name = tok.sym;
+        std::size_t rparen = m_Look[m_Pos - 1].match;
+        bool contains_fdef = rparen != npos && rparen + 1 < m_Src.size() &&
+                             m_Src[rparen + 1].is(Tokens::FunctionDef);
+        std::vector<ptr_t> args = contains_fdef ? m_ParseFunctionDefArgs()
+                                                : m_ParseFunctionArgs();
         m_Advance();
         if (contains_fdef) {
             ptr_t body = m_ParseComp();
@@ -152,10 +266,12 @@ class Parser {
             // function argument and advancing again after
             // parsing the arguments
 
-            return std::make_shared<Function>(name, body, args);
+            ptr_t func = m_Make<Function>(name, body, args);
+            static_cast<Function*>(func.get())->arena = m_Arena;
+            return func;
         } else {
             m_Advance(-1);
-            return std::make_shared<FunctionCall>(name, args);
+            return m_Make<FunctionCall>(name, args);
         }
     }
     ptr_t m_ParseIdentAssign() {
@@ -166,55 +282,9 @@ class Parser {
         }
         return value;
     }
-    bool m_IsValidPunc(TokenHandler tok) {
-        return tok.is(Tokens::Digit, Tokens::Dot, Tokens::Delim, Tokens::Edelim,
-                      Tokens::Minus, Tokens::Semicolon, Tokens::Rbracket,
-                      Tokens::AbsEnd, Tokens::NormEnd);
-    }
-    bool m_IsBreakable(TokenHandler tok) {
-        return tok.is(Tokens::Semicolon, Tokens::KeywordIn, Tokens::Rbracket,
-                      Tokens::AbsEnd, Tokens::NormEnd) ||
-               m_IsCompareToken(tok) || m_IsLogical(tok);
-    }
-    std::string m_GetDigit() {
-        std::string temp{};
-        bool is_decimal{};
-        bool contains_e{};
-        while (not_eof() && m_IsValidPunc(m_Get())) {
-            if (m_Get().is(Tokens::Digit)) {
-                temp += m_Get().value;
-            } else if (m_Get().is(Tokens::Dot)) {
-                if (is_decimal || !m_IsValidPunc(m_Peek())) {
-                    m_Err();
-                } else {
-                    temp += m_Get().value;
-                    is_decimal = true;
-                }
-            } else if (m_Get().is(Tokens::Edelim)) {
-                if (contains_e) {
-                    m_Err();
-                } else {
-                    temp += m_Get().value;
-                    contains_e = true;
-                }
-            } else if (m_Get().is(Tokens::Minus)) {
-                if (contains_e && m_Prev().is(Tokens::Edelim)) {
-                    temp += m_Get().value;
-                    // if the digit is 1e-10 parse the e-10 then break cuz we
-                    // don't want to ignore the minus operator
-                } else {
-                    break;
-                }
-            } else if (m_IsBreakable(m_Get())) {
-                break;
-            }
-            m_Advance();
-        }
-        return temp;
-    }
-    TokenHandler m_Peek(std::size_t x = 1) {
-        return m_Src.at((m_Pos + x) >= m_Src.size() ? m_Src.size() - 1
-                                                    : m_Pos + x);
+    const TokenHandler& m_Peek(std::size_t x = 1) const {
+        return m_Src[(m_Pos + x) >= m_Src.size() ? m_Src.size() - 1
+                                                 : m_Pos + x];
     }
     void m_Advance(std::size_t x = 1) {
         if (m_Pos < m_Src.size())
@@ -222,41 +292,90 @@ class Parser {
         else
             return;
     }
-    bool m_IsCompareToken(TokenHandler tok) {
+    bool m_IsCompareToken(const TokenHandler& tok) const {
         return tok.is(Tokens::GreaterThan, Tokens::Equals, Tokens::NotEquals,
                       Tokens::GreaterThanOrEqual, Tokens::LessThan,
                       Tokens::LessThanOrEqual);
     }
-    bool m_IsLogical(TokenHandler tok) {
+    bool m_IsLogical(const TokenHandler& tok) const {
         return tok.is(Tokens::KeywordAnd, Tokens::KeywordOr);
     }
+    // precedence climbing over details::binding_powers, parses everything
+    // from `min` up. once an operator of some level is applied only
+    // operators of that level or looser may follow, like in the
+    // recursive descent parser where each level loops over its own
+    // operators and then returns to the one above it
+    ptr_t m_ParseBinary(details::Level min) {
+        using details::Infix;
+        ptr_t out = m_ParseFactor();
+        details::Level limit = details::Level::Symbols;
+        while (not_eof()) {
+            const details::BindingPower& bp =
+                details::binding_powers[static_cast<std::size_t>(
+                    m_Get().token)];
+            if (bp.kind == Infix::None || bp.level < min || bp.level > limit)
+                break;
+            if (bp.kind == Infix::Invalid) m_Err();
+            limit = bp.level;
+            m_Advance();
+            switch (bp.kind) {
+                case Infix::Comparison:
+                    out = m_Make<Comparison>(bp.op, out, m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::Binary:
+                    out =
+                        m_Make<BinaryOpExpr>(bp.op, out, m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::Assign:
+                    out = m_Make<OpAndAssignExpr>(bp.op, out,
+                                                  m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::In:
+                    out = m_Make<InExpr>(out, m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::Logical:
+                    out =
+                        m_Make<LogicalExpr>(bp.op, out, m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::Union:
+                    out = m_Make<UnionExpr>(out, m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::Intersection:
+                    out = m_Make<InterSectionExpr>(out, m_ParseBinary(bp.rhs));
+                    break;
+                case Infix::Factorial:
+                    out = m_Make<SymbolExpr>(out, Symbol::Factorial);
+                    break;
+                default:
+                    break;
+            }
+        }
+        return out;
+    }
     ptr_t m_ParseComp() {
+        if (m_Mode == ParseMode::Pratt)
+            return m_ParseBinary(details::Level::Comp);
         ptr_t out = m_ParseExpr();
         while (not_eof() && (m_IsCompareToken(m_Get()))) {
             if (m_Get().is(Tokens::GreaterThan)) {
                 m_Advance();
-                out = std::make_shared<Comparison>(Op::Greater, out,
-                                                   m_ParseExpr());
+                out = m_Make<Comparison>(Op::Greater, out, m_ParseExpr());
             } else if (m_Get().is(Tokens::GreaterThanOrEqual)) {
                 m_Advance();
-                out = std::make_shared<Comparison>(Op::GreaterOrEqual, out,
-                                                   m_ParseExpr());
+                out = m_Make<Comparison>(Op::GreaterOrEqual, out,
+                                         m_ParseExpr());
             } else if (m_Get().is(Tokens::LessThan)) {
                 m_Advance();
-                out =
-                    std::make_shared<Comparison>(Op::Less, out, m_ParseExpr());
+                out = m_Make<Comparison>(Op::Less, out, m_ParseExpr());
             } else if (m_Get().is(Tokens::LessThanOrEqual)) {
                 m_Advance();
-                out = std::make_shared<Comparison>(Op::LessOrEqual, out,
-                                                   m_ParseExpr());
+                out = m_Make<Comparison>(Op::LessOrEqual, out, m_ParseExpr());
             } else if (m_Get().is(Tokens::Equals)) {
                 m_Advance();
-                out = std::make_shared<Comparison>(Op::Equals, out,
-                                                   m_ParseExpr());
+                out = m_Make<Comparison>(Op::Equals, out, m_ParseExpr());
             } else if (m_Get().is(Tokens::NotEquals)) {
                 m_Advance();
-                out = std::make_shared<Comparison>(Op::NotEquals, out,
-                                                   m_ParseExpr());
+                out = m_Make<Comparison>(Op::NotEquals, out, m_ParseExpr());
             }
         }
         return out;
@@ -268,23 +387,19 @@ class Parser {
                                        Tokens::KeywordIn, Tokens::Unkown)) {
             if (m_Get().is(Tokens::Plus)) {
                 m_Advance();
-                out = std::make_shared<BinaryOpExpr>(Op::Plus, out,
-                                                     m_ParseTerm());
+                out = m_Make<BinaryOpExpr>(Op::Plus, out, m_ParseTerm());
             } else if (m_Get().is(Tokens::PlusAssign)) {
                 m_Advance();
-                out = std::make_shared<OpAndAssignExpr>(Op::Plus, out,
-                                                        m_ParseTerm());
+                out = m_Make<OpAndAssignExpr>(Op::Plus, out, m_ParseTerm());
             } else if (m_Get().is(Tokens::Minus)) {
                 m_Advance();
-                out = std::make_shared<BinaryOpExpr>(Op::Minus, out,
-                                                     m_ParseTerm());
+                out = m_Make<BinaryOpExpr>(Op::Minus, out, m_ParseTerm());
             } else if (m_Get().is(Tokens::MinusAssign)) {
                 m_Advance();
-                out = std::make_shared<OpAndAssignExpr>(Op::Minus, out,
-                                                        m_ParseTerm());
+                out = m_Make<OpAndAssignExpr>(Op::Minus, out, m_ParseTerm());
             } else if (m_Get().is(Tokens::KeywordIn)) {
                 m_Advance();
-                out = std::make_shared<InExpr>(out, m_ParseSetOps());
+                out = m_Make<InExpr>(out, m_ParseSetOps());
             } else if (m_Get().is(Tokens::Unkown)) {
                 m_Err();
             }
@@ -297,19 +412,16 @@ class Parser {
                                        Tokens::Div, Tokens::DivAssign)) {
             if (m_Get().is(Tokens::Mult)) {
                 m_Advance();
-                out =
-                    std::make_shared<BinaryOpExpr>(Op::Mult, out, m_ParseSu());
+                out = m_Make<BinaryOpExpr>(Op::Mult, out, m_ParseSu());
             } else if (m_Get().is(Tokens::MultAssign)) {
                 m_Advance();
-                out = std::make_shared<OpAndAssignExpr>(Op::Mult, out,
-                                                        m_ParseTerm());
+                out = m_Make<OpAndAssignExpr>(Op::Mult, out, m_ParseTerm());
             } else if (m_Get().is(Tokens::Div)) {
                 m_Advance();
-                out = std::make_shared<BinaryOpExpr>(Op::Div, out, m_ParseSu());
+                out = m_Make<BinaryOpExpr>(Op::Div, out, m_ParseSu());
             } else if (m_Get().is(Tokens::DivAssign)) {
                 m_Advance();
-                out = std::make_shared<OpAndAssignExpr>(Op::Div, out,
-                                                        m_ParseTerm());
+                out = m_Make<OpAndAssignExpr>(Op::Div, out, m_ParseTerm());
             }
         }
         return out;
@@ -320,21 +432,17 @@ class Parser {
                                        Tokens::Mod, Tokens::ModAssign)) {
             if (m_Get().is(Tokens::Pow)) {
                 m_Advance();
-                out = std::make_shared<BinaryOpExpr>(Op::Pow, out,
-                                                     m_ParseLogical());
+                out = m_Make<BinaryOpExpr>(Op::Pow, out, m_ParseLogical());
             } else if (m_Get().is(Tokens::PowAssign)) {
                 m_Advance();
-                out = std::make_shared<OpAndAssignExpr>(Op::Pow, out,
-                                                        m_ParseTerm());
+                out = m_Make<OpAndAssignExpr>(Op::Pow, out, m_ParseTerm());
 
             } else if (m_Get().is(Tokens::Mod)) {
                 m_Advance();
-                out = std::make_shared<BinaryOpExpr>(Op::Mod, out,
-                                                     m_ParseLogical());
+                out = m_Make<BinaryOpExpr>(Op::Mod, out, m_ParseLogical());
             } else if (m_Get().is(Tokens::ModAssign)) {
                 m_Advance();
-                out = std::make_shared<OpAndAssignExpr>(Op::Mod, out,
-                                                        m_ParseTerm());
+                out = m_Make<OpAndAssignExpr>(Op::Mod, out, m_ParseTerm());
             }
         }
         return out;
@@ -344,17 +452,15 @@ class Parser {
         while (not_eof() && m_IsLogical(m_Get())) {
             if (m_Get().is(Tokens::KeywordAnd)) {
                 m_Advance();
-                out = std::make_shared<LogicalExpr>(Op::LogicalAnd, out,
-                                                    m_ParseSetOps());
+                out = m_Make<LogicalExpr>(Op::LogicalAnd, out, m_ParseSetOps());
             } else if (m_Get().is(Tokens::KeywordOr)) {
                 m_Advance();
-                out = std::make_shared<LogicalExpr>(Op::LogicalOr, out,
-                                                    m_ParseSetOps());
+                out = m_Make<LogicalExpr>(Op::LogicalOr, out, m_ParseSetOps());
             }
         }
         return out;
     }
-    bool m_IsSetOps(TokenHandler tok) {
+    bool m_IsSetOps(const TokenHandler& tok) const {
         return tok.is(Tokens::KeywordUnion, Tokens::KeywordIntersection);
     }
     ptr_t m_ParseSetOps() {
@@ -362,10 +468,10 @@ class Parser {
         while (not_eof() && m_IsSetOps(m_Get())) {
             if (m_Get().is(Tokens::KeywordUnion)) {
                 m_Advance();
-                out = std::make_shared<UnionExpr>(out, m_ParseSymbols());
+                out = m_Make<UnionExpr>(out, m_ParseSymbols());
             } else if (m_Get().is(Tokens::KeywordIntersection)) {
                 m_Advance();
-                out = std::make_shared<InterSectionExpr>(out, m_ParseSymbols());
+                out = m_Make<InterSectionExpr>(out, m_ParseSymbols());
             }
         }
         return out;
@@ -375,7 +481,7 @@ class Parser {
         while (not_eof() && m_Get().is(Tokens::Factorial)) {
             if (m_Get().is(Tokens::Factorial)) {
                 m_Advance();
-                out = std::make_shared<SymbolExpr>(out, Symbol::Factorial);
+                out = m_Make<SymbolExpr>(out, Symbol::Factorial);
             }
         }
         return out;
@@ -389,52 +495,51 @@ class Parser {
         ptr_t left_ = m_ParseFactor();  // since only numbers are valid
         m_CheckOrErr(m_Get().is(Tokens::Semicolon),
                      fmt::format("expected ';' for interval found '{}' instead",
-                                 m_Get().value));
+                                 m_Text(m_Get())));
         m_Advance();
         ptr_t right_ = m_ParseFactor();
         m_CheckOrErr(m_Get().is(Tokens::Rcbracket, Tokens::Lcbracket),
                      fmt::format("expected ']' or '[' after interval "
                                  "expression found '{}' instead",
-                                 m_Get().value));
+                                 m_Text(m_Get())));
         bool right_is_strict = m_Get().is(Tokens::Lcbracket);
         m_Advance();
-        return std::make_shared<IntervalExpr>(
-            IntervalHandler(left_, left_is_strict),
-            IntervalHandler(right_, right_is_strict));
+        return m_Make<IntervalExpr>(IntervalHandler(left_, left_is_strict),
+                                    IntervalHandler(right_, right_is_strict));
     }
     ptr_t m_ParseIntervalOrVm() {
         m_Advance();
-        std::vector<TokenHandler> subvec(m_Src.begin() + m_Pos, m_Src.end());
-        auto find_semi =
-            std::find_if(subvec.begin(), subvec.end(),
-                         [](auto& e) { return e.is(Tokens::Semicolon); });
-        if (find_semi != subvec.end()) {
+        // an interval has its ';' before the next '[' or ']'
+        bool is_interval =
+            not_eof() &&
+            m_Look[m_Pos].next_semi < m_Look[m_Pos].next_cbracket;
+        if (is_interval) {
             m_Advance(-1);
             return m_ParseInterval();
         } else {
             std::vector<ptr_t> elms = m_ParseSplitedInput(
                 Tokens::Rcbracket, Tokens::Comma, ",", "vector");
-            if ((elms.size() == 2) || (elms.size() == 3)) {
-                return std::make_shared<Vector>(elms);
+            // brackets in brackets are the rows of a matrix
+            bool has_rows = !elms.empty() &&
+                            (elms.front()->type() == AstType::Vector ||
+                             elms.front()->type() == AstType::Matrix);
+            if (!has_rows && ((elms.size() == 2) || (elms.size() == 3))) {
+                return m_Make<Vector>(elms);
             } else {
-                return std::make_shared<Matrix>(elms);
+                return m_Make<Matrix>(elms);
             }
         }
     }
     ptr_t m_ParseFactor() {
-        TokenHandler tok = m_Get();
+        const TokenHandler& tok = m_Get();
         if (tok.is(Tokens::Lparen)) {
             m_Advance();
             if (not_eof()) {
-                std::vector<TokenHandler> subvec(m_Src.begin() + m_Pos,
-                                                 m_Src.end());
-                auto find_cm =
-                    std::find_if(subvec.begin(), subvec.end(),
-                                 [](auto& t) { return t.is(Tokens::Comma); });
-                if (find_cm != subvec.end()) {
+                // a comma directly inside the parens makes it a point
+                if (m_Look[m_Pos - 1].has_comma) {
                     auto rhs = m_ParseSplitedInput(Tokens::Rparen,
                                                    Tokens::Comma, ",", "point");
-                    return std::make_shared<Point>(rhs);
+                    return m_Make<Point>(rhs);
                 } else {
                     ptr_t out = m_ParseComp();
                     m_CheckOrErr(m_Get().is(Tokens::Rparen), "invalid syntax");
@@ -448,37 +553,41 @@ class Parser {
             m_Advance();
             m_CheckOrErr(not_eof(), "unexpected eof");
             ptr_t temp = m_ParseComp();
-            m_CheckOrErr(m_Get().is(Tokens::AbsEnd),
-                         fmt::format("expected '|' found '{}'", m_Get().value));
+            m_CheckOrErr(
+                m_Get().is(Tokens::AbsEnd),
+                fmt::format("expected '|' found '{}'", m_Text(m_Get())));
             m_Advance();
-            return std::make_shared<SymbolExpr>(temp, Symbol::Abs);
+            return m_Make<SymbolExpr>(temp, Symbol::Abs);
         } else if (tok.is(Tokens::NormBegin)) {
             m_Advance();
             m_CheckOrErr(not_eof(), "unexpected eof");
             ptr_t temp = m_ParseComp();
             m_CheckOrErr(
                 m_Get().is(Tokens::NormEnd),
-                fmt::format("expected '||' found '{}'", m_Get().value));
+                fmt::format("expected '||' found '{}'", m_Text(m_Get())));
             m_Advance();
-            return std::make_shared<SymbolExpr>(temp, Symbol::Norm);
+            return m_Make<SymbolExpr>(temp, Symbol::Norm);
         } else if (tok.is(Tokens::Digit)) {
-            if (not_eof()) {
-                if (m_IsValidAfterNumber(m_Peek()) ||
-                    m_IsCompareToken(m_Peek()) || m_IsLogical(m_Peek())) {
-                    return std::make_shared<Number>(std::stold(m_GetDigit()));
-                } else {
-                    m_Err();
-                }
-            } else {
+            // the lexer already scanned the whole literal and its value
+            bool is_last = m_Pos + 1 >= m_Src.size();
+            if (is_last || m_IsValidAfterNumber(m_Peek()) ||
+                m_IsCompareToken(m_Peek()) || m_IsLogical(m_Peek())) {
                 m_Advance();
-                return std::make_shared<Number>(std::stod(tok.value));
+                // integers a long double rounds are read again exactly
+                std::string_view text = m_Text(tok);
+                if (!exact::integral(tok.num) &&
+                    text.find_first_not_of("0123456789'") == text.npos)
+                    return m_Make<Integer>(bigint::Int::parse(text));
+                return m_Make<Number>(tok.num);
+            } else {
+                m_Err();
             }
         } else if (tok.is(Tokens::Minus)) {
             if (not_eof()) {
                 m_Advance();
                 if (m_Get().is(Tokens::Lparen, Tokens::Identifier,
                                Tokens::Digit, Tokens::Boolean)) {
-                    return std::make_shared<NegativeExpr>(m_ParseFactor());
+                    return m_Make<NegativeExpr>(m_ParseFactor());
                     // much easier to handle expressions like `5-(-(-(-5)))`
                 } else {
                     m_Err();
@@ -489,19 +598,19 @@ class Parser {
         } else if (tok.is(Tokens::Identifier)) {
             if (m_Peek().is(Tokens::Assign)) {
                 m_Advance(2);  // skip the '='
-                std::string name = tok.value;
+                symbol_t name = tok.sym;
                 ptr_t body = m_ParseIdentAssign();
-                return std::make_shared<UserDefinedIdentifier>(name, body);
+                return m_Make<UserDefinedIdentifier>(name, body);
             } else if (m_Peek().is(Tokens::Lparen)) {
                 m_Advance(2);  // skip the '('
                 return m_ParseFunctionDefOrCall(tok);
             } else {
                 m_Advance();
-                return std::make_shared<Identifier>(tok.value);
+                return m_Make<Identifier>(tok.sym);
             }
         } else if (tok.is(Tokens::Boolean)) {
             m_Advance();
-            return std::make_shared<Boolean>(tok.value);
+            return m_Make<Boolean>(m_Text(tok));
         } else if (tok.is(Tokens::KeywordIf)) {
             m_Advance();
             if (m_Get().is(Tokens::Lparen)) {
@@ -510,7 +619,7 @@ class Parser {
                 if (m_Get().isNot(Tokens::Rparen)) {
                     m_Err(fmt::format(
                         "expected a closing ')' for 'if' found '{}'",
-                        m_Get().value));
+                        m_Text(m_Get())));
                 } else {
                     m_Advance();
                     if (!not_eof())
@@ -525,20 +634,20 @@ class Parser {
                         m_Advance();
                         stmt2 = m_ParseComp();
                     }
-                    return std::make_shared<IfExpr>(cond, stmt1, stmt2);
+                    return m_Make<IfExpr>(cond, stmt1, stmt2);
                 }
             } else {
                 m_Err(
                     fmt::format("expected a '(' after keyword 'if' found '{}'",
-                                m_Get().value));
+                                m_Text(m_Get())));
             }
         } else if (tok.is(Tokens::KeywordNull)) {
             m_Advance();
-            return std::make_shared<NullExpr>();  // literally just  a null
+            return m_Make<NullExpr>();  // literally just  a null
         } else if (tok.is(Tokens::KeywordNot)) {
             if (not_eof()) {
                 m_Advance();
-                return std::make_shared<NotExpr>(m_ParseComp());
+                return m_Make<NotExpr>(m_ParseComp());
             } else {
                 m_Err();
             }
@@ -549,12 +658,12 @@ class Parser {
             // in_special_context = true;
             std::vector<ptr_t> elms = m_ParseSetObj();
             // in_special_context = false;
-            ptr_t f_temp = std::make_shared<SetObject>(elms);
+            ptr_t f_temp = m_Make<SetObject>(elms);
             if (m_Get().is(Tokens::Lcbracket)) {
                 m_Advance();                  // skip '['
                 ptr_t idx = m_ParseFactor();  // parse the index
                 m_Advance();                  // skip ']'
-                return std::make_shared<SliceExpr>(f_temp, idx);
+                return m_Make<SliceExpr>(f_temp, idx);
             } else {
                 return f_temp;
             }
@@ -565,32 +674,72 @@ class Parser {
     void m_CheckOrErr(bool st, const std::string& m) {
         if (!st) m_Err(m);
     }
-    void m_Err() { m_Err("invalid syntax"); }
-    void m_Err(const std::string& msg) { m_ThrowErr("SyntaxError", msg); }
-    void m_ThrowErr(const std::string& err, const std::string& msg) {
-        this->ei.name = err;
+    [[noreturn]] void m_Err() { m_Err("invalid syntax"); }
+    [[noreturn]] void m_Err(const std::string& msg) {
+        m_ThrowErr(ErrorCode::SyntaxError, msg);
+    }
+    [[noreturn]] void m_ThrowErr(ErrorCode code, const std::string& msg) {
+        this->ei.code = code;
         this->ei.err = msg;
-        this->ei.linepos = m_Get().pos;
+        if (m_Src.empty()) {
+            this->ei.span = {0, 0};
+        } else {
+            const TokenHandler& tok = m_Get();
+            this->ei.span = {tok.pos, tok.pos + tok.len};
+        }
         throw ami::exceptions::BaseException(ei);
     }
 
    public:
+    // `str` and `file` are borrowed, they have to outlive the parser and
+    // the diagnostics it reports
     explicit Parser(const std::vector<TokenHandler>& _tok,
-                    const std::string& str, const std::string& file) {
-        this->ei =
-            ami::exceptions::ExceptionInterface{.file = file, .src = str};
-        if (_tok.size() > 0)
+                    std::string_view str, std::string_view file,
+                    ParseMode mode = ParseMode::Pratt)
+        : m_Mode(mode) {
+        this->ei = ami::exceptions::Diagnostic(ErrorCode::None, {}, file, str);
+        if (_tok.size() > 0) {
             m_Src = _tok;
-        else
-            m_ThrowErr("ParseError", "invalid input");
+            m_Index();
+        } else {
+            m_ThrowErr(ErrorCode::ParseError, "invalid input");
+        }
+    }
+    // parses the input statement by statement as it's pulled out of
+    // `stream`, see parse_next
+    Parser(TokenStream& stream, std::string_view file,
+           ParseMode mode = ParseMode::Pratt)
+        : m_Mode(mode), m_Stream(&stream) {
+        this->ei = ami::exceptions::Diagnostic(ErrorCode::None, {}, file, {});
+    }
+    ptr_t parse() {
+        m_Arena = std::make_shared<Arena>();
+        return m_Own(m_ParseComp());
+    }
+    // pulls the next statement out of the stream, returns nullptr once the
+    // stream is exhausted
+    ptr_t parse_next() {
+        m_Src.clear();
+        m_Pos = 0;
+        while (!m_Stream->eof()) {
+            TokenHandler tok = m_Stream->next();
+            if (tok.isNot(Tokens::Newline))
+                m_Src.push_back(tok);
+            else if (!m_Src.empty())
+                break;
+        }
+        if (m_Src.empty()) return nullptr;
+        m_Index();
+        this->ei.src = m_Stream->line();
+        return parse();
     }
-    ptr_t parse() { return m_ParseComp(); }
     std::vector<ptr_t> parsevec() {
         std::vector<ptr_t> exprs;
-        while (not_eof()) exprs.push_back(m_ParseComp());
+        m_Arena = std::make_shared<Arena>();
+        while (not_eof()) exprs.push_back(m_Own(m_ParseComp()));
         return exprs;
     }
-    ami::exceptions::ExceptionInterface get_ei() const { return this->ei; }
+    const ami::exceptions::Diagnostic& get_ei() const { return this->ei; }
 };
 
 }  // namespace ami
@@ -0,0 +1,240 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#include <immintrin.h>
+#define AMI_SCAN_SSE2 1
+#if defined(__GNUC__)
+#define AMI_SCAN_AVX2 1
+#endif
+#endif
+
+// vectorized scanning for the lexer, each function returns a pointer to the
+// first character in [begin, end) that doesn't belong to the run (or end).
+// the x86 kernels classify 16 (sse2) or 32 (avx2) bytes per iteration, avx2
+// is picked at runtime when the cpu supports it, other targets use the scalar
+// loops
+
+namespace ami {
+namespace scan {
+enum class CharClass { Digit, Ident, Space };
+namespace details {
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+inline bool is_ident(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+           is_digit(c);
+}
+inline bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+template <CharClass C>
+inline bool belongs(char c) {
+    if constexpr (C == CharClass::Digit)
+        return is_digit(c);
+    else if constexpr (C == CharClass::Ident)
+        return is_ident(c);
+    else
+        return is_space(c);
+}
+template <CharClass C>
+const char* scalar(const char* p, const char* end) {
+    while (p < end && belongs<C>(*p)) ++p;
+    return p;
+}
+inline unsigned ctz(std::uint32_t x) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctz(x));
+#else
+    unsigned n = 0;
+    while (!(x & 1u)) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+#ifdef AMI_SCAN_SSE2
+// bytes >= 0x80 are negative for the signed compares so they never match
+inline __m128i in_range(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+template <CharClass C>
+inline __m128i classify(__m128i v) {
+    if constexpr (C == CharClass::Digit) {
+        return in_range(v, '0', '9');
+    } else if constexpr (C == CharClass::Ident) {
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        return _mm_or_si128(
+            _mm_or_si128(in_range(v, '0', '9'), in_range(lower, 'a', 'z')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    } else {
+        return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                            in_range(v, '\t', '\r'));
+    }
+}
+template <CharClass C>
+const char* sse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        std::uint32_t miss =
+            ~static_cast<std::uint32_t>(_mm_movemask_epi8(classify<C>(v))) &
+            0xFFFFu;
+        if (miss) return p + ctz(miss);
+        p += 16;
+    }
+    return scalar<C>(p, end);
+}
+#endif
+#ifdef AMI_SCAN_AVX2
+__attribute__((target("avx2"))) inline __m256i in_range256(__m256i v, char lo,
+                                                           char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+template <CharClass C>
+__attribute__((target("avx2"))) inline __m256i classify256(__m256i v) {
+    if constexpr (C == CharClass::Digit) {
+        return in_range256(v, '0', '9');
+    } else if constexpr (C == CharClass::Ident) {
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        return _mm256_or_si256(_mm256_or_si256(in_range256(v, '0', '9'),
+                                               in_range256(lower, 'a', 'z')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    } else {
+        return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                               in_range256(v, '\t', '\r'));
+    }
+}
+template <CharClass C>
+__attribute__((target("avx2"))) const char* avx2(const char* p,
+                                                 const char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        std::uint32_t miss = ~static_cast<std::uint32_t>(
+            _mm256_movemask_epi8(classify256<C>(v)));
+        if (miss) return p + ctz(miss);
+        p += 32;
+    }
+    return sse2<C>(p, end);
+}
+inline bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+}  // namespace details
+template <CharClass C>
+const char* skip(const char* begin, const char* end) {
+    // not enough input left for a single vector load
+    if (end - begin < 16) return details::scalar<C>(begin, end);
+#if defined(AMI_SCAN_AVX2)
+    if (details::has_avx2()) return details::avx2<C>(begin, end);
+#endif
+#if defined(AMI_SCAN_SSE2)
+    return details::sse2<C>(begin, end);
+#else
+    return details::scalar<C>(begin, end);
+#endif
+}
+inline const char* skip_digits(const char* begin, const char* end) {
+    return skip<CharClass::Digit>(begin, end);
+}
+inline const char* skip_ident(const char* begin, const char* end) {
+    return skip<CharClass::Ident>(begin, end);
+}
+inline const char* skip_space(const char* begin, const char* end) {
+    return skip<CharClass::Space>(begin, end);
+}
+namespace details {
+// every power of ten up to 10^27 is exact in a long double (5^27 < 2^64)
+inline constexpr std::array<long double, 28> pow10 = [] {
+    std::array<long double, 28> out{};
+    long double p = 1;
+    for (auto& e : out) {
+        e = p;
+        p *= 10;
+    }
+    return out;
+}();
+// digits with `'` separators between them: 1'000'000
+template <class OnDigit>
+const char* digits(const char* p, const char* end, OnDigit&& on_digit) {
+    while (true) {
+        const char* run = skip_digits(p, end);
+        for (; p < run; ++p) on_digit(*p);
+        if (p + 1 < end && *p == '\'' && is_digit(p[1]))
+            ++p;
+        else
+            return p;
+    }
+}
+}  // namespace details
+// scans a whole numeric literal starting at `begin` (which must be a digit):
+// digits with optional `'` separators, a fraction and an exponent
+// (1'000.5e-3), stores its value in `out` and returns where it ends.
+// literals with up to 19 significant digits and a small enough exponent are
+// converted exactly with a single rounding (Clinger's fast path), anything
+// else goes through std::from_chars which is correctly rounded too
+inline const char* scan_number(const char* begin, const char* end,
+                               long double& out) {
+    std::uint64_t mantissa = 0;
+    int sig_digits = 0, exp10 = 0;
+    bool exact = true, separators = false;
+    auto integral = [&](char c) {
+        if (sig_digits < 19) {
+            mantissa = mantissa * 10 + (c - '0');
+            sig_digits += mantissa != 0;
+        } else {
+            ++exp10;
+            exact = false;
+        }
+    };
+    auto fractional = [&](char c) {
+        if (sig_digits < 19) {
+            mantissa = mantissa * 10 + (c - '0');
+            sig_digits += mantissa != 0;
+            --exp10;
+        } else {
+            exact = false;
+        }
+    };
+    const char* p = details::digits(begin, end, integral);
+    if (p + 1 < end && *p == '.' && details::is_digit(p[1]))
+        p = details::digits(p + 1, end, fractional);
+    if (p + 1 < end && *p == 'e') {
+        const char* q = p + 1;
+        bool negative = *q == '-';
+        if ((*q == '-' || *q == '+') && q + 1 < end) ++q;
+        if (details::is_digit(*q)) {
+            int e = 0;
+            for (; q < end && details::is_digit(*q); ++q)
+                e = e < 100'000 ? e * 10 + (*q - '0') : e;
+            exp10 += negative ? -e : e;
+            p = q;
+        }
+    }
+    for (const char* c = begin; c < p && !separators; ++c)
+        separators = *c == '\'';
+    if (exact && exp10 >= -27 && exp10 <= 27) {
+        long double m = static_cast<long double>(mantissa);
+        out = exp10 < 0 ? m / details::pow10[-exp10] : m * details::pow10[exp10];
+        return p;
+    }
+    std::string clean(begin, p);
+    if (separators)
+        clean.erase(std::remove(clean.begin(), clean.end(), '\''),
+                    clean.end());
+    auto res = std::from_chars(clean.data(), clean.data() + clean.size(), out);
+    if (res.ec == std::errc::result_out_of_range)
+        out = exp10 > 0 ? HUGE_VALL : 0.0L;
+    return p;
+}
+}  // namespace scan
+}  // namespace ami
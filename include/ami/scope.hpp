@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "symbols.hpp"
+#include "types.hpp"
+
+// global identifiers and functions defined by the user, indexed by symbol id,
+// and the arguments of the user function calls being evaluated
+
+namespace ami {
+namespace scope {
+static ami::iscope_t userdefined;
+static ami::fscope_t userdefined_functions;
+// nullptr when nothing is bound to `id`
+template <class T>
+T* lookup(std::vector<std::optional<T>>& scope, symbol_t id) {
+    return id < scope.size() && scope[id] ? &*scope[id] : nullptr;
+}
+template <class T>
+void assign(std::vector<std::optional<T>>& scope, symbol_t id, T value) {
+    if (id >= scope.size()) scope.resize(symbols::count());
+    scope[id] = std::move(value);
+}
+// the argument frames of the calls, all of them share one contiguous array
+// so a call only pushes its values and pops them when it returns. arguments
+// evaluated after the last frame are the ones of the next call
+class CallStack {
+    struct Frame {
+        std::size_t base, size;
+    };
+    std::vector<symbol_t> m_Ids;
+    std::vector<val_t> m_Values;
+    std::vector<Frame> m_Frames;
+
+   public:
+    // where the arguments of the next call start
+    std::size_t top() const { return m_Values.size(); }
+    void add(symbol_t id, val_t value) {
+        m_Ids.push_back(id);
+        m_Values.push_back(std::move(value));
+    }
+    const val_t* arguments(std::size_t base) const {
+        return m_Values.data() + base;
+    }
+    // number of frames, the index of the frame the next push makes
+    std::size_t depth() const { return m_Frames.size(); }
+    // makes the arguments added from `base` the frame of the current call
+    void push(std::size_t base) {
+        m_Frames.push_back({base, m_Values.size() - base});
+    }
+    // makes the arguments added after `frame` its values, a call in tail
+    // position reuses the frame of the call it ends. the calls made while
+    // evaluating the arguments have returned so `frame` is the last one
+    void replace(std::size_t frame) {
+        assert(frame + 1 == m_Frames.size());
+        const Frame& current = m_Frames[frame];
+        std::size_t next = current.base + current.size;
+        std::move(m_Values.begin() + next, m_Values.end(),
+                  m_Values.begin() + current.base);
+        unwind(next, frame + 1);
+    }
+    // drops the frames from `depth` and the arguments from `base`. frames
+    // are counted instead of compared by base, the frame of a call without
+    // arguments starts where the one of the next call does
+    void unwind(std::size_t base, std::size_t depth) {
+        if (depth < m_Frames.size()) m_Frames.resize(depth);
+        m_Ids.resize(base);
+        m_Values.erase(m_Values.begin() + base, m_Values.end());
+    }
+    // argument `i` of the current call, nullptr outside of a call
+    const val_t* slot(std::size_t i) const {
+        if (m_Frames.empty() || i >= m_Frames.back().size) return nullptr;
+        return &m_Values[m_Frames.back().base + i];
+    }
+    // identifiers aren't lexically scoped, the argument named `id` of the
+    // innermost call that has one
+    const val_t* find(symbol_t id) const {
+        for (auto it = m_Frames.rbegin(); it != m_Frames.rend(); ++it)
+            for (std::size_t i = it->base; i < it->base + it->size; ++i)
+                if (m_Ids[i] == id) return &m_Values[i];
+        return nullptr;
+    }
+    bool binds(symbol_t id) const { return find(id) != nullptr; }
+};
+}  // namespace scope
+}  // namespace ami
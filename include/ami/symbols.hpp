@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// global symbol interner, every distinct identifier gets a dense id the first
+// time the lexer sees it. the ast and the scopes work with ids so resolving a
+// name is an integer compare or an array index instead of string compares.
+// symbols are never removed, the table grows with every new identifier for
+// as long as the program runs and the scopes indexed by id grow with it, a
+// long repl session inventing names keeps all of them. the table is shared by
+// every thread so lookups take a shared lock and new symbols an exclusive one
+
+namespace ami {
+using symbol_t = std::uint32_t;
+namespace symbols {
+namespace details {
+struct Table {
+    // a deque never moves its elements so the views stay valid
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, symbol_t> ids;
+    std::shared_mutex mutex;
+};
+inline Table& table() {
+    static Table t;
+    return t;
+}
+}  // namespace details
+inline symbol_t intern(std::string_view name) {
+    auto& t = details::table();
+    {
+        std::shared_lock lock(t.mutex);
+        if (auto it = t.ids.find(name); it != t.ids.end()) return it->second;
+    }
+    std::unique_lock lock(t.mutex);
+    // another thread may have added it between the two locks
+    if (auto it = t.ids.find(name); it != t.ids.end()) return it->second;
+    auto id = static_cast<symbol_t>(t.names.size());
+    t.ids.emplace(t.names.emplace_back(name), id);
+    return id;
+}
+inline std::string_view name(symbol_t id) {
+    auto& t = details::table();
+    std::shared_lock lock(t.mutex);
+    return t.names[id];
+}
+// number of interned symbols, every id is below it
+inline std::size_t count() {
+    auto& t = details::table();
+    std::shared_lock lock(t.mutex);
+    return t.names.size();
+}
+}  // namespace symbols
+}  // namespace ami
@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+// lookup tables built at compile time, they replace the std::maps that used
+// to be filled during static initialization
+
+namespace ami {
+namespace tables {
+// maps every enumerator of `Enum` (which must be contiguous and start at 0)
+// to a name, lookup is a plain array index
+template <class Enum, std::size_t Count>
+class EnumNames {
+    std::array<std::string_view, Count> m_Names{};
+
+   public:
+    template <std::size_t N>
+    constexpr explicit EnumNames(
+        const std::pair<Enum, std::string_view> (&entries)[N]) {
+        for (std::size_t i = 0; i < N; ++i)
+            m_Names[static_cast<std::size_t>(entries[i].first)] =
+                entries[i].second;
+    }
+    constexpr std::string_view at(Enum e) const {
+        return m_Names[static_cast<std::size_t>(e)];
+    }
+};
+template <class Value>
+struct Entry {
+    std::string_view key;
+    Value value;
+};
+// string keyed table, sorted once at compile time and searched with a
+// binary search
+template <class Value, std::size_t N>
+class SortedTable {
+    std::array<Entry<Value>, N> m_Entries;
+
+   public:
+    constexpr explicit SortedTable(const Entry<Value> (&entries)[N])
+        : m_Entries(sorted(entries)) {}
+    static constexpr std::array<Entry<Value>, N> sorted(
+        const Entry<Value> (&entries)[N]) {
+        std::array<Entry<Value>, N> out{};
+        for (std::size_t i = 0; i < N; ++i) {
+            // insertion sort, std::sort isn't constexpr before C++20
+            std::size_t j = i;
+            while (j > 0 && entries[i].key < out[j - 1].key) {
+                out[j] = out[j - 1];
+                --j;
+            }
+            out[j] = entries[i];
+        }
+        return out;
+    }
+    // position of `key` in the table, N when it's missing
+    constexpr std::size_t index_of(std::string_view key) const {
+        std::size_t lo = 0, hi = N;
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (m_Entries[mid].key < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return (lo < N && m_Entries[lo].key == key) ? lo : N;
+    }
+    // returns nullptr when `key` isn't in the table
+    constexpr const Value* find(std::string_view key) const {
+        std::size_t i = index_of(key);
+        return i == N ? nullptr : &m_Entries[i].value;
+    }
+    constexpr bool contains(std::string_view key) const {
+        return index_of(key) != N;
+    }
+    constexpr const Entry<Value>& operator[](std::size_t i) const {
+        return m_Entries[i];
+    }
+    constexpr std::size_t size() const { return N; }
+};
+// perfect hash over a small fixed set of words, `hash` must map every word to
+// a distinct slot or the table fails to build at compile time
+template <class Value, std::size_t Slots, class Hash>
+class PerfectHash {
+    std::array<Entry<Value>, Slots> m_Slots{};
+    Value m_Default;
+
+   public:
+    template <std::size_t N>
+    constexpr PerfectHash(const Entry<Value> (&entries)[N], Value def)
+        : m_Default(def) {
+        for (std::size_t i = 0; i < Slots; ++i) m_Slots[i].value = def;
+        for (std::size_t i = 0; i < N; ++i) {
+            auto& slot = m_Slots[Hash{}(entries[i].key) % Slots];
+            if (!slot.key.empty())
+                throw std::logic_error("perfect hash collision");
+            slot = entries[i];
+        }
+    }
+    constexpr Value find(std::string_view key) const {
+        if (key.empty()) return m_Default;
+        const auto& slot = m_Slots[Hash{}(key) % Slots];
+        return slot.key == key ? slot.value : m_Default;
+    }
+};
+}  // namespace tables
+}  // namespace ami
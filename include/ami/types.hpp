@@ -1,4 +1,6 @@
 #include <memory>
+#include <optional>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -7,9 +9,10 @@
 namespace ami {
 using val_t = std::variant<Number, Boolean, NullExpr, IntervalExpr, UnionExpr,
                            InterSectionExpr, SetObject, Vector, Matrix, Point,
-                           std::string>;
+                           std::string, Integer, Fraction>;
 using arg_t = std::vector<val_t>;
 using ptr_t = std::shared_ptr<Expr>;
-using iscope_t = std::map<std::string, val_t>;
-using fscope_t = std::map<std::string, Function>;
+// global scopes are indexed by symbol id, see scope.hpp
+using iscope_t = std::vector<std::optional<val_t>>;
+using fscope_t = std::vector<std::optional<Function>>;
 }  // namespace ami
@@ -0,0 +1,579 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "exact.hpp"
+#include "flat.hpp"
+#include "interpreter.hpp"
+#include "types.hpp"
+
+#if defined(__GNUC__)
+#define AMI_VM_COMPUTED_GOTO 1
+#endif
+
+// bytecode compiler and stack machine for the scalar part of the language
+// (the same as flat.hpp) plus calls to user functions, whose bodies are
+// compiled the first time they're called. the machine keeps its own call
+// frames so a recursive function runs in one dispatch loop instead of nested
+// visit calls, with computed goto dispatch when the compiler supports it.
+// when the machine meets something it doesn't cover it gives up and the
+// expression is evaluated again by the Interpreter, that's safe because
+// nothing it runs has side effects
+
+namespace ami {
+namespace vm {
+enum class OpCode : std::uint8_t {
+    Number,  // arg: index in Chunk::numbers
+    Boolean,  // arg: 0 or 1
+    Null,
+    Arg,   // arg: parameter slot of the current call
+    Name,  // arg: symbol id, looked up in the callers' frames then globally
+    Negative,
+    Not,
+    Abs,
+    Factorial,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Pow,
+    Mod,
+    Greater,
+    GreaterOrEqual,
+    Less,
+    LessOrEqual,
+    Equals,
+    NotEquals,
+    And,
+    Or,
+    Builtin,      // arg: index in Chunk::builtins
+    Call,         // arg: index in Chunk::calls
+    JumpIfFalse,  // pops the condition, arg: target
+    Jump,         // arg: target
+    Return  // keep it last, see Machine::run
+};
+struct Instr {
+    OpCode op;
+    std::uint32_t arg;
+};
+struct Call {
+    symbol_t id;
+    std::uint32_t args_count;
+};
+struct Chunk {
+    std::vector<Instr> code;
+    std::vector<long double> numbers;
+    std::vector<const builtins::details::FunctionHandler*> builtins;
+    std::vector<Call> calls;
+    std::vector<symbol_t> params;  // parameter ids by slot
+};
+namespace details {
+class Compiler {
+    Chunk m_Chunk;
+    std::uint32_t m_Next() const {
+        return static_cast<std::uint32_t>(m_Chunk.code.size());
+    }
+    void m_Add(OpCode op, std::uint32_t arg = 0) {
+        m_Chunk.code.push_back({op, arg});
+    }
+    static std::optional<OpCode> m_Arith(Op op) {
+        switch (op) {
+            case Op::Plus:
+                return OpCode::Add;
+            case Op::Minus:
+                return OpCode::Sub;
+            case Op::Mult:
+                return OpCode::Mul;
+            case Op::Div:
+                return OpCode::Div;
+            case Op::Pow:
+                return OpCode::Pow;
+            case Op::Mod:
+                return OpCode::Mod;
+            default:
+                return std::nullopt;
+        }
+    }
+    static std::optional<OpCode> m_Compare(Op op) {
+        switch (op) {
+            case Op::Greater:
+                return OpCode::Greater;
+            case Op::GreaterOrEqual:
+                return OpCode::GreaterOrEqual;
+            case Op::Less:
+                return OpCode::Less;
+            case Op::LessOrEqual:
+                return OpCode::LessOrEqual;
+            case Op::Equals:
+                return OpCode::Equals;
+            case Op::NotEquals:
+                return OpCode::NotEquals;
+            default:
+                return std::nullopt;
+        }
+    }
+    static std::optional<OpCode> m_Logical(Op op) {
+        switch (op) {
+            case Op::LogicalAnd:
+                return OpCode::And;
+            case Op::LogicalOr:
+                return OpCode::Or;
+            default:
+                return std::nullopt;
+        }
+    }
+    bool m_Emit(const Expr* e) {
+        switch (e->type()) {
+            case AstType::Number:
+                m_Add(OpCode::Number,
+                      static_cast<std::uint32_t>(m_Chunk.numbers.size()));
+                m_Chunk.numbers.push_back(static_cast<const Number*>(e)->val);
+                return true;
+            case AstType::Boolean:
+                m_Add(OpCode::Boolean, static_cast<const Boolean*>(e)->val);
+                return true;
+            case AstType::NullExpr:
+                m_Add(OpCode::Null);
+                return true;
+            case AstType::Identifier:
+                m_Ident(static_cast<const Identifier*>(e)->id);
+                return true;
+            case AstType::NegativeExpr:
+                return m_Unary(OpCode::Negative,
+                               static_cast<const NegativeExpr*>(e)->value);
+            case AstType::NotExpr:
+                return m_Unary(OpCode::Not,
+                               static_cast<const NotExpr*>(e)->value);
+            case AstType::BinaryOp: {
+                auto* b = static_cast<const BinaryOpExpr*>(e);
+                return m_Binary(m_Arith(b->op), b->lhs, b->rhs);
+            }
+            case AstType::Comparison: {
+                auto* c = static_cast<const Comparison*>(e);
+                return m_Binary(m_Compare(c->op), c->lhs, c->rhs);
+            }
+            case AstType::LogicalExpr: {
+                auto* l = static_cast<const LogicalExpr*>(e);
+                return m_Binary(m_Logical(l->op), l->lhs, l->rhs);
+            }
+            case AstType::Symbol: {
+                auto* s = static_cast<const SymbolExpr*>(e);
+                if (s->symbol == Symbol::Norm) return false;
+                return m_Unary(s->symbol == Symbol::Abs ? OpCode::Abs
+                                                        : OpCode::Factorial,
+                               s->value);
+            }
+            case AstType::FunctionCall:
+                return m_Call(static_cast<const FunctionCall*>(e));
+            case AstType::IfExpr:
+                return m_If(static_cast<const IfExpr*>(e));
+            default:
+                return false;
+        }
+    }
+    void m_Ident(symbol_t id) {
+        // arguments of the current call come first, like in m_VisitIdent
+        const auto& params = m_Chunk.params;
+        auto it = std::find(params.begin(), params.end(), id);
+        if (it != params.end())
+            m_Add(OpCode::Arg, static_cast<std::uint32_t>(it - params.begin()));
+        else
+            m_Add(OpCode::Name, id);
+    }
+    bool m_Unary(OpCode op, const ptr_t& value) {
+        if (!m_Emit(value.get())) return false;
+        m_Add(op);
+        return true;
+    }
+    bool m_Binary(std::optional<OpCode> op, const ptr_t& lhs,
+                  const ptr_t& rhs) {
+        if (!op || !m_Emit(lhs.get()) || !m_Emit(rhs.get())) return false;
+        m_Add(*op);
+        return true;
+    }
+    bool m_Call(const FunctionCall* fc) {
+        const auto* handler = builtins::function(fc->id);
+        // impure builtins can't be called again when the Interpreter takes
+        // over, a wrong number of arguments is an error it reports
+        if (handler != nullptr &&
+            (!handler->pure || handler->args_count != fc->arguments.size()))
+            return false;
+        for (auto& arg : fc->arguments)
+            if (!m_Emit(arg.get())) return false;
+        if (handler != nullptr) {
+            m_Add(OpCode::Builtin,
+                  static_cast<std::uint32_t>(m_Chunk.builtins.size()));
+            m_Chunk.builtins.push_back(handler);
+        } else {
+            // user functions are looked up when they're called, they can be
+            // defined after this one
+            m_Add(OpCode::Call,
+                  static_cast<std::uint32_t>(m_Chunk.calls.size()));
+            m_Chunk.calls.push_back(
+                Call{fc->id, static_cast<std::uint32_t>(fc->arguments.size())});
+        }
+        return true;
+    }
+    // cond JumpIfFalse body Jump else, only one of the two parts runs
+    bool m_If(const IfExpr* iexpr) {
+        if (!m_Emit(iexpr->cond.get())) return false;
+        std::uint32_t branch = m_Next();
+        m_Add(OpCode::JumpIfFalse);
+        if (!m_Emit(iexpr->body.get())) return false;
+        std::uint32_t skip = m_Next();
+        m_Add(OpCode::Jump);
+        m_Chunk.code[branch].arg = m_Next();
+        if (iexpr->elsestmt != nullptr) {
+            if (!m_Emit(iexpr->elsestmt.get())) return false;
+        } else {
+            m_Add(OpCode::Null);
+        }
+        m_Chunk.code[skip].arg = m_Next();
+        return true;
+    }
+
+   public:
+    std::optional<Chunk> build(const Expr* root, std::vector<symbol_t> params) {
+        m_Chunk.params = std::move(params);
+        if (!m_Emit(root)) return std::nullopt;
+        m_Add(OpCode::Return);
+        return std::move(m_Chunk);
+    }
+};
+}  // namespace details
+// bytecode of `root` with `params` in the first argument slots, null when it
+// uses parts of the language the machine doesn't cover
+inline std::shared_ptr<const Chunk> compile(const Expr* root,
+                                            std::vector<symbol_t> params = {}) {
+    auto chunk = details::Compiler{}.build(root, std::move(params));
+    if (!chunk) return nullptr;
+    return std::make_shared<const Chunk>(*std::move(chunk));
+}
+// the bytecode of `f`'s body, compiled on the first call
+inline const Chunk* code(Function& f) {
+    if (!f.compiled) {
+        f.compiled = true;
+        std::vector<symbol_t> params;
+        params.reserve(f.arguments.size());
+        for (auto& arg : f.arguments)
+            params.push_back(static_cast<const Identifier*>(arg.get())->id);
+        f.code = compile(f.body.get(), std::move(params));
+    }
+    return f.code.get();
+}
+class Machine {
+    using Value = flat::details::Value;
+    using Type = Value::Type;
+    struct Frame {
+        const Chunk* chunk;
+        const Instr* ret;  // where the caller resumes
+        std::size_t base;  // stack index of the first argument
+    };
+    // deeper recursion is left to the Interpreter which reports it
+    static constexpr std::size_t max_depth = 3'000;
+    std::vector<Value> m_Stack;
+    std::vector<Frame> m_Frames;
+    arg_t m_Args;  // reused by every builtin call
+    static bool m_Numbers(const Value& lhs, const Value& rhs) {
+        return lhs.type == Type::Number && rhs.type == Type::Number;
+    }
+    // numbers and booleans compare with each other, null doesn't
+    static bool m_Scalars(const Value& lhs, const Value& rhs) {
+        return lhs.type != Type::Null && rhs.type != Type::Null;
+    }
+    static Value m_Bool(bool b) {
+        return {Type::Boolean, static_cast<long double>(b)};
+    }
+    Value m_Pop() {
+        Value out = m_Stack.back();
+        m_Stack.pop_back();
+        return out;
+    }
+    // identifiers bound by the callers' frames, then constants and globals
+    std::optional<Value> m_Lookup(symbol_t id) const {
+        for (auto f = m_Frames.rbegin(); f != m_Frames.rend(); ++f) {
+            const auto& params = f->chunk->params;
+            for (std::size_t k = 0; k < params.size(); ++k)
+                if (params[k] == id) return m_Stack[f->base + k];
+        }
+        if (const long double* c = builtins::constant(id))
+            return Value{Type::Number, *c};
+        if (val_t* v = scope::lookup(scope::userdefined, id))
+            return flat::details::from_val(*v);
+        return std::nullopt;
+    }
+
+   public:
+    // runs `main`, nothing when it reaches something the Interpreter has to
+    // evaluate or report
+    std::optional<val_t> run(const Chunk& main) {
+        m_Stack.clear();
+        m_Frames.clear();
+        m_Frames.push_back(Frame{&main, nullptr, 0});
+        const Chunk* chunk = &main;
+        const Instr* ip = main.code.data();
+        std::size_t base = 0;
+#ifdef AMI_VM_COMPUTED_GOTO
+        // in the order of OpCode
+        static void* const labels[] = {
+            &&op_Number,         &&op_Boolean,   &&op_Null,
+            &&op_Arg,            &&op_Name,      &&op_Negative,
+            &&op_Not,            &&op_Abs,       &&op_Factorial,
+            &&op_Add,            &&op_Sub,       &&op_Mul,
+            &&op_Div,            &&op_Pow,       &&op_Mod,
+            &&op_Greater,        &&op_GreaterOrEqual,
+            &&op_Less,           &&op_LessOrEqual,
+            &&op_Equals,         &&op_NotEquals, &&op_And,
+            &&op_Or,             &&op_Builtin,   &&op_Call,
+            &&op_JumpIfFalse,    &&op_Jump,      &&op_Return};
+        static_assert(sizeof(labels) / sizeof(*labels) ==
+                      static_cast<std::size_t>(OpCode::Return) + 1);
+#define AMI_VM_CASE(name) op_##name:
+#define AMI_VM_DISPATCH() goto* labels[static_cast<std::size_t>(ip->op)]
+        AMI_VM_DISPATCH();
+#else
+#define AMI_VM_CASE(name) case OpCode::name:
+#define AMI_VM_DISPATCH() continue
+        for (;;) switch (ip->op) {
+#endif
+#define AMI_VM_NEXT() \
+    ++ip;             \
+    AMI_VM_DISPATCH()
+        AMI_VM_CASE(Number) {
+            m_Stack.push_back({Type::Number, chunk->numbers[ip->arg]});
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Boolean) {
+            m_Stack.push_back(m_Bool(ip->arg != 0));
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Null) {
+            m_Stack.push_back({Type::Null, 0});
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Arg) {
+            Value v = m_Stack[base + ip->arg];
+            m_Stack.push_back(v);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Name) {
+            auto v = m_Lookup(ip->arg);
+            if (!v) return std::nullopt;
+            m_Stack.push_back(*v);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Negative) {
+            Value& v = m_Stack.back();
+            if (v.type != Type::Number) return std::nullopt;
+            v.num = -v.num;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Not) {
+            Value& v = m_Stack.back();
+            v = m_Bool(v.num == 0);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Abs) {
+            Value& v = m_Stack.back();
+            if (v.type != Type::Number) return std::nullopt;
+            v.num = std::abs(v.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Factorial) {
+            Value& v = m_Stack.back();
+            if (v.type != Type::Number) return std::nullopt;
+            // past 20! they're an Integer
+            if (exact::integral(v.num) && v.num > 20) return std::nullopt;
+            long double out = 1;
+            if (std::isfinite(v.num) && (v.num <= 1e7)) {
+                for (long double k = 1; k <= v.num; ++k) out *= k;
+            } else {
+                out = INFINITY;
+            }
+            v.num = out;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Add) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Numbers(lhs, rhs)) return std::nullopt;
+            long double l = lhs.num;
+            lhs.num += rhs.num;
+            if (exact::inexact(l, rhs.num, lhs.num)) return std::nullopt;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Sub) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Numbers(lhs, rhs)) return std::nullopt;
+            long double l = lhs.num;
+            lhs.num -= rhs.num;
+            if (exact::inexact(l, rhs.num, lhs.num)) return std::nullopt;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Mul) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Numbers(lhs, rhs)) return std::nullopt;
+            long double l = lhs.num;
+            lhs.num *= rhs.num;
+            if (exact::inexact(l, rhs.num, lhs.num)) return std::nullopt;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Div) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Numbers(lhs, rhs)) return std::nullopt;
+            lhs.num /= rhs.num;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Pow) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Numbers(lhs, rhs)) return std::nullopt;
+            long double l = lhs.num;
+            lhs.num = std::pow(lhs.num, rhs.num);
+            if (exact::inexact_power(l, rhs.num, lhs.num)) return std::nullopt;
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Mod) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Numbers(lhs, rhs)) return std::nullopt;
+            lhs.num = std::fmod(lhs.num, rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Greater) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num > rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(GreaterOrEqual) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num >= rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Less) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num < rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(LessOrEqual) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num <= rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Equals) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num == rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(NotEquals) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num != rhs.num);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(And) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num != 0 && rhs.num != 0);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Or) {
+            Value rhs = m_Pop();
+            Value& lhs = m_Stack.back();
+            if (!m_Scalars(lhs, rhs)) return std::nullopt;
+            lhs = m_Bool(lhs.num != 0 || rhs.num != 0);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Builtin) {
+            const auto* handler = chunk->builtins[ip->arg];
+            std::size_t first = m_Stack.size() - handler->args_count;
+            m_Args.clear();
+            for (std::size_t k = first; k < m_Stack.size(); ++k) {
+                // builtins only take numbers
+                if (m_Stack[k].type != Type::Number) return std::nullopt;
+                m_Args.push_back(Number(m_Stack[k].num));
+            }
+            m_Stack.resize(first);
+            auto out = flat::details::from_val(handler->callback(m_Args));
+            if (!out) return std::nullopt;
+            m_Stack.push_back(*out);
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Call) {
+            const Call& call = chunk->calls[ip->arg];
+            Function* f = scope::lookup(scope::userdefined_functions, call.id);
+            if (f == nullptr || f->arguments.size() != call.args_count ||
+                m_Frames.size() >= max_depth)
+                return std::nullopt;
+            const Chunk* callee = code(*f);
+            if (callee == nullptr) return std::nullopt;
+            // the arguments already on the stack are the callee's slots
+            base = m_Stack.size() - call.args_count;
+            m_Frames.push_back(Frame{callee, ip + 1, base});
+            chunk = callee;
+            ip = callee->code.data();
+            AMI_VM_DISPATCH();
+        }
+        AMI_VM_CASE(JumpIfFalse) {
+            Value cond = m_Pop();
+            if (cond.type == Type::Null || cond.num == 0) {
+                ip = chunk->code.data() + ip->arg;
+                AMI_VM_DISPATCH();
+            }
+            AMI_VM_NEXT();
+        }
+        AMI_VM_CASE(Jump) {
+            ip = chunk->code.data() + ip->arg;
+            AMI_VM_DISPATCH();
+        }
+        AMI_VM_CASE(Return) {
+            Frame done = m_Frames.back();
+            m_Frames.pop_back();
+            Value out = m_Stack.back();
+            if (m_Frames.empty()) return flat::details::to_val(out);
+            m_Stack.resize(done.base);
+            m_Stack.push_back(out);
+            chunk = m_Frames.back().chunk;
+            base = m_Frames.back().base;
+            ip = done.ret;
+            AMI_VM_DISPATCH();
+        }
+#ifndef AMI_VM_COMPUTED_GOTO
+        }
+#endif
+#undef AMI_VM_NEXT
+#undef AMI_VM_DISPATCH
+#undef AMI_VM_CASE
+    }
+};
+// evaluates `root` on the machine when it can, with `inter` otherwise
+inline val_t eval(const ptr_t& root, Interpreter& inter) {
+    if (auto chunk = compile(root.get()))
+        if (auto value = Machine{}.run(*chunk)) return *std::move(value);
+    return inter.visit(root);
+}
+}  // namespace vm
+}  // namespace ami
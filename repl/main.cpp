@@ -30,6 +30,12 @@ int main() {
                 std::cout << _get->to_str() << '\n';
             else if (auto _get = std::get_if<ami::Vector>(&output))
                 std::cout << _get->to_str() << '\n';
+            else if (auto _get = std::get_if<ami::Matrix>(&output))
+                std::cout << _get->to_str() << '\n';
+            else if (auto _get = std::get_if<ami::Integer>(&output))
+                std::cout << _get->to_str() << '\n';
+            else if (auto _get = std::get_if<ami::Fraction>(&output))
+                std::cout << _get->to_str() << '\n';
         } catch (const ami::exceptions::BaseException& x) {
             std::cout << "err: " << x.what() << '\n';
         }
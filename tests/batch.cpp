@@ -0,0 +1,72 @@
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+
+// every row of a batch has the value try_eval gives the expression with the
+// columns assigned to the row's inputs, with the AVX2 kernels and with the
+// scalar ones. the row count is neither a multiple of 4 nor of batch::chunk
+// so both the vector loops and their tails run
+
+static const double not_a_number = std::numeric_limits<double>::quiet_NaN();
+static const std::vector<double> inputs{-2.5, -1, 0, 0.5, 1, 2, 3, 7, 10,
+                                        not_a_number};
+static const std::size_t rows = 3 * ami::batch::chunk + 235;
+
+static double expected(const std::string& expression, double x, double y) {
+    ami::scope::assign(ami::scope::userdefined, ami::symbols::intern("x"),
+                       ami::val_t(ami::Number(x)));
+    ami::scope::assign(ami::scope::userdefined, ami::symbols::intern("y"),
+                       ami::val_t(ami::Number(y)));
+    ami::val_t v = check::eval(expression);
+    if (auto* b = std::get_if<ami::Boolean>(&v)) return b->val;
+    return static_cast<double>(*ami::exact::to_long_double(v));
+}
+static bool same(double a, double b) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    if (a == b) return true;
+    // the Interpreter computes in long doubles
+    return std::fabs(a - b) <= 1e-12 * std::max(std::fabs(a), std::fabs(b));
+}
+static void compare(const std::string& expression) {
+    std::vector<double> x(rows), y(rows), out(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        x[i] = inputs[i % inputs.size()];
+        y[i] = inputs[(i / inputs.size() + i) % inputs.size()];
+    }
+    for (bool simd : {true, false}) {
+        ami::batch::simd = simd;
+        auto program = ami::batch::compile(expression, {"x", "y"});
+        if (!program) {
+            std::fprintf(stderr, "%s: %s\n", expression.c_str(),
+                         program.error().format().c_str());
+            ++check::failures;
+            continue;
+        }
+        program->run({x.data(), y.data()}, rows, out.data());
+        for (std::size_t i = 0; i < rows; ++i) {
+            double want = expected(expression, x[i], y[i]);
+            if (same(out[i], want)) continue;
+            std::fprintf(stderr, "%s with x=%g y=%g%s: expected %g, got %g\n",
+                         expression.c_str(), x[i], y[i],
+                         simd ? "" : " (scalar)", want, out[i]);
+            ++check::failures;
+            break;
+        }
+    }
+    ami::batch::simd = true;
+}
+
+int main() {
+    for (const char* expression :
+         {"x + y * 2 - x / y", "x % y", "x ^ 2 - y", "-x", "|x|",
+          "sqrt(|x|)", "floor(x) + ceil(y) + round(x)", "x > y", "x >= y",
+          "x < y", "x <= y", "x == y", "x != y", "x and y", "x or y",
+          "not (x > y)", "min(x, y)", "max(x, y)", "gcd(x, y)",
+          "floor(|x|)!", "if (x > y) x else y", "if (x) 1 else 2",
+          "if (x < 1 and y) sin(x) else log(|y|)"})
+        compare(expression);
+    return check::done();
+}
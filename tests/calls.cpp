@@ -0,0 +1,27 @@
+#include "check.hpp"
+
+int main() {
+    check::equal("double(x) -> x * 2", "defined function 'double'");
+    check::equal("double(21)", "42");
+    check::equal("sum(n, acc) -> if (n == 0) acc else sum(n - 1, acc + n)",
+                 "defined function 'sum'");
+    check::equal("sum(100, 0)", "5050");
+
+    // a call without arguments keeps its frame when the calls it makes,
+    // whose frames start at the same place, return
+    check::eval("g(x) -> random(0, 1)");
+    check::eval("f() -> if (g(1) > 0.9) 1 else f()");
+    check::equal("f()", "1");
+    check::eval("one() -> 1");
+    check::eval("h(x) -> one() + x");
+    check::equal("h(2)", "3");
+
+    // the tail loop reuses the frame of its call once the calls made by the
+    // new arguments have returned
+    check::eval(
+        "count(n, acc) -> if (n == 0) acc else count(n - 1, acc + one())");
+    check::equal("count(5000, 0)", "5000");
+    check::eval("down(n) -> if (n == 0) h(0) else down(double(n) - n - 1)");
+    check::equal("down(10)", "1");
+    return check::done();
+}
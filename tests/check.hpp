@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <ami/ami.hpp>
+
+// the tests evaluate statements one after the other like the repl does, a
+// failed check prints the statement and exits with an error
+
+namespace check {
+inline int failures = 0;
+inline ami::val_t eval(const std::string& expression) {
+    auto result = ami::try_eval(expression);
+    if (!result) {
+        std::fprintf(stderr, "%s: %s\n", expression.c_str(),
+                     result.error().format().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    return std::move(*result);
+}
+// the value as the repl prints it
+inline std::string str(ami::val_t value) {
+    return std::visit(
+        [](auto& v) -> std::string {
+            if constexpr (std::is_same_v<std::decay_t<decltype(v)>,
+                                         std::string>)
+                return v;
+            else
+                return v.to_str();
+        },
+        value);
+}
+inline void equal(const std::string& expression, const std::string& expected) {
+    std::string got = str(eval(expression));
+    if (got == expected) return;
+    std::fprintf(stderr, "%s: expected %s, got %s\n", expression.c_str(),
+                 expected.c_str(), got.c_str());
+    ++failures;
+}
+// `expression` gives a diagnostic instead of a value
+inline void fails(const std::string& expression) {
+    if (!ami::try_eval(expression)) return;
+    std::fprintf(stderr, "%s: expected an error\n", expression.c_str());
+    ++failures;
+}
+inline void expect(bool ok, const char* what) {
+    if (ok) return;
+    std::fprintf(stderr, "expected %s\n", what);
+    ++failures;
+}
+inline int done() { return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE; }
+}  // namespace check
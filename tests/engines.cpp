@@ -0,0 +1,55 @@
+#include <string>
+
+#include "check.hpp"
+
+// the bytecode machine and the flat walk give the values the Interpreter
+// does, on what they run themselves and on what they leave to it
+
+static std::string interpret(const ami::ptr_t& root) {
+    ami::Interpreter inter(ami::exceptions::Diagnostic{});
+    return check::str(inter.visit(root));
+}
+// `scalar` when the machine and the flat walk run `expression` without the
+// Interpreter
+static void compare(const std::string& expression, bool scalar) {
+    ami::Parser parser(ami::Lexer(expression).lex(), expression, "engines");
+    ami::ptr_t root = parser.parse();
+    std::string want = interpret(root);
+    ami::Interpreter inter(parser.get_ei());
+    std::string vm = check::str(ami::vm::eval(root, inter));
+    std::string flat = check::str(ami::flat::eval(root, inter));
+    if (vm != want || flat != want) {
+        std::fprintf(stderr, "%s: %s, the vm gives %s and the flat walk %s\n",
+                     expression.c_str(), want.c_str(), vm.c_str(),
+                     flat.c_str());
+        ++check::failures;
+    }
+    auto chunk = ami::vm::compile(root.get());
+    bool on_machine = chunk && ami::vm::Machine{}.run(*chunk);
+    if (on_machine != scalar) {
+        std::fprintf(stderr, "%s: expected %s\n", expression.c_str(),
+                     scalar ? "to run on the machine"
+                            : "to be left to the Interpreter");
+        ++check::failures;
+    }
+}
+
+int main() {
+    check::eval("x = 1.5");
+    check::eval("fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)");
+    check::eval("fact(n) -> if (n < 2) 1 else n * fact(n - 1)");
+
+    for (const char* expression :
+         {"1 + 2 * 3 - 4 / 8", "2 ^ 10 % 7", "-x * 3", "|0 - 5| + 4!",
+          "x > 1 and x <= 2 or false", "1 == 1 != false",
+          "if (x < 1) 10 else 20", "sqrt(16) + min(2, 3) + max(x, 1)",
+          "fib(15)", "fact(20)"})
+        compare(expression, true);
+
+    // past the mantissa, exact fractions, vectors, sets and intervals
+    for (const char* expression :
+         {"fact(25)", "2 ^ 70 + 1", "3 ^ -1", "fib(10) + ||[3, 4]||",
+          "[1, 2] * 3", "{3, 1, 2}", "2 in [0; 5]", "1e30 == 10 ^ 30"})
+        compare(expression, false);
+    return check::done();
+}
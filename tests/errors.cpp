@@ -0,0 +1,11 @@
+#include "check.hpp"
+
+int main() {
+    // errors are returned as diagnostics, the ones raised by builtins and
+    // by the standard library too
+    check::fails("undefined_function(1)");
+    check::fails("1 +");
+    check::fails("sqrt([1, 2])");
+    check::fails("sqrt(1, 2)");
+    return check::done();
+}
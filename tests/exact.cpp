@@ -0,0 +1,33 @@
+#include "check.hpp"
+
+int main() {
+    check::equal("2^100", "1267650600228229401496703205376");
+    check::equal("2^100 / 3 * 3 == 2^100", "true");
+
+    // a long double past the mantissa is compared by the value it holds
+    check::equal("1e30 == 10^30", "false");
+    check::equal("1e30 != 10^30", "true");
+    check::equal("2^70 == 2^70 * 1", "true");
+    check::equal("2^70 + 1 > 2^70", "true");
+
+    // negative powers of integers are exact like divisions of them
+    check::equal("3^-1", "1/3");
+    check::equal("3^-1 * 3", "1");
+    check::equal("(3^50)^-1", "1/717897987691852588770249");
+    check::equal("(3^50)^-1 * 3^50", "1");
+    // unless a long double holds them
+    check::equal("2^-1", "0.5");
+    check::equal("(2^70)^-1 * 2^70", "1");
+    check::equal("(-3)^-2", "1/9");
+
+    // and so is the rounding of fractions
+    check::equal("floor(2^100 / 3)", "422550200076076467165567735125");
+    check::equal("ceil(2^100 / 3)", "422550200076076467165567735126");
+    check::equal("round(2^100 / 3)", "422550200076076467165567735125");
+    check::equal("floor(-(2^100 / 3))", "-422550200076076467165567735126");
+    check::equal("ceil(-(2^100 / 3))", "-422550200076076467165567735125");
+    check::equal("round((2^70 + 1) / 2)", "590295810358705651713");
+    check::equal("round(-(2^70 + 1) / 2)", "-590295810358705651713");
+    check::equal("floor((2^70 + 1) / 2)", "590295810358705651712");
+    return check::done();
+}
@@ -0,0 +1,119 @@
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+
+// the script gives the same values with the jit as without it, the calls
+// cover the paths of the machine code and the cases it leaves to the
+// Interpreter
+
+static const std::vector<std::string> script{
+    "sq(x) -> x * x",
+    "sq(3)",
+    "sq(-2.5)",
+    // self calls
+    "fact(n) -> if (n < 2) 1 else n * fact(n - 1)",
+    "fact(10)",
+    "fact(20)",
+    // past exact::limit, an Integer
+    "fact(25)",
+    "fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)",
+    "fib(20)",
+    "mul(x, y) -> x * y",
+    "mul(2^40, 2^40)",
+    "big(x) -> x ^ 70",
+    "big(2)",
+    "big(1.5)",
+    // calls to other user functions and to builtins
+    "twice(x) -> sq(x) + sq(x + 1)",
+    "twice(4)",
+    "trig(x) -> sin(x) + max(x, 1) + gcd(x, 6) + sqrt(|x|)",
+    "trig(4)",
+    "trig(-9)",
+    // the native recursion hits its limit, then the Interpreter's. before
+    // the calls that fill the memo table of deep without the jit
+    "deep(n) -> if (n == 0) 0 else 1 + deep(n - 1)",
+    "deep(3500)",
+    "deep(2500)",
+    // pi is the argument of q in pi2, not the constant
+    "pi2(x) -> pi * x",
+    "q(pi) -> pi2(1)",
+    "q(3)",
+    "pi2(1)",
+    // NaN is true
+    "truth(x) -> if (x) 1 else 2",
+    "truth(0 / 0)",
+    "truth(0)",
+    "ops(x, y) -> x % y + |x| + 3! + x!",
+    "ops(7, 2)",
+    "ops(4, -3)",
+    "fa(x) -> x!",
+    "fa(5)",
+    "fa(21)",
+    "inverse(x) -> x ^ -1",
+    "inverse(3)",
+    "inverse(4)",
+    "cmp(x, y) -> x < y and y <= 10 or x == 0",
+    "cmp(1, 2)",
+    "cmp(0, 20)",
+    "cmp(3, 2)",
+};
+
+static std::vector<std::string> run() {
+    std::vector<std::string> out;
+    for (const auto& line : script) {
+        auto result = ami::try_eval(line);
+        out.push_back(result ? check::str(std::move(*result))
+                             : "error: " + result.error().err);
+    }
+    return out;
+}
+
+// the Interpreter's frames at its limit of 3000 calls take more than the
+// default stack of unoptimized builds, the script runs on a bigger one
+static std::vector<std::string> run_with_stack(bool jit) {
+    struct Run {
+        bool jit;
+        std::vector<std::string> out;
+    } r{jit, {}};
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, std::size_t(256) << 20);
+    pthread_t thread;
+    pthread_create(
+        &thread, &attr,
+        [](void* arg) -> void* {
+            auto* r = static_cast<Run*>(arg);
+            ami::jit::enabled = r->jit;
+            r->out = run();
+            ami::jit::enabled = false;
+            return nullptr;
+        },
+        &r);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+    return r.out;
+}
+
+int main() {
+    std::vector<std::string> interpreted = run_with_stack(false);
+    std::vector<std::string> native = run_with_stack(true);
+    for (std::size_t i = 0; i < script.size(); ++i) {
+        if (interpreted[i] == native[i]) continue;
+        std::fprintf(stderr, "%s: %s without the jit, %s with it\n",
+                     script[i].c_str(), interpreted[i].c_str(),
+                     native[i].c_str());
+        ++check::failures;
+    }
+#ifdef AMI_JIT_X86_64
+    for (const char* name : {"sq", "fact", "twice", "trig", "deep"}) {
+        ami::Function* f = ami::scope::lookup(ami::scope::userdefined_functions,
+                                              ami::symbols::intern(name));
+        check::expect(f != nullptr && f->native != nullptr,
+                      "the functions to be compiled");
+    }
+#endif
+    return check::done();
+}
@@ -0,0 +1,53 @@
+#include "check.hpp"
+
+static std::size_t calls(std::string_view function) {
+    ami::memo::Stats stats = ami::memo::stats(function);
+    return stats.hits + stats.misses;
+}
+
+int main() {
+    // pure functions are memoized, recursive or not
+    check::eval("score(x) -> x^2 + sin(x)");
+    check::equal("score(0)", "0");
+    check::equal("score(0)", "0");
+    check::expect(ami::memo::stats("score").hits == 1, "score to be memoized");
+    check::eval("offset = 2");
+    check::eval("shifted(x) -> x + offset");
+    check::equal("shifted(1)", "3");
+    check::expect(calls("shifted") == 0, "shifted not to be memoized");
+    check::eval("fib(n) -> if (n < 2) n else fib(n - 1) + fib(n - 2)");
+    check::equal("fib(60)", "1548008755920");
+    std::size_t misses = ami::memo::stats("fib").misses;
+    check::expect(misses != 0, "fib to be memoized");
+
+    // defining a function fib doesn't call keeps its values
+    check::eval("other(x) -> x + 1");
+    check::equal("fib(60)", "1548008755920");
+    check::expect(ami::memo::stats("fib").misses == misses,
+                  "the values of fib to be kept");
+
+    // but not the values of the functions that call it
+    check::eval("base(n) -> n");
+    check::eval("walk(n) -> if (n < 1) base(n) else walk(n - 1)");
+    check::equal("walk(3)", "0");
+    check::eval("base(n) -> n + 5");
+    check::equal("walk(3)", "5");
+
+#ifdef AMI_JIT_X86_64
+    // the functions the jit compiles run as machine code instead, the ones
+    // it can't compile are still memoized
+    ami::jit::enabled = true;
+    check::eval("square(x) -> x * x");
+    check::equal("square(4)", "16");
+    ami::Function* f = ami::scope::lookup(ami::scope::userdefined_functions,
+                                          ami::symbols::intern("square"));
+    check::expect(f != nullptr && f->native != nullptr,
+                  "square to be compiled");
+    check::expect(calls("square") == 0, "square not to be memoized");
+    check::eval("pair(x) -> [x, x]");
+    check::equal("pair(1)", check::str(check::eval("pair(1)")));
+    check::expect(ami::memo::stats("pair").hits == 1, "pair to be memoized");
+    ami::jit::enabled = false;
+#endif
+    return check::done();
+}
@@ -0,0 +1,25 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+int main() {
+    // the lexers of several threads intern the same names at once
+    std::vector<std::string> sources(4);
+    for (int i = 0; i < 1000; ++i)
+        for (auto& source : sources)
+            source += "name" + std::to_string(i) + " + ";
+    for (auto& source : sources) source += "0";
+    std::vector<std::thread> threads;
+    for (const auto& source : sources)
+        threads.emplace_back([&source] { ami::Lexer(source).lex(); });
+    for (auto& thread : threads) thread.join();
+    for (int i = 0; i < 1000; ++i) {
+        std::string name = "name" + std::to_string(i);
+        ami::symbol_t id = ami::symbols::intern(name);
+        check::expect(ami::symbols::name(id) == name,
+                      "every name to have a single id");
+    }
+    return check::done();
+}